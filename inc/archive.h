@@ -0,0 +1,64 @@
+/*
+ * Compact serialization of a closed year's records.
+ *
+ * An archive holds one year's records in a varint encoding: dates as the
+ * number of days since the previous record, amounts zigzag encoded, and
+ * categories as ids into a table of distinct categories. Descriptions are
+ * kept apart in a heap. The archive also stores the year's totals by month
+ * and category, so sums over whole months need not decode any record.
+ * Integers outside the varints are stored in native byte order, and an
+ * archive written on a machine with a different byte order is rejected.
+ */
+
+#ifndef LGR_ARCHIVE_H
+#define LGR_ARCHIVE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "record.h"
+
+/* Totals of the records of one month and category. */
+typedef struct {
+    int32_t m;          // month, 1 to 12
+    int32_t cat;        // category id
+    int64_t in;         // sum of positive amounts
+    int64_t out;        // sum of negative amounts
+    int64_t count;      // number of records
+} ArTotal;
+
+/* A validated archive image. Records are only decoded by ar_decode. */
+typedef struct {
+    const char* s;
+    int y;              // year of every record
+    ptrdiff_t count;    // number of records
+    ptrdiff_t ncats;    // number of distinct categories
+    ptrdiff_t ntotals;  // number of totals, ordered by month then category
+    size_t totals, cats, recs, descs, end;  // section offsets
+} Archive;
+
+/* Write the COUNT valid records at RECS, which must be sorted by date and
+all dated in year Y, as an archive to F. F should be opened in binary mode.
+Return false if writing failed or there is insufficient memory. */
+bool ar_write(FILE* f, int y, const Record* recs, ptrdiff_t count);
+
+/* Validate the header, totals and category table of the archive of LEN
+chars at S, and describe it in AR. Return false if S is not a valid
+archive. S must outlive AR. */
+bool ar_open(Archive* ar, const char* s, size_t len);
+
+/* Return total I, where 0 <= I < AR->ntotals. */
+ArTotal ar_total(const Archive* ar, ptrdiff_t i);
+
+/* Return category ID, where 0 <= ID < AR->ncats. */
+const char* ar_cat(const Archive* ar, ptrdiff_t id);
+
+/* Decode AR's records into OUT, which must have room for AR->count
+records. Return 0 on success, or the position (starting from 1) of the
+first invalid record. Return AR->count + 1 if the records or descriptions
+leave chars unused. */
+ptrdiff_t ar_decode(const Archive* ar, Record* out);
+
+#endif
@@ -0,0 +1,24 @@
+/*
+ * CRC-32C (Castagnoli) checksums.
+ *
+ * The SSE4.2 crc32 instruction is used where the CPU supports it, checking
+ * 8 chars per instruction, and a small table otherwise.
+ */
+
+#ifndef LGR_CRC_H
+#define LGR_CRC_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Use the crc32 instruction if ENABLE and the CPU supports it. Return
+whether it is in use. It is used by default where supported. */
+bool crc_sethw(bool enable);
+
+/* Return the checksum of the LEN chars at S followed by those whose
+checksum is CRC. Pass 0 as CRC to start a new checksum, so that
+crc_32c(crc_32c(0, a, alen), b, blen) is the checksum of A followed by B. */
+uint32_t crc_32c(uint32_t crc, const char* s, size_t len);
+
+#endif
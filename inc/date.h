@@ -35,19 +35,32 @@ int32_t dt_shifty(int32_t dt, int offset);
 int32_t dt_shiftm(int32_t dt, int offset);
 int32_t dt_shiftd(int32_t dt, int offset);
 
+/* Return the number of days from 1970-01-01 to valid date DT, which is
+negative for earlier dates. */
+int32_t dt_epochd(int32_t dt);
+
 /* Return a read-only string to M's short month name. */
 const char* dt_mmm(int m);
 
 /* Check if S is of the form "yyyy-mm-dd". */
 bool dt_isiso(const char* s);
 
-/* Convert a string of the form "yyyy-mm-dd" to a (possibly invalid) date. */
+/* Check if the first DT_ISOLEN chars of S are of the form "yyyy-mm-dd".
+Unlike dt_isiso, S may continue past the date. */
+bool dt_isisoprefix(const char* s);
+
+/* Convert the first DT_ISOLEN chars of S, which must be of the form
+"yyyy-mm-dd", to a (possibly invalid) date. */
 int32_t dt_fromiso(const char* s);
 
 /* Return the ISO string representation of a valid date. The return value
 is a statically allocated string. */
 char* dt_toiso(int32_t dt);
 
+/* Write the ISO representation of a valid date to BUF. Does NOT write NUL
+at the end. Return DT_ISOLEN. */
+int dt_writeiso(int32_t dt, char* buf);
+
 /* Return the pretty-formatted string representation of a valid date. The
 return value is a statically allocated string. */
 char* dt_fmt(int32_t dt);
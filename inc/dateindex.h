@@ -0,0 +1,55 @@
+/*
+ * Sparse index mapping months to their location in a serialized record
+ * list.
+ *
+ * There is one entry per month present in the file, pointing at the
+ * month's first line. An index also stores the size and modification time
+ * of the file it describes, so a stale index can be recognized.
+ */
+
+#ifndef LGR_DATEINDEX_H
+#define LGR_DATEINDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    int32_t month;      // yyyymm
+    int64_t line;       // line number of the month's first line, from 0
+    int64_t offset;     // byte offset of the month's first line
+} DateIndexEntry;
+
+typedef struct {
+    int64_t size;               // size of the indexed file
+    int64_t mtime;              // modification time of the indexed file
+    ptrdiff_t count;            // number of entries
+    DateIndexEntry* entries;    // sorted by month
+} DateIndex;
+
+/* Index the LEN chars at S, which should be a serialized record list.
+Set the size to LEN and the modification time to 0. Return false if there
+is insufficient memory, or if some line does not start with an ISO date or
+is out of order. */
+bool di_build(DateIndex* di, const char* s, size_t len);
+
+/* Save to a file opened in binary mode. Return false if writing failed. */
+bool di_write(const DateIndex* di, FILE* f);
+
+/* Load an index saved by di_write. Return false if F does not contain a
+valid index or if there is insufficient memory. */
+bool di_read(DateIndex* di, FILE* f);
+
+/* Locate the lines dated DT0 to DT1, inclusive, as the chars from START up
+to STOP. LINE is set to the line number at START. The range is widened to
+whole months. */
+void di_range(
+    const DateIndex* di, int32_t dt0, int32_t dt1,
+    int64_t* start, int64_t* stop, int64_t* line
+);
+
+/* Deallocate. */
+void di_free(DateIndex* di);
+
+#endif
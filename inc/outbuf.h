@@ -0,0 +1,45 @@
+/*
+ * Output buffer that writes to a stream in large blocks, bypassing the
+ * stream's own buffering.
+ */
+
+#ifndef LGR_OUTBUF_H
+#define LGR_OUTBUF_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/* Default buffer capacity. */
+#define OB_DEFAULTCAP (1 << 20)
+
+typedef struct {
+    FILE* f;        // destination stream
+    char* buf;
+    size_t len;     // number of buffered chars
+    size_t cap;     // buffer capacity
+    bool err;       // whether a write has failed
+} OutBuf;
+
+/* Initialize OB to write to F with a CAP char buffer. Return false if
+there is insufficient memory. */
+bool ob_open(OutBuf* ob, FILE* f, size_t cap);
+
+/* Return a pointer to room for at least N chars, flushing if needed. N
+must not exceed the buffer capacity. Call ob_commit once written. */
+char* ob_reserve(OutBuf* ob, size_t n);
+
+/* Mark N chars at the pointer last returned by ob_reserve as written. */
+void ob_commit(OutBuf* ob, size_t n);
+
+/* Copy LEN chars from S. */
+void ob_write(OutBuf* ob, const char* s, size_t len);
+
+/* Write all buffered chars to the stream. Return false if any write has
+failed. */
+bool ob_flush(OutBuf* ob);
+
+/* Flush and deallocate. Return false if any write has failed. */
+bool ob_close(OutBuf* ob);
+
+#endif
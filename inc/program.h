@@ -4,16 +4,36 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "archive.h"
+#include "recordcheck.h"
 #include "recordlist.h"
+#include "recordruns.h"
+#include "recordstream.h"
 
 #define PROG_NAME "lgr"
 #define PROG_IDFN "." PROG_NAME
 #define PROG_DATAFN PROG_NAME "_data.tsv"
+#define PROG_BINFN PROG_NAME "_data.bin"
+#define PROG_YEARFN PROG_NAME "_data_%04d.tsv"
 #define PROG_LIMFN PROG_NAME "_limits.ini"
+#define PROG_JOURNALFN PROG_NAME "_journal.tsv"
+#define PROG_TAILFN PROG_NAME "_data.tail"
+#define PROG_INDEXFN PROG_NAME "_index.bin"
+#define PROG_CACHEFN PROG_NAME "_cache.bin"
+#define PROG_ARCHIVEFN PROG_NAME "_archive_%04d.bin"
+#define PROG_CHECKFN PROG_NAME "_check.bin"
+#define PROG_RUNFN PROG_NAME "_run_%d.tmp"
 #define PROG_ARGSTART 2
 
 #define PROG_CONF_LOG_SIGN "log_sign"
 #define PROG_CONF_LIM_TYPE "lim_type"
+#define PROG_CONF_JOURNAL_MAX "journal_max"
+#define PROG_CONF_LOAD_THREADS "load_threads"
+#define PROG_CONF_DATA_FORMAT "data_format"
+#define PROG_CONF_MEMORY_MAX "memory_max"
+
+/* Values of PROG_CONF_DATA_FORMAT. */
+enum prog_format {PROG_FORMAT_TSV, PROG_FORMAT_BIN, PROG_FORMAT_YEARS};
 
 /* Read PROG_IDFN and load config options. Config file must consist only of
 lines in the form "key=value", where values are interpreted as integers.
@@ -47,13 +67,143 @@ bool prog_parsedt(const char* s, int32_t* dt);
 decimal places. Supports using commas as thousands separators. */
 bool prog_parsecents(const char* s, int64_t* cents);
 
-/* Initilialize record list. Exit program on error. */
+/* Return the data file used by the configured format: PROG_DATAFN, or
+PROG_BINFN if PROG_CONF_DATA_FORMAT is PROG_FORMAT_BIN. Return NULL for
+PROG_FORMAT_YEARS, which stores each year's records in its own PROG_YEARFN
+file (formatted with the year). */
+const char* prog_datafn(void);
+
+/* Initilialize record list from prog_datafn() using PROG_CONF_LOAD_THREADS
+threads, replaying any changes recorded in PROG_JOURNALFN. Finish any
+interrupted write first. Large text data files are parsed only once per
+change: the parsed records are cached in PROG_CACHEFN, tagged with the data
+file's size, modification time and content hash. For PROG_FORMAT_YEARS,
+every year file is read instead. Exit program on error, including if
+prog_outofcore() is set. */
 void prog_initrl(void);
 
-/* Write record list. Exit program on error. */
+/* Like prog_initrl, but only load records dated DT0 to DT1. PROG_INDEXFN
+locates the months covering that range, and is rebuilt whenever it does
+not match PROG_DATAFN; lines outside the range are skipped without being
+deserialized. Journal entries outside the range are ignored, and
+prog_writerl reloads the full list before writing. Binary data files are
+always loaded in full. For PROG_FORMAT_YEARS, only the year files
+overlapping the range are read, and they are read in full. */
+void prog_initrlrange(int32_t dt0, int32_t dt1);
+
+/* Write record list and discard the journal. Only records from the first
+changed one onward are rewritten; the new tail is staged in PROG_TAILFN so
+an interrupted write can be finished later. For PROG_FORMAT_YEARS, only the
+files of years changed since loading are rewritten. If prog_outofcore() is
+set, the list must be partial and its changes journaled; the tail is then
+streamed from the data file with the journal applied, instead of
+reloading the full list. Exit program on error. */
 void prog_writerl(void);
 
+/* Write the whole record list in the PROG_FORMAT_YEARS layout, whatever
+the configured format, removing the files of years without records. Exit
+program on error. */
+void prog_writeyears(void);
+
+/* Write the whole record list to FN in FORMAT, which is PROG_FORMAT_TSV or
+PROG_FORMAT_BIN, or with prog_writeyears if FORMAT is PROG_FORMAT_YEARS, in
+which case FN is ignored. FN must not be prog_datafn(). Any journaled
+changes are then written to prog_datafn() as well, so no journal is left to
+be replayed once PROG_CONF_DATA_FORMAT is switched to FORMAT. Exit program
+on error. */
+void prog_convert(enum prog_format format, const char* fn);
+
+/* Record the insertion of REC, or the deletion of the DIND-th record
+(starting from 0) dated DT. The record list must already reflect the
+change. Instead of rewriting PROG_DATAFN, the change is appended to
+PROG_JOURNALFN. Once the journal exceeds PROG_CONF_JOURNAL_MAX bytes, the
+record list is written and the journal is discarded. For PROG_FORMAT_YEARS,
+nothing is journaled and the affected year's file is rewritten at once.
+Exit program on error. */
+void prog_journalins(const Record* rec);
+void prog_journaldel(int32_t dt, ptrdiff_t dind);
+
+/* Load the full record list, insert the COUNT records at RECS as one batch
+(see rl_insertmany), then write it once with prog_writerl. If
+prog_outofcore() is set, the records are inserted with prog_insertruns
+instead. Exit program on error. */
+void prog_insertmany(Record* recs, ptrdiff_t count);
+
+/* Check if PROG_DATAFN holds more records than fit in
+PROG_CONF_MEMORY_MAX bytes once loaded, estimated from its size and the
+length of its first lines. Only PROG_FORMAT_TSV ledgers are run out of
+core; a nonpositive PROG_CONF_MEMORY_MAX means memory is unlimited. */
+bool prog_outofcore(void);
+
+/* Call FN(ARG, REC) for every record matching RF, in order, without
+loading the record list: PROG_DATAFN is read from the first month in RF's
+range, applying the journal a day at a time, and reading stops past the
+range. If ARCHIVES, archived records are included, decoded a year at a
+time. Return the number of records matched. For other formats, the range
+is loaded instead. Exit program on error. */
+ptrdiff_t prog_streamrl(
+    const RecordFilter* rf, bool archives,
+    void (*fn)(void* arg, const Record* rec), void* arg
+);
+
+/* Open RR to sort a batch of records in PROG_CONF_MEMORY_MAX bytes of
+memory, spilling sorted runs to PROG_RUNFN files (see recordruns.h). Exit
+program on error. */
+void prog_runsopen(RecordRuns* rr);
+
+/* Add REC to RR. Exit program on error. */
+void prog_runsadd(RecordRuns* rr, const Record* rec);
+
+/* Insert every record added to RR into the ledger as one batch, then
+close RR. The data file is streamed from the first month changed, merged
+with the sorted batch and the journal into PROG_TAILFN, and rewritten like
+prog_writerl does, so the list is never loaded. Exit program on error. */
+void prog_insertruns(RecordRuns* rr);
+
+/* Check if year Y has been archived with prog_archive. */
+bool prog_isarchived(int y);
+
+/* Move every record dated in year Y from the record list into the
+PROG_ARCHIVEFN file for Y (see archive.h), then write the record list.
+Records can no longer be added to or removed from Y: prog_journalins,
+prog_journaldel and prog_insertmany exit program if asked to. Running this
+again after an interrupted archive finishes it. If prog_outofcore() is
+set, only Y's records are loaded, and the data file is streamed without
+them. Return the number of records moved. Exit program on error. */
+ptrdiff_t prog_archive(int y);
+
+/* Insert every archived record dated DT0 to DT1 into the record list, as
+one batch. The record list can then no longer be written. Exit program on
+error. */
+void prog_loadarchives(int32_t dt0, int32_t dt1);
+
+/* Call FN(ARG, Y, T, CAT) with totals T of the archived records matching
+RF, where Y is the year and CAT the category. Totals are read from each
+archive without decoding its records, unless RF has description patterns
+or only covers part of a month; then FN is called once per matching record
+instead. T's category id is meaningless. Return the number of records
+totaled. Exit program on error. */
+ptrdiff_t prog_sumarchives(
+    const RecordFilter* rf,
+    void (*fn)(void* arg, int y, const ArTotal* t, const char* cat),
+    void* arg
+);
+
 /* Print "mmm d, yyyy -- mmm d, yyyy\n". */
 void prog_printdaterange(int32_t dt0, int32_t dt1);
 
+
+/* Check every line of PROG_DATAFN, or of every year file for
+PROG_FORMAT_YEARS, with rc_check on PROG_CONF_LOAD_THREADS threads. Call
+FN(ARG, NAME, ISSUE) for each ISSUE found in the file NAME, in order. The
+valid blocks found are saved in PROG_CHECKFN, and unless FULL, the blocks
+saved by the last check are not deserialized again. Store the number of
+lines checked in *LINES and the number deserialized in *PARSED. Return the
+number of issues. A PROG_BINFN data file is loaded instead, which
+validates it in full. Exit program on error. */
+ptrdiff_t prog_check(
+    bool full, void (*fn)(void* arg, const char* name, const RcIssue* issue),
+    void* arg, int64_t* lines, int64_t* parsed
+);
+
 #endif
@@ -1,12 +1,18 @@
 #ifndef LGR_RECORD_H
 #define LGR_RECORD_H
 
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "date.h"
+#include "hashtable.h"
 
 #define REC_DELIM "\t"
 
+/* Number of delimiters separating a serialized record's fields. */
+#define REC_NDELIMS 3
+
 /* Amount limits. */
 #define REC_AMT_MAX (100LL*1000*1000*1000*1000)
 #define REC_AMT_MIN (-REC_AMT_MAX)
@@ -47,6 +53,40 @@ typedef struct {
     char desc[REC_DESCLEN + 1]; // optional description
 } Record;
 
+/* Dictionary of distinct categories, each identified by its index in
+NAMES, numbered from 0 in the order added. */
+typedef struct {
+    char (*names)[REC_CATLEN + 1];  // NUL-padded
+    int32_t count;
+    int32_t cap;
+    HashTable* ids;                 // category to id
+} RecordCats;
+
+/* Arena of descriptions, each a run of chars without a NUL. Chars are
+only ever appended, so those of descriptions no longer referred to stay in
+the arena until its owner rewrites it. */
+typedef struct {
+    char* chars;
+    int64_t len;
+    int64_t cap;
+} RecordDescs;
+
+/* Records stored as one array per field, with every array indexed alike.
+Scans that only need a few fields then read only those fields' arrays.
+Categories are stored as ids into CATS, so they can be compared and used
+as array indices without touching their names. Descriptions are stored as
+the offset and length of their chars in DESCS, so each takes only as much
+memory as its text; REC_DESCLEN fits in a uint8_t. */
+typedef struct {
+    int32_t* dt;
+    int64_t* amt;
+    int32_t* cat;
+    int64_t* descoff;
+    uint8_t* desclen;
+    RecordCats* cats;
+    RecordDescs* descs;
+} RecordColumns;
+
 /* Initialize a record, lowercasing all of CAT's characters. Return REC. If
 any component is invalid, return NULL and leave REC unmodified. */
 Record* rec_init(
@@ -56,7 +96,73 @@ Record* rec_init(
 /* Deserialize string to record. Return REC on success and NULL on failure. */
 Record* rec_fromstr(Record* rec, const char* s);
 
+/* Same as rec_fromstr, but deserialize the LEN chars at S, which need not
+be NUL-terminated. Fields are validated and decoded directly from S in a
+single pass. On failure, REC may be partially modified. */
+Record* rec_fromstrn(Record* rec, const char* s, size_t len);
+
+/* Same as rec_fromstrn, but the offsets of the first REC_NDELIMS
+delimiters in S are already known and stored in DELIMS. */
+Record* rec_fromfields(
+    Record* rec, const char* s, size_t len, const size_t* delims
+);
+
+/* Reasons a line cannot be deserialized, as found by rec_diagnose. */
+enum rec_fault {
+    REC_VALID,
+    REC_FAULT_LONG,     // longer than REC_STRLEN, which loaders reject
+    REC_FAULT_FIELDS,   // fewer than REC_NDELIMS delimiters
+    REC_FAULT_DATE,     // not a valid ISO date
+    REC_FAULT_AMT,      // amount is zero or not an integer
+    REC_FAULT_RANGE,    // amount outside REC_AMT_MIN to REC_AMT_MAX
+    REC_FAULT_CAT,      // empty category
+    REC_NFAULTS
+};
+
+/* Return why the LEN chars at S cannot be deserialized by rec_fromstrn, or
+REC_VALID if they can and are at most REC_STRLEN long. */
+enum rec_fault rec_diagnose(const char* s, size_t len);
+
+/* Initialize an empty dictionary. Return false if there is insufficient
+memory. */
+bool rec_initcats(RecordCats* cats);
+
+/* Deallocate. */
+void rec_freecats(RecordCats* cats);
+
+/* Return the id of CAT, adding it to CATS if it is not there yet. Return
+-1 if there is insufficient memory or no ids are left. */
+int32_t rec_intern(RecordCats* cats, const char* cat);
+
+/* Return the id of CAT, or -1 if it is not in CATS. */
+int32_t rec_catid(const RecordCats* cats, const char* cat);
+
+/* Make room for LEN more chars in DESCS. Return false if there is
+insufficient memory. */
+bool rec_reservedescs(RecordDescs* descs, size_t len);
+
+/* Append the LEN chars at S to DESCS. Return the offset of the first, or
+-1 if there is insufficient memory. */
+int64_t rec_putdescs(RecordDescs* descs, const char* s, size_t len);
+
+/* Deallocate. */
+void rec_freedescs(RecordDescs* descs);
+
+/* Copy record INDEX of COLS to REC, resolving its category and
+description. Return REC. */
+Record* rec_fromcols(Record* rec, const RecordColumns* cols, ptrdiff_t index);
+
+/* Copy REC to record INDEX of COLS, interning its category and appending
+its description. Return false if there is insufficient memory, leaving the
+record unchanged. Neither step can fail if the category is already in the
+dictionary and rec_reservedescs made room for the description. */
+bool rec_tocols(const Record* rec, const RecordColumns* cols, ptrdiff_t index);
+
 /* Serialize a valid record to a statically allocated string. */
 char* rec_tostr(const Record* rec);
 
+/* Serialize a valid record to BUF, which must have room for REC_STRLEN
+chars. Does NOT write NUL at the end. Return the number of chars written. */
+int rec_tobuf(const Record* rec, char* buf);
+
 #endif
@@ -0,0 +1,50 @@
+/*
+ * Arrow IPC file serialization of sorted records.
+ *
+ * The file holds a single schema with four non-nullable columns:
+ *      date            date32, days since 1970-01-01
+ *      amount          int64, in cents
+ *      category        utf8, dictionary encoded with int32 indices
+ *      description     utf8
+ * Columns are written one at a time straight from the records, in record
+ * batches of at most RA_BATCHLEN records. Buffers are 8-byte aligned and
+ * in native byte order, which the schema declares, so Arrow readers can
+ * map the file without copying.
+ */
+
+#ifndef LGR_RECORDARROW_H
+#define LGR_RECORDARROW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "hashtable.h"
+#include "record.h"
+
+/* Most records per record batch. */
+#define RA_BATCHLEN (1 << 17)
+
+/* Write COUNT valid records as an Arrow IPC file to F. The records are
+RECS[SEL[0]], RECS[SEL[1]], and so on, or the first COUNT records at RECS
+if SEL is NULL. F should be opened in binary mode. Return false if writing failed or there is insufficient memory. */
+bool ra_write(FILE* f, const Record* recs, const ptrdiff_t* sel, ptrdiff_t count);
+
+/* Arrow IPC file written one record batch at a time. */
+typedef struct RaFile RaFile;
+
+/* Start writing an Arrow IPC file to F, as for ra_write, whose category
+dictionary is CATS: an HT_STR table mapping each category to its id,
+numbered from 0 in the table's order. CATS must remain valid until
+ra_close. Return NULL if there is insufficient memory. */
+RaFile* ra_open(FILE* f, HashTable* cats);
+
+/* Write the COUNT valid records at RECS, which may be at most RA_BATCHLEN
+and whose categories must all be in the dictionary, as a record batch. */
+void ra_append(RaFile* ra, const Record* recs, ptrdiff_t count);
+
+/* Finish the file and deallocate. Return false if any write failed or
+there was insufficient memory. */
+bool ra_close(RaFile* ra);
+
+#endif
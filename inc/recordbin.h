@@ -0,0 +1,45 @@
+/*
+ * Binary columnar serialization of sorted records.
+ *
+ * An image stores each record field as its own column: dates, amounts,
+ * category ids into a table of distinct categories, and description
+ * offsets into a heap of description chars. Decoding an image involves no
+ * text parsing. Integers are stored in native byte order, and an image
+ * written on a machine with a different byte order is rejected.
+ */
+
+#ifndef LGR_RECORDBIN_H
+#define LGR_RECORDBIN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "record.h"
+
+/* Write the valid records held in blocks of columns as an image to F:
+block I holds COUNTS[I] records in BLOCKS[I], and every block shares a
+dictionary and arena. The records must be sorted by date, block by block.
+F should be opened in binary mode. Return false if writing failed or there
+is insufficient memory. */
+bool rb_write(
+    FILE* f, const RecordColumns* blocks, const ptrdiff_t* counts, ptrdiff_t nblocks
+);
+
+/* Return the number of records in the image of LEN chars at S, or -1 if S
+does not have a valid header or its size does not match the header. */
+ptrdiff_t rb_count(const char* s, size_t len);
+
+/* Decode the image of LEN chars at S into blocks of columns: block I
+receives the next COUNTS[I] records in BLOCKS[I], where the counts add up
+to rb_count(S, LEN), and every block shares a dictionary and arena. Each
+column is copied a block at a time, the image's categories are interned
+into the dictionary, and its descriptions are appended to the arena at
+once. Return 0 on success, -1 if there is insufficient memory, or the
+position (starting from 1) of the first invalid or out of order record. */
+ptrdiff_t rb_decode(
+    const char* s, size_t len,
+    const RecordColumns* blocks, const ptrdiff_t* counts, ptrdiff_t nblocks
+);
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Validation of serialized record lists.
+ *
+ * A check reports every line that cannot be deserialized and every valid
+ * line dated before the valid line preceding it. Lines are grouped into
+ * blocks, each a run of consecutive lines starting with the same month
+ * ("yyyy-mm"), and each valid block is summarized by its length, dates and
+ * CRC-32C checksum. Given the blocks of an earlier check, a block whose
+ * chars are unchanged is accepted by its checksum without deserializing
+ * its lines, so a check after a small edit only parses the changed months.
+ */
+
+#ifndef LGR_RECORDCHECK_H
+#define LGR_RECORDCHECK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "record.h"
+
+/* Issue kind of a valid line dated before the valid line preceding it.
+Other issues are the rec_fault of a line that cannot be deserialized. */
+#define RC_UNSORTED REC_NFAULTS
+
+/* A block of valid lines. */
+typedef struct {
+    int32_t dt0;        // date of the first line
+    int32_t dt1;        // date of the last line
+    uint32_t crc;       // CRC-32C of the block's chars
+    int64_t len;        // number of chars, ending with a newline
+    int64_t lines;      // number of lines
+} RcBlock;
+
+/* A problem found by rc_check. */
+typedef struct {
+    int64_t line;       // line number, from 1
+    int kind;           // rec_fault, or RC_UNSORTED
+} RcIssue;
+
+/* Result of rc_check. */
+typedef struct {
+    int64_t lines;      // number of lines checked
+    int64_t parsed;     // number of lines deserialized
+    ptrdiff_t nissues;
+    RcIssue* issues;    // sorted by line
+    ptrdiff_t nblocks;
+    RcBlock* blocks;    // valid blocks, in file order
+} RcResult;
+
+/* Check the LEN chars at S, which should be a serialized record list,
+storing the result in RES. KNOWN holds the NKNOWN blocks of an earlier
+check in file order; blocks of S matching one of them are not
+deserialized. Blocks are checked on THREADS threads, or one per processor
+if THREADS is nonpositive. Return false if there is insufficient memory. */
+bool rc_check(
+    const char* s, size_t len, const RcBlock* known, ptrdiff_t nknown,
+    int threads, RcResult* res
+);
+
+/* Deallocate. */
+void rc_free(RcResult* res);
+
+/* Save the COUNT blocks at BLOCKS to a file opened in binary mode. Return
+false if writing failed. */
+bool rc_write(const RcBlock* blocks, ptrdiff_t count, FILE* f);
+
+/* Load blocks saved by rc_write into an allocated array at *BLOCKS, and
+their number into *COUNT. Return false if F does not contain valid blocks
+or if there is insufficient memory. */
+bool rc_read(RcBlock** blocks, ptrdiff_t* count, FILE* f);
+
+#endif
@@ -1,8 +1,14 @@
 /*
- * Sorted array of records.
+ * Sorted list of records.
  * 
  * Only a single object exists. It is statically allocated and exists for
- * the lifetime of the program.
+ * the lifetime of the program. Records are stored as columns (see
+ * RecordColumns) in blocks of a few thousand records, so inserting or
+ * deleting a record only moves the records of its block, and an index of
+ * the blocks finds any record or date in O(log n). Filters select records
+ * of the active slice rather than deleting them. Loops over the selection
+ * that only need dates or amounts should iterate its RlSpans (see
+ * rl_foreachsel) rather than whole records from rl_get.
  */
 
 #ifndef LGR_RECORDLIST_H
@@ -17,25 +23,97 @@
 
 #define RL_MAXCOUNT (PTRDIFF_MAX / 2)
 
-/* Record access. Return NULL if INDEX is out of bounds. */
+/* Chars of memory taken by each loaded record: its columns and offset,
+not counting its category, which is shared, or its description's chars,
+which are stored in an arena. */
+#define RL_RECSIZE ( \
+    sizeof(int32_t) + sizeof(int64_t) + sizeof(int32_t) \
+    + sizeof(int64_t) + sizeof(uint8_t) + sizeof(int64_t) \
+)
+
+/* Columns of records in a range of indices, valid until the list is next
+modified. Element I of each column belongs to the record at the range's
+start plus I. */
+typedef struct {
+    const int32_t* dt;
+    const int64_t* amt;
+    const int32_t* cat;         // ids, resolved by rl_catname
+    const int64_t* descoff;     // offsets into DESCS
+    const uint8_t* desclen;     // lengths, without a NUL
+    const char* descs;
+    ptrdiff_t len;
+} RlSpan;
+
+/* Record access. Copy record INDEX to a statically allocated record, which
+the next call overwrites, and return it. Return NULL if INDEX is out of
+bounds. */
 const Record* rl_get(ptrdiff_t index);
 
+/* Copy records START to STOP-1 to OUT. */
+void rl_copy(ptrdiff_t start, ptrdiff_t stop, Record* out);
+
+/* Return the columns of records START up to STOP-1, which must be in
+bounds, or up to the last record of START's block if that comes first. An
+empty range returns an empty span. */
+RlSpan rl_span(ptrdiff_t start, ptrdiff_t stop);
+
+/* Convenience macro for setting up a for loop to iterate through the
+spans of records START to STOP-1. SPAN must be an lvalue of type RlSpan,
+and POS one of type ptrdiff_t, which holds the index of SPAN's first
+record. */
+#define rl_foreachspan(span, pos, start, stop) for ( \
+    (pos) = (start) \
+    ; (pos) < (stop) && ((span) = rl_span((pos), (stop)), true) \
+    ; (pos) += (span).len \
+)
+
+/* Convenience macro for setting up a for loop to iterate through the
+spans of selected records (see rl_filtercat), which are every active slice
+record unless a filter was applied. SPAN must be an lvalue of type RlSpan,
+and POS one of type ptrdiff_t, which holds the position of SPAN's first
+record in the selection (see rl_selindex). */
+#define rl_foreachsel(span, pos) for ( \
+    (pos) = 0 \
+    ; (pos) < rl_selcount() && ((span) = rl_selspan((pos), rl_selcount()), true) \
+    ; (pos) += (span).len \
+)
+
+/* Like rl_span, but START and STOP are positions in the selection, which
+must be in bounds, and the span also ends before the first selected record
+that does not directly follow the one before it in the list. */
+RlSpan rl_selspan(ptrdiff_t start, ptrdiff_t stop);
+
+/* Return the index in the list of the selected record at position POS in
+the selection, which must be in bounds. */
+ptrdiff_t rl_selindex(ptrdiff_t pos);
+
+/* Return the number of category ids, which are numbered from 0. Ids of
+categories no longer held by any record are kept, so arrays indexed by id
+may have entries no record refers to. */
+int32_t rl_catcount(void);
+
+/* Return the category whose id is ID. */
+const char* rl_catname(int32_t id);
+
 /* Getters. */
 ptrdiff_t rl_count(void);
 ptrdiff_t rl_slicestart(void);
 ptrdiff_t rl_slicestop(void);
 ptrdiff_t rl_slicecount(void);
+ptrdiff_t rl_selcount(void);
 
 /*
  * Initialize record list by reading a file.
  * 
- * Enough space is allocated for a single insertion. Active slice is set to the entire list.
+ * Insertions allocate further blocks as needed. Active slice is set to
+ * the entire list. Any existing list is deallocated first.
  * 
  * Parameters
  * ----------
  * f
  *      Allows reading (will start from beginning of file). May also be
- *      NULL (interpreted as a blank file).
+ *      NULL (interpreted as a blank file). The file is memory-mapped where
+ *      possible and read in a single pass.
  * 
  * Returns
  * -------
@@ -46,21 +124,98 @@ ptrdiff_t rl_slicecount(void);
  */
 ptrdiff_t rl_init(FILE* f);
 
+/* Like rl_init, but append F's records to the list instead of replacing
+it. F's records must not be dated before any record already in the list.
+Return values are the same as for rl_init, with line numbers relative to
+F; on failure the list is unchanged. Since the list no longer corresponds
+to a single file, every record counts as changed (see rl_clean) unless the
+list was empty. */
+ptrdiff_t rl_append(FILE* f);
+
+/* Like rl_init, but only load records dated DT0 to DT1 from the chars of
+F between offsets START and STOP, both of which must be at the start of a
+line or the end of the file. Since the file is sorted, lines before DT0 or
+after DT1 are located by comparing their ISO date prefixes, and are never
+deserialized. Line numbers returned are relative to START. The list then
+holds only part of the file, so it must never be written back over it. */
+ptrdiff_t rl_initrange(
+    FILE* f, int64_t start, int64_t stop, int32_t dt0, int32_t dt1
+);
+
+/* Like rl_init, but F must contain a binary image written by rl_writebin,
+starting at offset START and running to the end of the file. The image is
+decoded without any text parsing. Return values are the same as for
+rl_init, except positive values are the position (starting from 1) of the
+first invalid record; an invalid header counts as record 1. */
+ptrdiff_t rl_initbin(FILE* f, int64_t start);
+
+/* Set the number of threads rl_init may use to deserialize large files.
+Pass 0 or less to use one thread per processor. The default is 1. */
+void rl_setthreads(int count);
+
 /* Serialize to file. Writing will begin wherever the current write
-position is. */
-void rl_write(FILE* f);
+position is. Records are formatted into a large buffer which is written in
+a few large blocks. Return false if writing failed. */
+bool rl_write(FILE* f);
+
+/* Like rl_write, but only serialize the active slice. */
+bool rl_writeslice(FILE* f);
+
+/* Serialize to file as a binary image (see recordbin.h). F should be
+opened in binary mode. Return false if writing failed or there is
+insufficient memory. */
+bool rl_writebin(FILE* f);
+
+/* Serialize the number of clean records (see rl_clean) and the text byte
+offsets of each, up to the offset just past the last, to F in native byte
+order. F should be opened in binary mode. Return false if writing
+failed. */
+bool rl_writeclean(FILE* f);
+
+/* Read what rl_writeclean wrote from F's current position, and mark those
+records clean again with their offsets. The list must hold the same
+records it held when they were written, as when it is loaded by
+rl_initbin from an image written alongside them. Return false if reading
+failed or there are more clean records than records, in which case every
+record still counts as changed. */
+bool rl_readclean(FILE* f);
+
+/* Return the number of leading records that have not changed since the
+list was loaded or last written, storing the byte offset just past those
+records' serialization in OFFSET. Records before this point never need to
+be rewritten. */
+ptrdiff_t rl_clean(int64_t* offset);
+
+/* Serialize records from index START onward, where START must not exceed
+rl_clean's return value. F's write position should be at START's offset.
+Return false if writing failed or START is too large. */
+bool rl_writefrom(FILE* f, ptrdiff_t start);
 
 /* Deallocate. */
 void rl_deinit(void);
 
 /* Copy-insert a valid record. Automatically adjust slice boundaries.
-Return the inserted record. */
+Return the inserted record as by rl_get, or NULL if there is insufficient
+memory. */
 const Record* rl_insert(const Record* rec);
 
+/* Copy-insert the COUNT valid records at RECS, which are first sorted by
+date in place. Records dated the same keep their order, and follow those
+already in the list. The records from the batch's first insertion point
+onward are merged with it in a single pass, so inserting a batch costs
+O(n + k log k) rather than O(n * k). Reset the active slice to the entire list. Return false if
+there is insufficient memory or the list would exceed RL_MAXCOUNT records,
+in which case the list is unchanged. */
+bool rl_insertmany(Record* recs, ptrdiff_t count);
+
 /* Delete record. Automatically adjust slice boundaries. Return false if
 INDEX is out of bounds. */
 bool rl_delete(ptrdiff_t index);
 
+/* Delete every active slice record, then reset the active slice to the
+entire list. Return the number of records deleted. */
+ptrdiff_t rl_deleteslice(void);
+
 /* Reset record list's slice to the entire list. Return record count. */
 ptrdiff_t rl_resetslice(void);
 
@@ -68,9 +223,12 @@ ptrdiff_t rl_resetslice(void);
 `dt0` <= D <= `dt1`. Return resultant slice count. */
 ptrdiff_t rl_slice(int32_t dt0, int32_t dt1);
 
-/* Delete all active slice records for which none of the given patterns is
-a substring. Patterns in PATTERNS are separated by DELIM. Return resultant
-slice length, or -1 if there is insufficient memory. */
+/* Deselect all selected records for which none of the given patterns is
+a substring, without changing the list or the active slice, so filters
+narrow each other's selection. Setting the active slice or modifying the
+list selects every active slice record again. Patterns in PATTERNS are
+separated by DELIM. Return the number of records left selected, or -1 if
+there is insufficient memory, in which case the selection is unchanged. */
 ptrdiff_t rl_filtercat(const char* patterns, int delim);
 ptrdiff_t rl_filterdesc(const char* patterns, int delim);
 
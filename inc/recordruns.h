@@ -0,0 +1,86 @@
+/*
+ * External merge sort of records.
+ *
+ * Records are added to a buffer of bounded size. Whenever it fills, it is
+ * sorted by date and written to a temporary file as a sorted run, and the
+ * records are read back by merging the runs, so any number of records can
+ * be sorted in bounded memory. Every RR_FANIN runs of the same size are
+ * merged into one as they accumulate, which keeps the number of open files
+ * small. Records with equal dates are read back in the order they were
+ * added. Nothing is written to disk if every record fits in the buffer.
+ */
+
+#ifndef LGR_RECORDRUNS_H
+#define LGR_RECORDRUNS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "record.h"
+
+/* Most runs merged at once. */
+#define RR_FANIN 16
+
+/* Return values of rr_next. */
+enum rr_status {RR_END, RR_OK, RR_READERR};
+
+/* A sorted run in a temporary file. */
+typedef struct {
+    FILE* f;
+    int id;             // number formatted into the file's name
+    int level;          // number of merges the run has been through
+    int64_t count;      // number of records
+} RrRun;
+
+/* Reader of a run during a merge. */
+typedef struct {
+    FILE* f;
+    Record* buf;
+    ptrdiff_t pos;      // index of the next record in BUF
+    ptrdiff_t len;      // number of records in BUF
+    ptrdiff_t cap;      // capacity of BUF
+    int64_t left;       // records not yet read into BUF
+} RrReader;
+
+typedef struct {
+    const char* fmt;    // printf format of temporary file names
+    int nextid;
+    Record* recs;       // buffered records, in the order added
+    int64_t* keys;      // date and index of each buffered record
+    ptrdiff_t count;    // number of buffered records
+    ptrdiff_t cap;      // current capacity of the buffer
+    ptrdiff_t maxcap;   // capacity allowed by the memory budget
+    RrRun* runs;        // oldest first
+    ptrdiff_t nruns;
+    ptrdiff_t runcap;
+    int64_t total;      // number of records added
+    ptrdiff_t next;     // next buffered record to read, without runs
+    RrReader readers[RR_FANIN];
+} RecordRuns;
+
+/* Initialize RR to sort records using about BUDGET chars of memory.
+Temporary files are named by formatting FMT, which must remain valid, with
+an int; they are created in binary mode and removed when no longer needed,
+or at once where open files can be removed. Return false if there is
+insufficient memory. */
+bool rr_open(RecordRuns* rr, size_t budget, const char* fmt);
+
+/* Add REC. Return false if a temporary file cannot be written, or if
+there is insufficient memory. */
+bool rr_add(RecordRuns* rr, const Record* rec);
+
+/* Stop adding records and prepare to read them back. Return false if a
+temporary file cannot be written or read. */
+bool rr_finish(RecordRuns* rr);
+
+/* Read the next record in date order into REC. Return RR_OK on success,
+RR_END if every record has been read, or RR_READERR if reading a temporary
+file failed. */
+enum rr_status rr_next(RecordRuns* rr, Record* rec);
+
+/* Deallocate and remove the temporary files. */
+void rr_close(RecordRuns* rr);
+
+#endif
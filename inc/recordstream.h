@@ -0,0 +1,76 @@
+/*
+ * Sequential reading and filtering of serialized records.
+ *
+ * A stream reads a file one record at a time through a fixed-size buffer,
+ * so memory use does not depend on the size of the file. The file need not
+ * be seekable or sorted.
+ */
+
+#ifndef LGR_RECORDSTREAM_H
+#define LGR_RECORDSTREAM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "record.h"
+
+/* Size of a stream's buffer. */
+#define RS_BUFSIZE (1 << 16)
+
+/* Return values of rs_next. */
+enum rs_status {RS_END, RS_OK, RS_BADLINE, RS_READERR};
+
+typedef struct {
+    FILE* f;
+    char* buf;
+    size_t pos;         // offset of the first unread char
+    size_t len;         // number of chars in the buffer
+    bool eof;           // whether F has been read to the end
+    ptrdiff_t lineno;   // line number of the last line read
+} RecordStream;
+
+/* Initialize RS to read records from F. Return false if there is
+insufficient memory. */
+bool rs_open(RecordStream* rs, FILE* f);
+
+/* Deserialize the next line into REC. Return RS_OK on success, RS_END if
+there are no more lines, RS_BADLINE if the line (numbered by RS's lineno)
+is too long or cannot be deserialized, or RS_READERR if reading failed. A
+bad line is skipped, so reading may continue past it. */
+enum rs_status rs_next(RecordStream* rs, Record* rec);
+
+/* Deallocate. F is not closed. */
+void rs_close(RecordStream* rs);
+
+/* Predicate over records. A record matches if it is dated DT0 to DT1,
+and for each nonempty pattern list, at least one pattern is a substring of
+the corresponding member, ignoring case. */
+typedef struct {
+    int32_t dt0;
+    int32_t dt1;
+    int ncats;          // number of category patterns; 0 for any category
+    char* cats;         // lowercased patterns, each followed by NUL
+    int ndescs;
+    char* descs;
+} RecordFilter;
+
+/* Initialize RF. CATS and DESCS are lists of patterns separated by DELIM,
+or NULL to match any category or description. Return false if there is
+insufficient memory. */
+bool rs_initfilter(
+    RecordFilter* rf, int32_t dt0, int32_t dt1,
+    const char* cats, const char* descs, int delim
+);
+
+/* Check if REC matches RF. */
+bool rs_match(const RecordFilter* rf, const Record* rec);
+
+/* Check if category CAT matches RF's category patterns. */
+bool rs_matchcat(const RecordFilter* rf, const char* cat);
+
+/* Deallocate. */
+void rs_freefilter(RecordFilter* rf);
+
+#endif
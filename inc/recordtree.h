@@ -12,8 +12,9 @@
 /* Day indices start at this number. */
 #define RT_UI_FIRST_DIND 1
 
-/* Initialize using record list. Record list must already be initialized
-and the active slice must be nonempty. Return NULL if insufficient memory. */
+/* Initialize using the selected records of the record list. Record list
+must already be initialized and the selection must be nonempty. Return
+NULL if insufficient memory. */
 bool rt_init(void);
 
 void rt_deinit(void);
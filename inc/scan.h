@@ -0,0 +1,61 @@
+/*
+ * Newline and delimiter scanning over large buffers.
+ *
+ * Buffers are processed in blocks, using AVX2 or SSE2 where the CPU
+ * supports them and scalar code otherwise. Each block is reduced to
+ * bitmasks of newline and delimiter positions, so work is proportional to
+ * the number of matches rather than the number of chars.
+ */
+
+#ifndef LGR_SCAN_H
+#define LGR_SCAN_H
+
+#include <stddef.h>
+
+/* Maximum number of delimiters recorded per line. */
+#define SCAN_MAXDELIMS 3
+
+/* Instruction sets, in increasing order of preference. */
+enum scan_level {SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2};
+
+/* A line found by scan_lines. */
+typedef struct {
+    size_t start;                   // offset of the line's first char
+    size_t len;                     // line length, excluding the newline
+    int ndelims;                    // delimiters found, up to SCAN_MAXDELIMS
+    size_t delims[SCAN_MAXDELIMS];  // delimiter offsets relative to START
+} ScanLine;
+
+/* Use at most LEVEL, subject to CPU support. Return the level in use. The
+best supported level is used by default. */
+enum scan_level scan_setlevel(enum scan_level level);
+
+/* Count the newlines in the LEN chars at S. */
+ptrdiff_t scan_count(const char* s, size_t len);
+
+/*
+ * Find lines and delimiter positions.
+ *
+ * Parameters
+ * ----------
+ * s, len
+ *      The buffer to scan. A final line need not end with a newline.
+ * pos
+ *      Offset in S to start scanning from. Must be at the start of a line.
+ *      Updated to the start of the first line not yet returned.
+ * delim
+ *      Delimiter char. Must not be the newline or NUL.
+ * lines, cap
+ *      Store up to CAP lines in LINES, recording the first
+ *      SCAN_MAXDELIMS occurrences of DELIM in each.
+ *
+ * Returns
+ * -------
+ * The number of lines stored. 0 once S is exhausted.
+ */
+ptrdiff_t scan_lines(
+    const char* s, size_t len, size_t* pos, int delim,
+    ScanLine* lines, ptrdiff_t cap
+);
+
+#endif
@@ -2,6 +2,7 @@
 #define LGR_UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 
@@ -13,6 +14,49 @@
 /* Check if file FP exists. */
 bool util_fexists(const char* fp);
 
+/* Store file FP's size in bytes and last modification time. Return false
+if FP cannot be queried, in which case both are set to 0. */
+bool util_fstat(const char* fp, int64_t* size, int64_t* mtime);
+
+/* Set F's position to OFFSET bytes from the beginning of the file. Return
+false on failure. */
+bool util_fseek(FILE* f, int64_t offset);
+
+/* Flush F and truncate its file to LEN bytes. Return false on failure. */
+bool util_ftruncate(FILE* f, int64_t len);
+
+/* Call FN(ARG, NAME) with the NAME of each entry in the current
+directory, in no particular order. Return false if the directory cannot be
+read. */
+bool util_lsdir(void (*fn)(void* arg, const char* name), void* arg);
+
+/* Read-only view of a file's entire contents. */
+typedef struct {
+    const char* data;
+    size_t len;
+    bool mapped;    // true if DATA is memory-mapped, false if allocated
+} FileView;
+
+/* Map the contents of F into VIEW. If the file cannot be memory-mapped,
+read it into an allocated buffer instead. Return false on failure. */
+bool util_mapfile(FILE* f, FileView* view);
+
+/* Release a view created by util_mapfile. */
+void util_unmapfile(FileView* view);
+
+/* Return the number of online processors, or 1 if unknown. */
+int util_ncpus(void);
+
+/* Call FN(ARG, I) for each I from 0 to COUNT-1, each on its own thread,
+and wait for all calls to return. Call 0 runs on the calling thread. If a
+thread cannot be created, its call runs on the calling thread instead. */
+void util_parallel(int count, void (*fn)(void* arg, int i), void* arg);
+
+/* Return a 64-bit hash of the LEN chars at S. Suitable for detecting
+changes in large buffers, processing 32 chars per step. Not suitable for
+security purposes. */
+uint64_t util_hash(const char* s, size_t len);
+
 /*
  * Count the number of decimal digits in X. If NEGSIGN is true, consider
  * the negative sign to be a digit.
@@ -45,6 +89,20 @@ int util_fmtcents(intmax_t x, char* buf);
 /* Return the number of chars needed to format X into a monetary string. */
 int util_fmtcentslen(intmax_t x);
 
+/* Convert an integer to a decimal string, writing at most 20 chars. Does
+NOT write NUL at the end. Return the number of chars written. */
+int util_fmtint(intmax_t x, char* buf);
+
+/* Convert an integral cent quantity to a string with two decimal places
+and no thousands separators, such as "-1234.50", writing at most 21 chars.
+Does NOT write NUL at the end. Return the number of chars written. */
+int util_fmtdecimal(intmax_t x, char* buf);
+
+/* Convert a nonnegative integer to a decimal string of exactly WIDTH chars,
+zero-padding on the left and dropping excess leading digits. Does NOT write
+NUL at the end. */
+void util_fmtfixed(intmax_t x, int width, char* buf);
+
 /*
  * Convert a decimal string to an integer.
  * 
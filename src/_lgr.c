@@ -22,21 +22,31 @@ Usage: " PROG_NAME " <command>\n\
 Commands:\n\
     init    Initialize a new lgr directory.\n\
     log     Log a transaction.\n\
+    import  Import transactions from a file.\n\
     view    View transactions.\n\
+    export  Export transactions for other programs.\n\
     rm      Remove a transaction.\n\
     sum     Get totals by category.\n\
     plot    Plot monthly totals.\n\
     lim     Work with limits for registered accounts.\n\
+    convert Write transactions in another storage format.\n\
+    archive Move a closed year's transactions into an archive.\n\
+    check   Check the ledger for lines that cannot be loaded.\n\
 "
 
 // The below functions must call exit().
 void main_init(int argc, char** argv);
 void main_log(int argc, char** argv);
+void main_import(int argc, char** argv);
 void main_view(int argc, char** argv);
+void main_export(int argc, char** argv);
 void main_rm(int argc, char** argv);
 void main_sum(int argc, char** argv);
 void main_plot(int argc, char** argv);
 void main_lim(int argc, char** argv);
+void main_convert(int argc, char** argv);
+void main_archive(int argc, char** argv);
+void main_check(int argc, char** argv);
 
 int main(int argc, char** argv)
 {
@@ -57,11 +67,16 @@ int main(int argc, char** argv)
 
     TRY_DELEGATE(init);
     TRY_DELEGATE(log);
+    TRY_DELEGATE(import);
     TRY_DELEGATE(view);
+    TRY_DELEGATE(export);
     TRY_DELEGATE(rm);
     TRY_DELEGATE(sum);
     TRY_DELEGATE(plot);
     TRY_DELEGATE(lim);
+    TRY_DELEGATE(convert);
+    TRY_DELEGATE(archive);
+    TRY_DELEGATE(check);
 
     prog_err("invalid command '%s'", cmd);
 }
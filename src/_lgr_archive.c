@@ -0,0 +1,50 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "program.h"
+
+#define HELP "\
+Move a closed year's transactions out of the ledger into an archive.\n\
+Usage: " PROG_NAME " archive <year>\n\
+\n\
+The archive '" PROG_NAME "_archive_<year>.bin' stores the transactions\n\
+compactly along with their totals by month and category, so loading the\n\
+ledger no longer reads them. 'sum', 'plot' and 'lim' use the stored totals\n\
+where they can, and 'view' and 'export' read the transactions back when\n\
+their time range includes the year. Transactions can no longer be logged\n\
+in or removed from the year.\n\
+\n\
+If archiving was interrupted, archive the year again to finish.\n\
+\n\
+Positional arguments:\n\
+    <year>      'yN' or integer from 13 to 9999. Must be before the current\n\
+                year.\n\
+\n\
+Examples:\n\
+    Archive last year:\n\
+        " PROG_NAME " archive y-1\n\
+"
+
+void main_archive(int argc, char** argv)
+{
+    argc -= PROG_ARGSTART;
+    argv += PROG_ARGSTART;
+    for (int i = 0; i < argc; i++)
+        if (strcmp(argv[i], "-h") == 0)
+            prog_pexit(HELP);
+    prog_loadconf();
+
+    if (argc == 0)
+        prog_err_missingargs();
+    int y;
+    if (!prog_parsey(argv[0], &y))
+        prog_err("invalid <year>");
+    if (y >= dt_gety(dt_today()))
+        prog_err("%d is not over yet", y);
+
+    ptrdiff_t count = prog_archive(y);
+    printf("Archived %td transactions from %d.\n", count, y);
+    exit(EXIT_SUCCESS);
+}
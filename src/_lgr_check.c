@@ -0,0 +1,75 @@
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "record.h"
+#include "recordcheck.h"
+#include "program.h"
+
+#define HELP "\
+Check the ledger for lines that cannot be loaded.\n\
+Usage: " PROG_NAME " check [-f]\n\
+\n\
+Every line of the data file is checked, and each malformed line, amount\n\
+out of range, or transaction dated before the one preceding it is\n\
+reported. Checksums of each month's lines are saved in\n\
+'" PROG_CHECKFN "', so the next check only deserializes the months\n\
+that changed since. A 'bin' data file is checked by loading it.\n\
+\n\
+Options:\n\
+    -f          Check every line, ignoring the saved checksums.\n\
+"
+
+/* Descriptions of each issue kind. */
+static const char* const st_issues[] = {
+    [REC_FAULT_LONG] = "line too long",
+    [REC_FAULT_FIELDS] = "too few fields",
+    [REC_FAULT_DATE] = "invalid date",
+    [REC_FAULT_AMT] = "invalid amount",
+    [REC_FAULT_RANGE] = "amount out of range",
+    [REC_FAULT_CAT] = "empty category",
+    [RC_UNSORTED] = "dated before the previous transaction",
+};
+
+/* prog_check callback. */
+static void report(void* arg, const char* name, const RcIssue* issue)
+{
+    (void)arg;
+    printf("%s:%" PRId64 ": %s\n", name, issue->line, st_issues[issue->kind]);
+}
+
+void main_check(int argc, char** argv)
+{
+    bool full = false;
+    optind = PROG_ARGSTART;
+    for (struct option longopts[] = {{0}};;) {
+        int c = getopt_long(argc, argv, ":hf", longopts, NULL);
+        if (c == -1) break;
+        switch (c) {
+            case 'h':
+                prog_pexit(HELP);
+            case 'f':
+                full = true;
+                break;
+            case ':':
+                prog_err_optnoval(optopt);
+            default:
+                prog_err_optunknown(optopt);
+        }
+    }
+    prog_loadconf();
+
+    int64_t lines, parsed;
+    ptrdiff_t nissues = prog_check(full, report, NULL, &lines, &parsed);
+    printf(
+        "Checked %" PRId64 " lines, %" PRId64 " deserialized: ",
+        lines, parsed
+    );
+    if (nissues == 0)
+        puts("no problems found.");
+    else
+        printf("%td problem%s found.\n", nissues, (nissues == 1) ? "" : "s");
+    exit(nissues ? EXIT_FAILURE : EXIT_SUCCESS);
+}
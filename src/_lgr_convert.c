@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "recordlist.h"
+#include "program.h"
+
+#define HELP "\
+Write all transactions in another storage format.\n\
+Usage: " PROG_NAME " convert <format> [<file>]\n\
+\n\
+Changes not yet written to the data file are included and written to it\n\
+too, and archived years are left in their archives. Set\n\
+'" PROG_CONF_DATA_FORMAT "' in '" PROG_IDFN "' to choose the format lgr reads and\n\
+writes: 0 for tsv (the default), 1 for bin, or 2 for years.\n\
+\n\
+Positional arguments:\n\
+    <format>    'tsv' for text, 'bin' for the binary columnar format, or\n\
+                'years' for one text file per year. With years, commands\n\
+                only read and rewrite the years they need.\n\
+    <file>      Output file. Defaults to '" PROG_DATAFN "' for tsv and\n\
+                '" PROG_BINFN "' for bin. Not allowed for years, which\n\
+                always writes '" PROG_NAME "_data_<year>.tsv' files.\n\
+\n\
+Examples:\n\
+    Switch to the binary format:\n\
+        " PROG_NAME " convert bin\n\
+        (then add '" PROG_CONF_DATA_FORMAT "=1' to '" PROG_IDFN "')\n\
+    Back up a binary ledger as text:\n\
+        " PROG_NAME " convert tsv backup.tsv\n\
+    Split a ledger into one file per year:\n\
+        " PROG_NAME " convert years\n\
+        (then add '" PROG_CONF_DATA_FORMAT "=2' to '" PROG_IDFN "')\n\
+"
+
+int main_convert(int argc, char** argv)
+{
+    argc -= PROG_ARGSTART;
+    argv += PROG_ARGSTART;
+    for (int i = 0; i < argc; i++)
+        if (strcmp(argv[i], "-h") == 0)
+            prog_pexit(HELP);
+    prog_loadconf();
+
+    // parse format and output file
+    if (argc == 0)
+        prog_err_missingargs();
+    enum prog_format format;
+    if (strcmp(argv[0], "tsv") == 0)
+        format = PROG_FORMAT_TSV;
+    else if (strcmp(argv[0], "bin") == 0)
+        format = PROG_FORMAT_BIN;
+    else if (strcmp(argv[0], "years") == 0)
+        format = PROG_FORMAT_YEARS;
+    else
+        prog_err("invalid <format>");
+
+    // year files always replace those in use
+    if (format == PROG_FORMAT_YEARS) {
+        if (argc >= 2)
+            prog_err("<file> cannot be given for years");
+        prog_initrl();
+        prog_convert(format, NULL);
+        printf("Wrote %td transactions to '" PROG_NAME "_data_<year>.tsv' files.\n", rl_count());
+        exit(EXIT_SUCCESS);
+    }
+    const char* deffn = (format == PROG_FORMAT_BIN) ? PROG_BINFN : PROG_DATAFN;
+    const char* fn = (argc >= 2) ? argv[1] : deffn;
+
+    // the data file in use may only be rewritten in its own format
+    prog_initrl();
+    const char* datafn = prog_datafn();
+    if (datafn && strcmp(fn, datafn) == 0) {
+        if (strcmp(deffn, datafn) != 0)
+            prog_err("cannot overwrite '%s' with another format", fn);
+        prog_writerl();
+    } else {
+        prog_convert(format, fn);
+    }
+
+    printf("Wrote %td transactions to '%s'.\n", rl_count(), fn);
+    exit(EXIT_SUCCESS);
+}
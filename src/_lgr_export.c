@@ -0,0 +1,413 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+#include "date.h"
+#include "util.h"
+#include "hashtable.h"
+#include "outbuf.h"
+#include "record.h"
+#include "recordarrow.h"
+#include "recordlist.h"
+#include "recordstream.h"
+#include "program.h"
+
+#define CMD PROG_NAME " export"
+
+#define HELP "\
+Export transactions in a given time range for use in other programs.\n\
+Usage: " CMD " [-F <fmt>] [-c <cat>] [-d <desc>] [<month>] [<year>]\n\
+       " CMD " [-F <fmt>] [-c <cat>] [-d <desc>] -a\n\
+       " CMD " [-F <fmt>] [-c <cat>] [-d <desc>] -s <date0> [<date1>]\n\
+\n\
+Transactions are written to standard output in date order, with 'date',\n\
+'amount', 'category' and 'description' fields. Text formats have one\n\
+transaction per line and amounts in dollars. Inflows are positive. Time\n\
+ranges and filters are as for '" PROG_NAME " view'. If no time range\n\
+arguments are provided, use the current month.\n\
+\n\
+Options:\n\
+    -F, --format <fmt>\n\
+                'csv' (the default) for comma-separated values with a\n\
+                header line, 'ndjson' for one JSON object per line, or\n\
+                'arrow' for an Arrow IPC file with amounts in cents and\n\
+                dictionary encoded categories.\n\
+    -a          Include all transactions regardless of date.\n\
+    -s          Use specific dates to specify time range.\n\
+    -c <cat>    Comma-separated patterns to filter categories with.\n\
+    -d <desc>   Comma-separated patterns to filter descriptions with.\n\
+\n\
+Positional arguments:\n\
+    <month>     'mN' or integer from 1 to 12.\n\
+    <year>      'yN' or integer from 13 to 9999.\n\
+    <date0>     First date of time range. 'dN' or 'yyyy-mm-dd'.\n\
+    <date1>     Last date of time range. 'dN' or 'yyyy-mm-dd'. If omitted,\n\
+                <date0> will be used.\n\
+\n\
+Examples:\n\
+    Export all transactions as CSV:\n\
+        " CMD " -a > ledger.csv\n\
+    Export current year dining transactions as NDJSON:\n\
+        " CMD " --format ndjson -c dining y\n\
+    Export all transactions for a dataframe library:\n\
+        " CMD " -a -F arrow > ledger.arrow\n\
+"
+
+enum format {CSV, NDJSON, ARROW};
+
+/* Most chars a field of LEN chars can take once quoted or escaped. */
+#define ESCAPEDLEN(len) (6 * (len) + 2)
+
+/* Most chars written for one record in a text format. */
+#define RECLEN ( \
+    64 + DT_ISOLEN + 21 \
+    + ESCAPEDLEN(REC_CATLEN) \
+    + ESCAPEDLEN(REC_DESCLEN) \
+)
+
+
+// Writers
+//
+// Each writer formats one record into BUF and returns the number of chars
+// written, which is at most RECLEN.
+
+/* Write S as a CSV field, quoting it if it contains a comma, quote or
+carriage return. */
+static char* csvfield(char* p, const char* s)
+{
+    if (!strpbrk(s, ",\"\r")) {
+        size_t len = strlen(s);
+        memcpy(p, s, len);
+        return p + len;
+    }
+    *p++ = '"';
+    for (; *s; s++) {
+        if (*s == '"')
+            *p++ = '"';
+        *p++ = *s;
+    }
+    *p++ = '"';
+    return p;
+}
+
+static int writecsv(const Record* rec, char* buf)
+{
+    char* p = buf;
+    p += dt_writeiso(rec->dt, p);
+    *p++ = ',';
+    p += util_fmtdecimal(rec->amt, p);
+    *p++ = ',';
+    p = csvfield(p, rec->cat);
+    *p++ = ',';
+    p = csvfield(p, rec->desc);
+    *p++ = '\n';
+    return p - buf;
+}
+
+/* Write S as a JSON string. */
+static char* jsonstr(char* p, const char* s)
+{
+    static const char hex[] = "0123456789abcdef";
+    *p++ = '"';
+    for (; *s; s++) {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\') {
+            *p++ = '\\';
+            *p++ = c;
+        } else if (c < 0x20) {
+            memcpy(p, "\\u00", 4);
+            p[4] = hex[c >> 4];
+            p[5] = hex[c & 0xf];
+            p += 6;
+        } else {
+            *p++ = c;
+        }
+    }
+    *p++ = '"';
+    return p;
+}
+
+/* Append the string literal S. */
+#define PUTLIT(p, s) (memcpy(p, s, sizeof(s) - 1), (p) += sizeof(s) - 1)
+
+static int writendjson(const Record* rec, char* buf)
+{
+    char* p = buf;
+    PUTLIT(p, "{\"date\":\"");
+    p += dt_writeiso(rec->dt, p);
+    PUTLIT(p, "\",\"amount\":");
+    p += util_fmtdecimal(rec->amt, p);
+    PUTLIT(p, ",\"category\":");
+    p = jsonstr(p, rec->cat);
+    PUTLIT(p, ",\"description\":");
+    p = jsonstr(p, rec->desc);
+    PUTLIT(p, "}\n");
+    return p - buf;
+}
+
+/* Write the records from index START to STOP that match RF as an Arrow IPC
+file. Matches are found and their categories numbered first, since the
+dictionary precedes every batch, then each batch is copied out of the
+record list's columns and written. */
+static void writearrow(const RecordFilter* rf, ptrdiff_t start, ptrdiff_t stop)
+{
+    ptrdiff_t* sel = malloc((stop - start + 1) * sizeof(*sel));
+    HashTable* cats = ht_new(HT_STR);
+    if (sel == NULL || cats == NULL)
+        prog_err_nomem();
+    ptrdiff_t count = 0;
+    for (ptrdiff_t i = start; i < stop; i++) {
+        const Record* rec = rl_get(i);
+        if (rs_match(rf, rec)) {
+            sel[count++] = i;
+            if (!ht_insert(cats, rec->cat, ht_count(cats)))
+                prog_err_nomem();
+        }
+    }
+
+    Record* batch = malloc((util_min(count, RA_BATCHLEN) + 1) * sizeof(*batch));
+    if (batch == NULL)
+        prog_err_nomem();
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    RaFile* ra = ra_open(stdout, cats);
+    if (ra == NULL)
+        prog_err_nomem();
+    for (ptrdiff_t first = 0; first < count; first += RA_BATCHLEN) {
+        ptrdiff_t len = util_min(count - first, RA_BATCHLEN);
+        for (ptrdiff_t j = 0; j < len; j++)
+            batch[j] = *rl_get(sel[first + j]);
+        ra_append(ra, batch, len);
+    }
+    if (!ra_close(ra))
+        prog_err_write("<stdout>");
+    free(batch);
+    free(sel);
+    ht_free(cats);
+}
+
+
+// Out-of-Core Writers
+//
+// Ledgers too large for memory_max are streamed instead of loaded.
+
+/* Destination of streamed records in a text format. */
+typedef struct {
+    OutBuf* ob;
+    int (*writerec)(const Record*, char*);
+} TextSink;
+
+static void streamtext(void* arg, const Record* rec)
+{
+    TextSink* sink = arg;
+    ob_commit(sink->ob, sink->writerec(rec, ob_reserve(sink->ob, RECLEN)));
+}
+
+static void streamcat(void* cats, const Record* rec)
+{
+    if (!ht_insert(cats, rec->cat, ht_count(cats)))
+        prog_err_nomem();
+}
+
+/* Destination of streamed records in an Arrow IPC file. */
+typedef struct {
+    RaFile* ra;
+    Record* batch;
+    ptrdiff_t len;
+    ptrdiff_t cap;
+} ArrowSink;
+
+static void streamarrow(void* arg, const Record* rec)
+{
+    ArrowSink* sink = arg;
+    sink->batch[sink->len++] = *rec;
+    if (sink->len == sink->cap) {
+        ra_append(sink->ra, sink->batch, sink->len);
+        sink->len = 0;
+    }
+}
+
+/* Write the records matching RF as an Arrow IPC file, streaming the
+ledger twice: once to number the categories for the dictionary, which
+precedes every batch, then to write batches small enough for memory_max. */
+static void streamarrowfile(const RecordFilter* rf)
+{
+    HashTable* cats = ht_new(HT_STR);
+    if (cats == NULL)
+        prog_err_nomem();
+    prog_streamrl(rf, true, streamcat, cats);
+
+    int64_t budget = prog_getconf(PROG_CONF_MEMORY_MAX) / (int64_t)sizeof(Record);
+    ArrowSink sink = {.cap = util_max(1, util_min(budget, RA_BATCHLEN))};
+    sink.batch = malloc(sink.cap * sizeof(*sink.batch));
+    if (sink.batch == NULL)
+        prog_err_nomem();
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    if ((sink.ra = ra_open(stdout, cats)) == NULL)
+        prog_err_nomem();
+    prog_streamrl(rf, true, streamarrow, &sink);
+    if (sink.len)
+        ra_append(sink.ra, sink.batch, sink.len);
+    if (!ra_close(sink.ra))
+        prog_err_write("<stdout>");
+    free(sink.batch);
+    ht_free(cats);
+}
+
+
+void main_export(int argc, char** argv)
+{
+    // parse options
+    enum usagetype {NORMAL, ALL, SPECIFIC};
+    enum usagetype usagetype = NORMAL;
+    enum format format = CSV;
+    const char* cat = NULL;
+    const char* desc = NULL;
+    optind = PROG_ARGSTART;
+    for (struct option longopts[] = {{"format", required_argument, NULL, 'F'}, {0}};;) {
+        int c = getopt_long(argc, argv, ":hF:c:d:as", longopts, NULL);
+        if (c == -1) break;
+        switch (c) {
+            case 'h':
+                prog_pexit(HELP);
+            case 'F':
+                if (strcmp(optarg, "csv") == 0)
+                    format = CSV;
+                else if (strcmp(optarg, "ndjson") == 0)
+                    format = NDJSON;
+                else if (strcmp(optarg, "arrow") == 0)
+                    format = ARROW;
+                else
+                    prog_err("invalid <fmt>");
+                break;
+            case 'c':
+                cat = optarg;
+                break;
+            case 'd':
+                desc = optarg;
+                break;
+            case 'a':
+                usagetype = ALL;
+                break;
+            case 's':
+                usagetype = SPECIFIC;
+                break;
+            case ':':
+                prog_err_optnoval(optopt);
+            default:
+                prog_err_optunknown(optopt);
+        }
+    }
+    prog_loadconf();
+
+    // parse time range bounds
+    argc -= optind;
+    argv += optind;
+    int32_t dt0 = INT32_MIN, dt1 = INT32_MAX;
+    if (usagetype == SPECIFIC) {
+        if (argc == 0)
+            prog_err("<date0> missing");
+        if (!prog_parsedt(argv[0], &dt0))
+            prog_err("invalid <date0>");
+        dt1 = dt0;
+        if (argc >= 2 && !prog_parsedt(argv[1], &dt1))
+            prog_err("invalid <date1>");
+        if (dt1 < dt0)
+            prog_err("<date1> preceeds <date0>");
+    } else if (usagetype == NORMAL) {
+        int m, y;
+        if (argc == 0) {
+            // neither month nor year given
+            dt0 = dt_setd(dt_today(), 1);
+            dt1 = dt_shiftd(dt_shiftm(dt0, 1), -1);
+        } else if (!prog_parsem(argv[0], &m)) {
+            // month not given
+            if (!prog_parsey(argv[0], &y))
+                prog_err("invalid <month> or <year>");
+            dt0 = dt_dt(y, 1, 1);
+            dt1 = dt_dt(y, 12, 31);
+        } else {
+            // month given
+            if (argc == 1)
+                y = dt_gety(dt_today());
+            else if (!prog_parsey(argv[1], &y))
+                prog_err("invalid <year>");
+            // m might not be between 1-12 so we need to wrap it back into that range
+            dt0 = dt_shiftm(dt_dt(y, 1, 1), m - 1);
+            if (!dt_isdt(dt0))
+                prog_err("month %d and year %d combination is invalid", m, y);
+            dt1 = dt_shiftd(dt_shiftm(dt0, 1), -1);
+        }
+    }
+
+    RecordFilter rf;
+    if (!rs_initfilter(&rf, dt0, dt1, cat, desc, ','))
+        prog_err_nomem();
+
+    // stream a ledger too large to load
+    if (prog_outofcore()) {
+        if (format == ARROW) {
+            streamarrowfile(&rf);
+            rs_freefilter(&rf);
+            exit(EXIT_SUCCESS);
+        }
+        OutBuf ob;
+        if (!ob_open(&ob, stdout, OB_DEFAULTCAP))
+            prog_err_nomem();
+        if (format == CSV)
+            ob_write(&ob, "date,amount,category,description\n", 33);
+        TextSink sink = {&ob, (format == CSV) ? writecsv : writendjson};
+        prog_streamrl(&rf, true, streamtext, &sink);
+        rs_freefilter(&rf);
+        if (!ob_close(&ob))
+            prog_err_write("<stdout>");
+        exit(EXIT_SUCCESS);
+    }
+
+    // init/slice record list, including archived years; patterns are
+    // matched per record as it is written rather than by narrowing the
+    // slice first
+    if (usagetype == ALL) {
+        prog_initrl();
+        prog_loadarchives(dt0, dt1);
+    } else {
+        prog_initrlrange(dt0, dt1);
+        prog_loadarchives(dt0, dt1);
+        rl_slice(dt0, dt1);
+    }
+
+    // write
+    ptrdiff_t start = (usagetype == ALL) ? 0 : rl_slicestart();
+    ptrdiff_t stop = (usagetype == ALL) ? rl_count() : rl_slicestop();
+    if (format == ARROW) {
+        writearrow(&rf, start, stop);
+        rs_freefilter(&rf);
+        exit(EXIT_SUCCESS);
+    }
+    OutBuf ob;
+    if (!ob_open(&ob, stdout, OB_DEFAULTCAP))
+        prog_err_nomem();
+    if (format == CSV)
+        ob_write(&ob, "date,amount,category,description\n", 33);
+    int (*writerec)(const Record*, char*) = (format == CSV) ? writecsv : writendjson;
+    for (ptrdiff_t i = start; i < stop; i++) {
+        const Record* rec = rl_get(i);
+        if (rs_match(&rf, rec))
+            ob_commit(&ob, writerec(rec, ob_reserve(&ob, RECLEN)));
+    }
+    rs_freefilter(&rf);
+    if (!ob_close(&ob))
+        prog_err_write("<stdout>");
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,200 @@
+#include <getopt.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "record.h"
+#include "program.h"
+
+#define HELP "\
+Import transactions from a file.\n\
+Usage: " PROG_NAME " import [-c] [-s] <file>\n\
+\n\
+Each line of <file> holds one transaction's <date>, <amt>, <cat> and\n\
+optionally <desc>, separated by tabs. Dates are 'yyyy-mm-dd' and amounts\n\
+are in dollars as for '" PROG_NAME " log', but signed: inflows are positive.\n\
+Lines that cannot be imported are reported and skipped. The rest are\n\
+merged into the ledger, which is written once. For a ledger too large for\n\
+'" PROG_CONF_MEMORY_MAX "', the transactions are sorted in temporary files and\n\
+merged in as the ledger is rewritten.\n\
+\n\
+Options:\n\
+    -c          Fields are separated by commas instead. A field may be\n\
+                enclosed in double quotes, within which commas are kept\n\
+                and '\"\"' stands for a double quote.\n\
+    -s          Import nothing if any line cannot be imported.\n\
+\n\
+Positional arguments:\n\
+    <file>      File to import, or '-' for standard input.\n\
+"
+
+/* Longest line accepted, excluding the newline. */
+#define LINELEN 1023
+
+/* Number of fields in a line, the last of which is optional. */
+#define NFIELDS 4
+
+/* Split LINE at tabs into at most NFIELDS fields, storing them in FIELDS.
+The last field takes the rest of the line. Return the number of fields. */
+static int splittsv(char* line, char** fields)
+{
+    int n = 0;
+    fields[n++] = line;
+    for (char* p; n < NFIELDS && (p = strchr(fields[n-1], '\t'));) {
+        *p = '\0';
+        fields[n++] = p + 1;
+    }
+    return n;
+}
+
+/* Split LINE at commas into fields, unquoting them in place and storing
+them in FIELDS. Return the number of fields, or -1 if there are more than
+NFIELDS or a quote is unterminated. */
+static int splitcsv(char* line, char** fields)
+{
+    int n = 0;
+    char* p = line;
+    while (true) {
+        if (n == NFIELDS)
+            return -1;
+        char* out = p;
+        fields[n++] = out;
+        if (*p == '"') {
+            for (p++;; p++) {
+                if (*p == '\0')
+                    return -1;
+                if (*p == '"' && p[1] != '"')
+                    break;
+                p += (*p == '"');
+                *out++ = *p;
+            }
+            p++;
+        } else {
+            for (; *p && *p != ','; p++)
+                *out++ = *p;
+        }
+        if (*p != ',' && *p != '\0')
+            return -1;
+        bool last = (*p == '\0');
+        *out = '\0';
+        if (last)
+            return n;
+        p++;
+    }
+}
+
+/* Parse the record in LINE into REC. Return NULL on success, or a
+description of the problem. */
+static const char* parseline(char* line, bool csv, Record* rec)
+{
+    char* fields[NFIELDS];
+    int n = csv ? splitcsv(line, fields) : splittsv(line, fields);
+    if (n < 0)
+        return "too many fields or unterminated quote";
+    if (n < NFIELDS - 1)
+        return "not enough fields";
+
+    int32_t dt;
+    if (!dt_isiso(fields[0]) || !dt_isdt(dt = dt_fromiso(fields[0])))
+        return "invalid date";
+    if (prog_isarchived(dt_gety(dt)))
+        return "year is archived";
+    int64_t amt;
+    if (!prog_parsecents(fields[1], &amt) || amt == 0 || amt > REC_AMT_MAX || amt < REC_AMT_MIN)
+        return "invalid amount";
+    const char* desc = (n == NFIELDS) ? fields[3] : "";
+    if (strchr(desc, '\n') || NULL == rec_init(rec, dt, amt, fields[2], desc))
+        return "invalid category";
+    return NULL;
+}
+
+void main_import(int argc, char** argv)
+{
+    bool csv = false, strict = false;
+    optind = PROG_ARGSTART;
+    for (struct option longopts[] = {{0}};;) {
+        int c = getopt_long(argc, argv, ":hcs", longopts, NULL);
+        if (c == -1) break;
+        switch (c) {
+            case 'h':
+                prog_pexit(HELP);
+            case 'c':
+                csv = true;
+                break;
+            case 's':
+                strict = true;
+                break;
+            case ':':
+                prog_err_optnoval(optopt);
+            default:
+                prog_err_optunknown(optopt);
+        }
+    }
+    prog_loadconf();
+    if (optind >= argc)
+        prog_err_missingargs();
+    const char* fn = argv[optind];
+    bool isstdin = (strcmp(fn, "-") == 0);
+    FILE* f = isstdin ? stdin : fopen(fn, "r");
+    if (f == NULL)
+        prog_err_read(fn);
+
+    // parse every line before touching the ledger; a ledger too large for
+    // memory gets a batch sorted in temporary files instead of an array
+    bool ooc = prog_outofcore();
+    RecordRuns rr;
+    if (ooc)
+        prog_runsopen(&rr);
+    ptrdiff_t count = 0, cap = ooc ? 1 : 256, skipped = 0;
+    Record* recs = malloc(cap * sizeof(*recs));
+    if (recs == NULL)
+        prog_err_nomem();
+    char buf[LINELEN + 2];
+    for (ptrdiff_t lineno = 1; fgets(buf, sizeof buf, f); lineno++) {
+        size_t len = strlen(buf);
+        bool complete = (len && buf[len-1] == '\n') || feof(f);
+        if (!complete) {
+            for (int c; (c = getc(f)) != EOF && c != '\n';);
+        }
+        while (len && (buf[len-1] == '\n' || buf[len-1] == '\r'))
+            buf[--len] = '\0';
+        if (complete && len == 0)
+            continue;
+
+        if (!ooc && count == cap) {
+            Record* new = realloc(recs, (cap *= 2) * sizeof(*new));
+            if (new == NULL)
+                prog_err_nomem();
+            recs = new;
+        }
+        Record* rec = ooc ? recs : recs + count;
+        const char* problem = complete ? parseline(buf, csv, rec) : "line too long";
+        if (problem == NULL) {
+            if (ooc)
+                prog_runsadd(&rr, rec);
+            count++;
+            continue;
+        }
+        if (strict)
+            prog_err("%s:%td: %s", fn, lineno, problem);
+        fprintf(stderr, "%s:%td: %s; skipped\n", fn, lineno, problem);
+        skipped++;
+    }
+    if (ferror(f))
+        prog_err_read(fn);
+    if (!isstdin)
+        fclose(f);
+
+    if (ooc)
+        prog_insertruns(&rr);
+    else if (count)
+        prog_insertmany(recs, count);
+    free(recs);
+    printf("Imported %td transactions", count);
+    if (skipped)
+        printf("; skipped %td lines", skipped);
+    puts(".");
+    exit(EXIT_SUCCESS);
+}
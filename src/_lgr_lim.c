@@ -1,5 +1,6 @@
 #include <getopt.h>
 #include <inttypes.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -7,7 +8,9 @@
 
 #include "util.h"
 #include "hashtable.h"
+#include "archive.h"
 #include "recordlist.h"
+#include "recordstream.h"
 #include "program.h"
 
 #define HELP "\
@@ -81,7 +84,8 @@ void main_lim(int argc, char** argv)
 
     HashTable* ht = read_lim();
     if (usagetype != SET) {
-        prog_initrl();
+        if (!prog_outofcore())
+            prog_initrl();
         ht_sort(ht, true, true);
     }
     switch (usagetype) {
@@ -199,36 +203,70 @@ static int64_t to_thisyear_lim(HashTable* ht)
     return acc;
 }
 
-/* Assume record list is initialized. */
-static int64_t to_thisyear_in(void)
+/* prog_sumarchives callback. Add T's inflows and outflows to the pair at
+SUMS. */
+static void addtotal(void* sums, int y, const ArTotal* t, const char* cat)
 {
-    rl_slice(
-        dt_dt(1, 1, 1),
-        dt_dt(dt_gety(dt_today()), 12, 31)
-    );
-    int64_t acc = 0;
-    for (ptrdiff_t i = rl_slicestart(); i < rl_slicestop(); i++) {
-        int64_t amt = rl_get(i)->amt;
-        if (amt > 0)
-            acc += amt;
+    (void)y;
+    (void)cat;
+    ((int64_t*)sums)[0] += t->in;
+    ((int64_t*)sums)[1] += t->out;
+}
+
+/* Return the total of archived inflows if IN, or the absolute total of
+archived outflows otherwise. Archived years are always over, so they count
+towards every limit. */
+static int64_t archived(bool in)
+{
+    RecordFilter rf;
+    if (!rs_initfilter(&rf, INT32_MIN, INT32_MAX, NULL, NULL, ','))
+        prog_err_nomem();
+    int64_t sums[2] = {0};
+    prog_sumarchives(&rf, addtotal, sums);
+    rs_freefilter(&rf);
+    return in ? sums[0] : -sums[1];
+}
+
+/* prog_streamrl callback. Add REC's amount to the inflow or outflow total
+in the pair at SUMS. */
+static void addrec(void* sums, const Record* rec)
+{
+    ((int64_t*)sums)[rec->amt < 0] += rec->amt;
+}
+
+/* Return the total of inflows if IN, or the absolute total of outflows
+otherwise, up to the end of year Y. Assume record list is initialized,
+unless the ledger runs out of core and is streamed instead. */
+static int64_t total(int y, bool in)
+{
+    int32_t dt0 = dt_dt(1, 1, 1), dt1 = dt_dt(y, 12, 31);
+    int64_t sums[2] = {0};
+    if (prog_outofcore()) {
+        RecordFilter rf;
+        if (!rs_initfilter(&rf, dt0, dt1, NULL, NULL, ','))
+            prog_err_nomem();
+        prog_streamrl(&rf, false, addrec, sums);
+        rs_freefilter(&rf);
+    } else {
+        rl_slice(dt0, dt1);
+        RlSpan span;
+        ptrdiff_t pos;
+        rl_foreachsel(span, pos)
+            for (ptrdiff_t i = 0; i < span.len; i++)
+                sums[span.amt[i] < 0] += span.amt[i];
     }
-    return acc;
+    return (in ? sums[0] : -sums[1]) + archived(in);
+}
+
+static int64_t to_thisyear_in(void)
+{
+    return total(dt_gety(dt_today()), true);
 }
 
-/* Assume record list is initialized. Return absolute value. */
+/* Return absolute value. */
 static int64_t to_lastyear_out(void)
 {
-    rl_slice(
-        dt_dt(1, 1, 1),
-        dt_dt(dt_gety(dt_today()) - 1, 12, 31)
-    );
-    int64_t acc = 0;
-    for (ptrdiff_t i = rl_slicestart(); i < rl_slicestop(); i++) {
-        int64_t amt = rl_get(i)->amt;
-        if (amt < 0)
-            acc -= amt;
-    }
-    return acc;
+    return total(dt_gety(dt_today()) - 1, false);
 }
 
 /* Assume hash table is sorted. */
@@ -266,14 +304,16 @@ static void print_rem(int64_t rem)
     printf("Current year remaining: %s\n", buf);
 }
 
-/* Assume hash table is sorted. Assume record list has been initialized. */
+/* Assume hash table is sorted. Assume record list has been initialized,
+unless the ledger runs out of core. */
 void print_rrsp(HashTable* ht)
 {
     print_lims(ht);
     print_rem(to_thisyear_lim(ht) - to_thisyear_in());
 }
 
-/* Assume hash table is sorted. Assume record list has been initialized. */
+/* Assume hash table is sorted. Assume record list has been initialized,
+unless the ledger runs out of core. */
 void print_tfsa(HashTable* ht)
 {
     print_lims(ht);
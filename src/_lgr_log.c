@@ -1,3 +1,4 @@
+#include <ctype.h>
 #include <getopt.h>
 #include <stdlib.h>
 #include <string.h>
@@ -12,6 +13,14 @@
 #define HELP "\
 Log a transaction.\n\
 Usage: " PROG_NAME " log [-i | -o] [-d <desc>] <cat> <amt> [<date>]\n\
+       " PROG_NAME " log [-i | -o] [-d <desc>] -\n\
+\n\
+With '-', read transactions from standard input instead, one per line in\n\
+the form '[-i | -o] [-d <desc>] <cat> <amt> [<date>]'. A word starting\n\
+with a quote (' or \") runs to the matching quote, so it may contain\n\
+spaces; quotes within a word are kept as is. Options given on the command\n\
+line are defaults for every line. All transactions are logged at once, or\n\
+none if any line is invalid.\n\
 \n\
 Options:\n\
     -i          <amt> is inflow. This is the default.\n\
@@ -25,6 +34,154 @@ Positional arguments:\n\
                 inputting 'dN', or specify an exact date with 'yyyy-mm-dd'.\n\
 "
 
+/* Longest line read from standard input, excluding the newline. */
+#define LINELEN 1023
+
+/* Most words in a line read from standard input. */
+#define MAXWORDS 8
+
+/* Initialize REC from this command's arguments, where SDATE is NULL for
+today. SIGN is 1 for inflows and -1 for outflows. Return NULL on success,
+or an error message. */
+static const char* makerec(
+    Record* rec, int sign, const char* cat, const char* samt,
+    const char* sdate, const char* desc
+) {
+    // parse cat
+    if (strchr(cat, *REC_DELIM) || strchr(cat, '\n'))
+        return "<cat> must not contains tab or newline characters";
+
+    // parse amt
+    int64_t amt;
+    if (!prog_parsecents(samt, &amt))
+        return "invalid <amt>";
+    if (amt <= 0)
+        return "<amt> must be positive";
+    if (amt > REC_AMT_MAX)
+        return "<amt> out of range";
+    amt *= sign;
+
+    // parse date
+    int32_t dt;
+    if (sdate == NULL)
+        dt = dt_today();
+    else if (!prog_parsedt(sdate, &dt))
+        return "invalid <date>";
+
+    // init
+    if (NULL == rec_init(rec, dt, amt, cat, desc))
+        return "cannot construct record";
+    return NULL;
+}
+
+/* Split LINE in place into whitespace-separated words, storing them in
+WORDS. A word starting with a single or double quote runs to the matching
+quote, so it may include whitespace; quotes anywhere else are kept as is,
+as in "joe's". Return the number of words, or -1 if there are more than
+MAXWORDS or a quote is unterminated. */
+static int splitwords(char* line, char** words)
+{
+    int n = 0;
+    for (char* p = line;;) {
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            return n;
+        if (n == MAXWORDS)
+            return -1;
+        char* out = p;
+        words[n++] = out;
+        const char* start = p;
+        for (char quote = 0; *p && (quote || !isspace((unsigned char)*p)); p++) {
+            if (quote ? *p == quote : (p == start && (*p == '"' || *p == '\'')))
+                quote = quote ? 0 : *p;
+            else
+                *out++ = *p;
+            if (quote && p[1] == '\0')
+                return -1;
+        }
+        if (*p)
+            p++;
+        *out = '\0';
+    }
+}
+
+/* Parse LINE, which is in the form of this command's arguments, into REC.
+SIGN and DESC are the defaults for options not given. Return NULL on
+success, or an error message. */
+static const char* parseline(char* line, int sign, const char* desc, Record* rec)
+{
+    char* words[MAXWORDS];
+    int n = splitwords(line, words);
+    if (n < 0)
+        return "too many words or unterminated quote";
+    const char* args[3];
+    int nargs = 0;
+    for (int i = 0; i < n; i++) {
+        const char* word = words[i];
+        if (strcmp(word, "-i") == 0) {
+            sign = 1;
+        } else if (strcmp(word, "-o") == 0) {
+            sign = -1;
+        } else if (strncmp(word, "-d", 2) == 0) {
+            if (word[2] == '\0' && i + 1 == n)
+                return "value missing for option '-d'";
+            desc = word[2] ? word + 2 : words[++i];
+        } else if (word[0] == '-' && word[1] != '\0') {
+            return "unknown option";
+        } else if (nargs == 3) {
+            return "too many arguments";
+        } else {
+            args[nargs++] = word;
+        }
+    }
+    if (nargs < 2)
+        return "not enough arguments";
+    return makerec(rec, sign, args[0], args[1], (nargs > 2) ? args[2] : NULL, desc);
+}
+
+/* Log every transaction on standard input with one load and one write.
+Exit program. */
+static void logmany(int sign, const char* desc)
+{
+    ptrdiff_t count = 0, cap = 64;
+    Record* recs = malloc(cap * sizeof(*recs));
+    if (recs == NULL)
+        prog_err_nomem();
+    char buf[LINELEN + 2];
+    for (ptrdiff_t lineno = 1; fgets(buf, sizeof buf, stdin); lineno++) {
+        size_t len = strlen(buf);
+        if (len && buf[len-1] == '\n')
+            buf[--len] = '\0';
+        else if (!feof(stdin))
+            prog_err("<stdin>:%td: line too long", lineno);
+
+        if (count == cap) {
+            Record* new = realloc(recs, (cap *= 2) * sizeof(*new));
+            if (new == NULL)
+                prog_err_nomem();
+            recs = new;
+        }
+        const char* p = buf;
+        while (isspace((unsigned char)*p))
+            p++;
+        if (*p == '\0')
+            continue;
+        const char* problem = parseline(buf, sign, desc, recs + count);
+        if (problem)
+            prog_err("<stdin>:%td: %s", lineno, problem);
+        count++;
+    }
+    if (ferror(stdin))
+        prog_err_read("<stdin>");
+
+    if (count)
+        prog_insertmany(recs, count);
+    free(recs);
+    printf("Logged %td transactions.\n", count);
+    exit(EXIT_SUCCESS);
+}
+
 void main_log(int argc, char** argv)
 {
     // parse options; get amt sign and desc if given
@@ -61,43 +218,20 @@ void main_log(int argc, char** argv)
     // parse other record components, then initialize record
     argc -= optind;
     argv += optind;
+    if (argc == 1 && strcmp(argv[0], "-") == 0)
+        logmany(sign, desc);
     if (argc < 2)
         prog_err_missingargs();
     Record rec;
-    {
-        // parse cat
-        const char* cat = argv[0];
-        if (strchr(cat, *REC_DELIM) || strchr(cat, '\n'))
-            prog_err("<cat> must not contains tab or newline characters");
-
-        // parse amt
-        int64_t amt;
-        if (!prog_parsecents(argv[1], &amt))
-            prog_err("invalid <amt>");
-        if (amt <= 0)
-            prog_err("<amt> must be positive");
-        if (amt > REC_AMT_MAX)
-            prog_err("<amt> out of range");
-        amt *= sign;
-
-        // parse date
-        int32_t dt;
-        if (argc < 3)
-            dt = dt_today();
-        else if (!prog_parsedt(argv[2], &dt))
-            prog_err("invalid <date>");
-
-        // init
-        if (NULL == rec_init(&rec, dt, amt, cat, desc))
-            prog_err("cannot construct record");
-    }
+    const char* problem = makerec(&rec, sign, argv[0], argv[1], (argc >= 3) ? argv[2] : NULL, desc);
+    if (problem)
+        prog_err("%s", problem);
 
-    // log record
-    prog_initrl();
-    if (rl_count() >= RL_MAXCOUNT)
-        prog_err("transaction count already at limit of %td", RL_MAXCOUNT);
-    rl_insert(&rec);
-    prog_writerl();
+    // log record; only the record's date needs to be loaded
+    prog_initrlrange(rec.dt, rec.dt);
+    if (NULL == rl_insert(&rec))
+        prog_err_nomem();
+    prog_journalins(&rec);
 
     // print data; skip if not enough mem
     rl_slice(rec.dt, rec.dt);
@@ -1,17 +1,22 @@
 #include <getopt.h>
 #include <math.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "util.h"
 #include "date.h"
+#include "archive.h"
 #include "recordlist.h"
+#include "recordstream.h"
 #include "program.h"
 
 #define HELP "\
 Plot monthly amount totals in the given time range.\n\
-Usage: " PROG_NAME " plot [-c <cat>] [-d <desc>] [<year0> [<year1>]]\n\
-       " PROG_NAME " plot [-c <cat>] [-d <desc>] -a\n\
+Usage: " PROG_NAME " plot [-f <file>] [-c <cat>] [-d <desc>] [<year0> [<year1>]]\n\
+       " PROG_NAME " plot [-f <file>] [-c <cat>] [-d <desc>] -a\n\
 \n\
 If no time range arguments are provided, use the latest 13 months.\n\
 \n\
@@ -19,6 +24,9 @@ Options:\n\
     -a          Include all transactions regardless of date.\n\
     -c <cat>    Comma-separated patterns to filter categories with.\n\
     -d <desc>   Comma-separated patterns to filter descriptions with.\n\
+    -f <file>   Read transactions from <file>, or standard input if '-',\n\
+                instead of the ledger. The file is read in a single pass\n\
+                without being loaded into memory, and need not be sorted.\n\
 \n\
 Positional arguments:\n\
     <year0>     First year of time range. 'yN' or integer from 1 to 9999.\n\
@@ -26,6 +34,31 @@ Positional arguments:\n\
                 omitted, <year0> will be used.\n\
 "
 
+typedef struct {
+    int64_t pos;
+    int64_t neg;    // absolute value
+    char label[sizeof "yyyy mmm"];
+} MonthEntry;
+
+/* Number of months from year 0 through year 9999. */
+#define NMONTHS (12 * 10000)
+
+/* Monthly totals indexed by y * 12 + m - 1, and the range of months with
+transactions. */
+typedef struct {
+    MonthEntry* entries;
+    int first;
+    int last;
+    ptrdiff_t count;    // number of transactions added
+} Months;
+
+static void addamt(Months* ms, int32_t dt, int64_t amt);
+static void addrec(Months* ms, const Record* rec);
+static void addtotal(void* ms, int y, const ArTotal* t, const char* cat);
+static void streamrec(void* ms, const Record* rec);
+static void streammonths(const char* fn, const RecordFilter* rf, Months* ms);
+static void plot(MonthEntry* entries, ptrdiff_t months);
+
 int main_plot(int argc, char** argv)
 {
     // parse options
@@ -33,9 +66,10 @@ int main_plot(int argc, char** argv)
     enum usagetype usagetype = NORMAL;
     const char* cat = NULL;
     const char* desc = NULL;
+    const char* fn = NULL;
     optind = PROG_ARGSTART;
     for (struct option longopts[] = {{0}};;) {
-        int c = getopt_long(argc, argv, ":hc:d:a", longopts, NULL);
+        int c = getopt_long(argc, argv, ":hc:d:f:a", longopts, NULL);
         if (c == -1) break;
         switch (c) {
             case 'h':
@@ -46,6 +80,9 @@ int main_plot(int argc, char** argv)
             case 'd':
                 desc = optarg;
                 break;
+            case 'f':
+                fn = optarg;
+                break;
             case 'a':
                 usagetype = ALL;
                 break;
@@ -55,7 +92,8 @@ int main_plot(int argc, char** argv)
                 prog_err_optunknown(optopt);
         }
     }
-    prog_loadconf();
+    if (fn == NULL)
+        prog_loadconf();
 
     // parse time range bounds
     argc -= optind;
@@ -82,43 +120,135 @@ int main_plot(int argc, char** argv)
         }
     }
 
-    // init/slice/filter record list
-    prog_initrl();
-    ptrdiff_t slicelen = (usagetype == ALL)
-        ? rl_count()
-        : rl_slice(dt0, dt1);
-    if (cat)
-        slicelen = rl_filtercat(cat, ',');
-    if (desc)
-        slicelen = rl_filterdesc(desc, ',');
+    // total a file as it is read, or init/slice/filter record list and add
+    // the totals of archived years
+    Months ms = {.entries = calloc(NMONTHS, sizeof(MonthEntry)), .first = NMONTHS};
+    if (ms.entries == NULL)
+        prog_err_nomem();
+    if (usagetype == ALL) {
+        dt0 = INT32_MIN;
+        dt1 = INT32_MAX;
+    }
+    RecordFilter rf;
+    if (!rs_initfilter(&rf, dt0, dt1, cat, desc, ','))
+        prog_err_nomem();
+    if (fn) {
+        streammonths(fn, &rf, &ms);
+    } else if (prog_outofcore()) {
+        prog_streamrl(&rf, false, streamrec, &ms);
+        prog_sumarchives(&rf, addtotal, &ms);
+    } else {
+        if (usagetype == ALL)
+            prog_initrl();
+        else
+            prog_initrlrange(dt0, dt1);
+        if (usagetype != ALL)
+            rl_slice(dt0, dt1);
+        if (cat)
+            rl_filtercat(cat, ',');
+        if (desc)
+            rl_filterdesc(desc, ',');
+        RlSpan span;
+        ptrdiff_t pos;
+        rl_foreachsel(span, pos)
+            for (ptrdiff_t i = 0; i < span.len; i++)
+                addamt(&ms, span.dt[i], span.amt[i]);
+        prog_sumarchives(&rf, addtotal, &ms);
+    }
+    rs_freefilter(&rf);
 
     // handle no records
-    if (slicelen == 0) {
+    if (ms.count == 0) {
         if (usagetype != ALL)
             prog_printdaterange(dt0, dt1);
         prog_pexit("No transactions.");
     }
 
-    // correct date limits
-    {
-        int32_t dt = rl_get(rl_slicestart())->dt;
-        if (usagetype == ALL || dt0 < dt)
-            dt0 = dt_setd(dt, 1);
-        dt = rl_get(rl_slicestop() - 1)->dt;
-        if (usagetype == ALL || dt1 > dt)
-            dt1 = dt_shiftd(dt_shiftm(dt_setd(dt, 1), 1), -1);
-    }
-
-    // print
+    // print the months from the first to the last with transactions
     #ifdef _WIN32
     system("color");
     #endif
-    void plot(int32_t dt0, int32_t dt1);
-    plot(dt0, dt1);
+    for (int i = ms.first; i <= ms.last; i++) {
+        int32_t dt = dt_dt(i / 12, i % 12 + 1, 1);
+        sprintf(ms.entries[i].label, "%04d %s", dt_gety(dt), dt_mmm(dt_getm(dt)));
+    }
+    plot(ms.entries + ms.first, ms.last - ms.first + 1);
+    free(ms.entries);
     exit(EXIT_SUCCESS);
 }
 
 
+// Totals
+
+/* Add COUNT transactions totaling POS and NEG (an absolute value) to month
+I. */
+static void addmonth(Months* ms, int i, int64_t pos, int64_t neg, ptrdiff_t count)
+{
+    MonthEntry* entry = ms->entries + i;
+    entry->pos += pos;
+    entry->neg += neg;
+    ms->first = util_min(ms->first, i);
+    ms->last = util_max(ms->last, i);
+    ms->count += count;
+}
+
+/* Add AMT to the totals of DT's month. */
+static void addamt(Months* ms, int32_t dt, int64_t amt)
+{
+    int i = dt_gety(dt) * 12 + dt_getm(dt) - 1;
+    if (amt >= 0)
+        addmonth(ms, i, amt, 0, 1);
+    else
+        addmonth(ms, i, 0, -amt, 1);
+}
+
+/* Add REC's amount to its month's totals. */
+static void addrec(Months* ms, const Record* rec)
+{
+    addamt(ms, rec->dt, rec->amt);
+}
+
+/* prog_streamrl callback. */
+static void streamrec(void* ms, const Record* rec)
+{
+    addrec(ms, rec);
+}
+
+/* prog_sumarchives callback. */
+static void addtotal(void* ms, int y, const ArTotal* t, const char* cat)
+{
+    (void)cat;
+    addmonth(ms, y * 12 + t->m - 1, t->in, -t->out, t->count);
+}
+
+/* Add each record in file FN (standard input if "-") matching RF to MS.
+Exit program on error. */
+static void streammonths(const char* fn, const RecordFilter* rf, Months* ms)
+{
+    bool isstdin = (strcmp(fn, "-") == 0);
+    FILE* f = isstdin ? stdin : fopen(fn, "r");
+    if (f == NULL)
+        prog_err_read(fn);
+    RecordStream rs;
+    if (!rs_open(&rs, f))
+        prog_err_nomem();
+
+    Record rec;
+    for (enum rs_status status; (status = rs_next(&rs, &rec)) != RS_END;) {
+        if (status == RS_READERR)
+            prog_err_read(fn);
+        if (status == RS_BADLINE)
+            prog_err("%s:%td: line too long or cannot be deserialized", fn, rs.lineno);
+        if (rs_match(rf, &rec))
+            addrec(ms, &rec);
+    }
+
+    rs_close(&rs);
+    if (!isstdin)
+        fclose(f);
+}
+
+
 // Plotting
 
 #define MAXBARS 60
@@ -157,12 +287,6 @@ typedef struct {
     int64_t totneg; // absolute value
 } PrintMeta;
 
-typedef struct {
-    int64_t pos;
-    int64_t neg;    // absolute value
-    char label[sizeof "yyyy mmm"];
-} MonthEntry;
-
 /* Draw A for lines that do not show "yyyy mmm". */
 static void drawa(const char* vdivider)
 {
@@ -213,43 +337,10 @@ static void plotmonth(PrintMeta* meta, MonthEntry* entry)
     putc('\n', stdout);
 }
 
-/* RL must already be sliced. */
-void plot(int32_t dt0, int32_t dt1)
+/* Plot the MONTHS labeled entries at ENTRIES. */
+static void plot(MonthEntry* entries, ptrdiff_t months)
 {
-    // get number of months spanning ts1 to ts2
-    PrintMeta meta = {
-        .months = (
-            12 * (dt_gety(dt1) - dt_gety(dt0))
-            + (dt_getm(dt1) - dt_getm(dt0))
-            + 1
-        )
-    };
-
-    // get monthly totals and labels
-    MonthEntry* entries = calloc(meta.months, sizeof(*entries));
-    if (entries == NULL)
-        prog_err_nomem();
-
-    // populate monthentry array data data
-    ptrdiff_t j = 0;
-    for (
-        int32_t next, cur = dt0
-        ; cur <= dt1
-        ; cur = next, j++
-    ) {
-        next = dt_shiftm(cur, 1);
-
-        sprintf(entries[j].label, "%04d %s", dt_gety(cur), dt_mmm(dt_getm(cur)));
-
-        rl_slice(cur, dt_shiftd(next, -1));
-        for (ptrdiff_t i = rl_slicestart(); i < rl_slicestop(); i++) {
-            int64_t amt = rl_get(i)->amt;
-            if (amt >= 0)
-                entries[j].pos += amt;
-            else
-                entries[j].neg -= amt;
-        }
-    }
+    PrintMeta meta = {.months = months};
 
     // fill rest of meta
     for (ptrdiff_t i = 0; i < meta.months; i++) {
@@ -46,15 +46,21 @@ int main_rm(int argc, char** argv)
     }
 
     // delete
-    prog_initrl();
+    if (prog_isarchived(dt_gety(dt)))
+        prog_err("%d is archived and cannot be changed", dt_gety(dt));
+    prog_initrlrange(dt, dt);
     ptrdiff_t slicelen = rl_slice(dt, dt);
     if (slicelen == 0)
         prog_err("no transactions to remove");
     if (index >= slicelen)
         prog_err("<index> out of bounds");
     index += (index == -1) ? rl_slicestop() : rl_slicestart();
+    ptrdiff_t dind = index - rl_slicestart();
     rl_delete(index);
-    prog_writerl();
+    prog_journaldel(dt, dind);
+
+    // journaling may have reloaded the full list
+    rl_slice(dt, dt);
 
     // print data; skip if not enough mem
     if (0 == rl_slicestop() - rl_slicestart()) {
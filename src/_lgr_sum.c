@@ -1,5 +1,7 @@
 #include <getopt.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -7,16 +9,18 @@
 #include "date.h"
 #include "record.h"
 #include "hashtable.h"
+#include "archive.h"
 #include "recordlist.h"
+#include "recordstream.h"
 #include "program.h"
 
 #define CMD PROG_NAME " sum"
 
 #define HELP "\
 Sum transaction amounts by category in the given time range.\n\
-Usage: " CMD " [-c <cat>] [-d <desc>] [<month>] [<year>]\n\
-       " CMD " [-c <cat>] [-d <desc>] -a\n\
-       " CMD " [-c <cat>] [-d <desc>] -s <date0> [<date1>]\n\
+Usage: " CMD " [-f <file>] [-c <cat>] [-d <desc>] [<month>] [<year>]\n\
+       " CMD " [-f <file>] [-c <cat>] [-d <desc>] -a\n\
+       " CMD " [-f <file>] [-c <cat>] [-d <desc>] -s <date0> [<date1>]\n\
 \n\
 If no time range arguments are provided, use the current month.\n\
 \n\
@@ -25,6 +29,9 @@ Options:\n\
     -s          Use specific dates to specify time range.\n\
     -c <cat>    Comma-separated patterns to filter categories with.\n\
     -d <desc>   Comma-separated patterns to filter descriptions with.\n\
+    -f <file>   Read transactions from <file>, or standard input if '-',\n\
+                instead of the ledger. The file is read in a single pass\n\
+                without being loaded into memory, and need not be sorted.\n\
 \n\
 Positional arguments:\n\
     <month>     'mN' or integer from 1 to 12.\n\
@@ -54,8 +61,29 @@ Examples:\n\
         " CMD " d\n\
     Include transactions spanning Jan 3, 2000 to today:\n\
         " CMD " 2000-01-03 d\n\
+    Include all transactions in a set of archived ledgers:\n\
+        cat 2019.tsv 2020.tsv | " CMD " -a -f -\n\
 "
 
+/* Hashtable wrapper to encapsulate useful printing information. */
+typedef struct {
+    HashTable* ht;       // category totals for a given sign
+    const char* name;   // "In"/"Out" or equivalent combination
+    int64_t max;        // maximum category total, not absolute value
+    int64_t total;      // total over all categories, not absolute value
+    int sign;           // must be 1 or -1
+} Section;
+
+enum {POS, NEG, NSECTIONS};
+
+static void initsects(Section* sects);
+static void addslice(Section* sects);
+static void addrec(Section* sects, const Record* rec);
+static void addtotal(void* sects, int y, const ArTotal* t, const char* cat);
+static void streamrec(void* sects, const Record* rec);
+static void printsums(Section* sects);
+static ptrdiff_t streamsums(const char* fn, const RecordFilter* rf, Section* sects);
+
 int main_sum(int argc, char** argv)
 {
     // parse options
@@ -63,9 +91,10 @@ int main_sum(int argc, char** argv)
     enum usagetype usagetype = NORMAL;
     const char* cat = NULL;
     const char* desc = NULL;
+    const char* fn = NULL;
     optind = PROG_ARGSTART;
     for (struct option longopts[] = {{0}};;) {
-        int c = getopt_long(argc, argv, ":hc:d:as", longopts, NULL);
+        int c = getopt_long(argc, argv, ":hc:d:f:as", longopts, NULL);
         if (c == -1) break;
         switch (c) {
             case 'h':
@@ -76,6 +105,9 @@ int main_sum(int argc, char** argv)
             case 'd':
                 desc = optarg;
                 break;
+            case 'f':
+                fn = optarg;
+                break;
             case 'a':
                 usagetype = ALL;
                 break;
@@ -88,7 +120,8 @@ int main_sum(int argc, char** argv)
                 prog_err_optunknown(optopt);
         }
     }
-    prog_loadconf();
+    if (fn == NULL)
+        prog_loadconf();
 
     // parse time range bounds
     argc -= optind;
@@ -130,15 +163,39 @@ int main_sum(int argc, char** argv)
         }
     }
 
-    // init/slice/filter record list
-    prog_initrl();
-    ptrdiff_t slicelen = (usagetype == ALL)
-        ? rl_count()
-        : rl_slice(dt0, dt1);
-    if (cat)
-        slicelen = rl_filtercat(cat, ',');
-    if (desc)
-        slicelen = rl_filterdesc(desc, ',');
+    // sum a file as it is read, or init/slice/filter record list and add
+    // the totals of archived years
+    Section sects[NSECTIONS];
+    initsects(sects);
+    ptrdiff_t slicelen;
+    if (usagetype == ALL) {
+        dt0 = INT32_MIN;
+        dt1 = INT32_MAX;
+    }
+    RecordFilter rf;
+    if (!rs_initfilter(&rf, dt0, dt1, cat, desc, ','))
+        prog_err_nomem();
+    if (fn) {
+        slicelen = streamsums(fn, &rf, sects);
+    } else if (prog_outofcore()) {
+        slicelen = prog_streamrl(&rf, false, streamrec, sects);
+        slicelen += prog_sumarchives(&rf, addtotal, sects);
+    } else {
+        if (usagetype == ALL)
+            prog_initrl();
+        else
+            prog_initrlrange(dt0, dt1);
+        slicelen = (usagetype == ALL)
+            ? rl_count()
+            : rl_slice(dt0, dt1);
+        if (cat)
+            slicelen = rl_filtercat(cat, ',');
+        if (desc)
+            slicelen = rl_filterdesc(desc, ',');
+        addslice(sects);
+        slicelen += prog_sumarchives(&rf, addtotal, sects);
+    }
+    rs_freefilter(&rf);
 
     // print
     if (slicelen == 0) {
@@ -146,13 +203,46 @@ int main_sum(int argc, char** argv)
             prog_printdaterange(dt0, dt1);
         prog_pexit("No transactions.");
     } else {
-        void printsums(void);
-        printsums();
+        printsums(sects);
     }
     exit(EXIT_SUCCESS);
 }
 
 
+// Streaming
+
+/* Add each record in file FN (standard input if "-") matching RF to
+SECTS. Return the number of records added. Exit program on error. */
+static ptrdiff_t streamsums(const char* fn, const RecordFilter* rf, Section* sects)
+{
+    bool isstdin = (strcmp(fn, "-") == 0);
+    FILE* f = isstdin ? stdin : fopen(fn, "r");
+    if (f == NULL)
+        prog_err_read(fn);
+    RecordStream rs;
+    if (!rs_open(&rs, f))
+        prog_err_nomem();
+
+    ptrdiff_t count = 0;
+    Record rec;
+    for (enum rs_status status; (status = rs_next(&rs, &rec)) != RS_END;) {
+        if (status == RS_READERR)
+            prog_err_read(fn);
+        if (status == RS_BADLINE)
+            prog_err("%s:%td: line too long or cannot be deserialized", fn, rs.lineno);
+        if (rs_match(rf, &rec)) {
+            addrec(sects, &rec);
+            count++;
+        }
+    }
+
+    rs_close(&rs);
+    if (!isstdin)
+        fclose(f);
+    return count;
+}
+
+
 // Printing
 
 /*
@@ -219,15 +309,6 @@ static void printline(
     }
 }
 
-/* Hashtable wrapper to encapsulate useful printing information. */
-typedef struct {
-    HashTable* ht;       // category totals for a given sign
-    const char* name;   // "In"/"Out" or equivalent combination
-    int64_t max;        // maximum category total, not absolute value
-    int64_t total;      // total over all categories, not absolute value
-    int sign;           // must be 1 or -1
-} Section;
-
 /* Exits on insufficient memory. The name member is set to NAME (name
 argument is NOT copied). */
 static Section* initsect(Section* sect, const char* name, int sign)
@@ -235,48 +316,104 @@ static Section* initsect(Section* sect, const char* name, int sign)
     sect->ht = ht_new(HT_STR);
     if (sect->ht == NULL)
         prog_err_nomem();
+    sect->name = name;
+    sect->sign = sign;
+    return sect;
+}
+
+static void initsects(Section* sects)
+{
+    initsect(sects + POS, "In", 1);
+    initsect(sects + NEG, "Out", -1);
+}
 
-    for (
-        ptrdiff_t i = rl_slicestart()
-        ; i < rl_slicestop()
-        ; i++
-    ) {
-        const Record* rec = rl_get(i);
-        if (sign * rec->amt >= 0) {
-            int64_t* catsum = ht_insert(sect->ht, rec->cat, 0);
-            if (catsum == NULL)
-                prog_err_nomem();
-            *catsum += rec->amt;
+/* Add AMT to CAT's total in SECT. Exit program on insufficient memory. */
+static void addamt(Section* sect, const char* cat, int64_t amt)
+{
+    int64_t* catsum = ht_insert(sect->ht, cat, 0);
+    if (catsum == NULL)
+        prog_err_nomem();
+    *catsum += amt;
+}
+
+/* Add REC's amount to its category's total in the section of its sign.
+Exit program on insufficient memory. */
+static void addrec(Section* sects, const Record* rec)
+{
+    addamt(sects + ((rec->amt >= 0) ? POS : NEG), rec->cat, rec->amt);
+}
+
+/* Add the record list's selected records to SECTS. Totals are kept in arrays
+indexed by category id and added to SECTS once per category, in order of
+first appearance in each section. Exit program on insufficient memory. */
+static void addslice(Section* sects)
+{
+    // totals of category id I are at 2*I + POS and 2*I + NEG; neither
+    // returns to zero once a record is added, since amounts are nonzero
+    int32_t ncats = rl_catcount();
+    int64_t* totals = calloc(2 * (size_t)ncats + 1, sizeof(*totals));
+    int32_t* order = malloc((2 * (size_t)ncats + 1) * sizeof(*order));
+    if (totals == NULL || order == NULL)
+        prog_err_nomem();
+    ptrdiff_t norder = 0;
+    RlSpan span;
+    ptrdiff_t pos;
+    rl_foreachsel(span, pos) {
+        for (ptrdiff_t i = 0; i < span.len; i++) {
+            int32_t k = 2 * span.cat[i] + ((span.amt[i] >= 0) ? POS : NEG);
+            if (totals[k] == 0)
+                order[norder++] = k;
+            totals[k] += span.amt[i];
         }
     }
+    for (ptrdiff_t i = 0; i < norder; i++)
+        addamt(sects + order[i] % 2, rl_catname(order[i] / 2), totals[order[i]]);
+    free(totals);
+    free(order);
+}
 
-    ht_sort(sect->ht, false, sign < 0);
+/* prog_streamrl callback. */
+static void streamrec(void* sects, const Record* rec)
+{
+    addrec(sects, rec);
+}
+
+/* prog_sumarchives callback. Add T's inflows and outflows to CAT's totals
+in SECTS. */
+static void addtotal(void* sects, int y, const ArTotal* t, const char* cat)
+{
+    (void)y;
+    if (t->in)
+        addamt((Section*)sects + POS, cat, t->in);
+    if (t->out)
+        addamt((Section*)sects + NEG, cat, t->out);
+}
+
+/* Sort a section's categories and compute its summary values. */
+static void finishsect(Section* sect)
+{
+    ht_sort(sect->ht, false, sect->sign < 0);
     sect->max = ht_max(sect->ht);
     sect->total = ht_sum(sect->ht);
-    sect->name = name;
-    sect->sign = sign;
-    return sect;
 }
 
 /* Exit program on error. */
-void printsums(void)
+static void printsums(Section* sects)
 {
     // compute tsigns
-    enum {POS, NEG, NSECTIONS};
-    Section sects[NSECTIONS];
-    initsect(sects + POS, "In", 1);
-    initsect(sects + NEG, "Out", -1);
+    finishsect(sects + POS);
+    finishsect(sects + NEG);
 
     // get net
     int64_t net = sects[POS].total + sects[NEG].total;
 
     // get catlen
     int catlen = 0;
-    for (
-        ptrdiff_t i = rl_slicestart()
-        ; i < rl_slicestop()
-        ; i++
-    ) catlen = util_max(catlen, strlen(rl_get(i)->cat));
+    for (int i = 0; i < NSECTIONS; i++) {
+        const void* key;
+        ht_foreach(sects[i].ht, key, NULL)
+            catlen = util_max(catlen, strlen(key));
+    }
 
     // get amtlen and buffer
     int amtlen = util_max(
@@ -4,6 +4,7 @@
 
 #include "date.h"
 #include "recordlist.h"
+#include "recordstream.h"
 #include "recordtree.h"
 #include "program.h"
 
@@ -23,6 +24,8 @@ Options:\n\
     -c <cat>    Comma-separated patterns to filter categories with.\n\
     -d <desc>   Comma-separated patterns to filter descriptions with.\n\
 \n\
+Ledgers too large for memory_max are printed a year at a time with -a.\n\
+\n\
 Positional arguments:\n\
     <month>     'mN' or integer from 1 to 12.\n\
     <year>      'yN' or integer from 13 to 9999.\n\
@@ -53,6 +56,9 @@ Examples:\n\
         " CMD " 2000-01-03 d\n\
 "
 
+static void streamrec(void* y, const Record* rec);
+static void printyear(void);
+
 int main_view(int argc, char** argv)
 {
     // parse options
@@ -90,7 +96,7 @@ int main_view(int argc, char** argv)
     // parse time range bounds
     argc -= optind;
     argv += optind;
-    int32_t dt0, dt1;
+    int32_t dt0 = INT32_MIN, dt1 = INT32_MAX;
     if (usagetype == SPECIFIC) {
         if (argc == 0)
             prog_err("<date0> missing");
@@ -127,8 +133,31 @@ int main_view(int argc, char** argv)
         }
     }
 
-    // init/slice/filter record list
-    prog_initrl();
+    // a ledger too large to load is streamed through the record list a
+    // year at a time
+    if (usagetype == ALL && prog_outofcore()) {
+        RecordFilter rf;
+        if (!rs_initfilter(&rf, dt0, dt1, cat, desc, ','))
+            prog_err_nomem();
+        if (rl_init(NULL) < 0)
+            prog_err_nomem();
+        int y = 0;
+        ptrdiff_t count = prog_streamrl(&rf, true, streamrec, &y);
+        printyear();
+        rs_freefilter(&rf);
+        if (count == 0)
+            prog_pexit("No transactions.");
+        exit(EXIT_SUCCESS);
+    }
+
+    // init/slice/filter record list, including archived years
+    if (usagetype == ALL) {
+        prog_initrl();
+        prog_loadarchives(INT32_MIN, INT32_MAX);
+    } else {
+        prog_initrlrange(dt0, dt1);
+        prog_loadarchives(dt0, dt1);
+    }
     ptrdiff_t slicelen = (usagetype == ALL)
         ? rl_count()
         : rl_slice(dt0, dt1);
@@ -149,3 +178,31 @@ int main_view(int argc, char** argv)
     }
     exit(EXIT_SUCCESS);
 }
+
+/* Add REC to the record list, first printing and clearing the list if REC
+starts a year after *Y. */
+static void streamrec(void* y, const Record* rec)
+{
+    int* lasty = y;
+    if (dt_gety(rec->dt) != *lasty) {
+        printyear();
+        *lasty = dt_gety(rec->dt);
+    }
+    if (!rl_insert(rec))
+        prog_err_nomem();
+}
+
+/* Print the record list, if nonempty, then clear it. */
+static void printyear(void)
+{
+    if (rl_count()) {
+        rl_resetslice();
+        if (!rt_init())
+            prog_err_nomem();
+        rt_print(stdout);
+        rt_deinit();
+    }
+    rl_deinit();
+    if (rl_init(NULL) < 0)
+        prog_err_nomem();
+}
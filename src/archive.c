@@ -0,0 +1,329 @@
+// <1> Layout
+// <2> Varints
+// <3> Writing
+// <4> Reading
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "hashtable.h"
+#include "outbuf.h"
+#include "record.h"
+#include "archive.h"
+
+
+// <1> Layout
+//
+// An archive consists of a header followed by sections, each starting at
+// a multiple of 8 bytes from the beginning:
+//      totals      ArTotal[ntotals], ordered by month then category id
+//      cats        char[ncats][REC_CATLEN + 1], NUL-padded
+//      recs        varints, four per record (see <2>)
+//      descs       char[descslen], descriptions without NULs
+//
+// The header consists of MAGIC, a uint32 BOM, an int32 year, then the
+// int64s count, ncats, ntotals, recslen and descslen.
+
+#define MAGIC "lgrarc1\n"
+#define BOM UINT32_C(0x01020304)
+#define HEADERLEN (sizeof MAGIC - 1 + 2*4 + 5*8)
+#define CATSLOT (REC_CATLEN + 1)
+#define TOTALLEN ((int64_t)sizeof(ArTotal))
+
+/* Round N up to a multiple of 8. */
+#define PAD(n) (((n) + 7) & ~(size_t)7)
+
+/* Compute AR's section offsets. Return false if the archive would not fit
+in LIMIT chars; the counts are checked before multiplying so nothing can
+overflow. */
+static bool layout(
+    Archive* ar, int64_t ncats, int64_t ntotals, int64_t recslen,
+    int64_t descslen, size_t limit
+) {
+    if (
+        ncats < 0 || ntotals < 0 || recslen < 0 || descslen < 0
+        || (uint64_t)ncats > limit / CATSLOT
+        || (uint64_t)ntotals > limit / TOTALLEN
+        || (uint64_t)recslen > limit
+        || (uint64_t)descslen > limit
+    ) return false;
+    ar->totals = PAD(HEADERLEN);
+    ar->cats = ar->totals + ntotals * TOTALLEN;
+    ar->recs = ar->cats + PAD(ncats * CATSLOT);
+    ar->descs = ar->recs + PAD(recslen);
+    ar->end = ar->descs + descslen;
+    return ar->end <= limit;
+}
+
+
+// <2> Varints
+//
+// Each record is stored as the varints
+//      days since the previous record's date, or since Jan 1 for the first
+//      amount, zigzag encoded so small outflows stay short
+//      category id
+//      description length
+// Varints hold 7 bits per char, least significant first, with the high bit
+// set on every char but the last.
+
+#define VARINTMAX 10
+
+static uint64_t zigzag(int64_t n)
+{
+    return ((uint64_t)n << 1) ^ (n < 0 ? UINT64_MAX : 0);
+}
+
+static int64_t unzigzag(uint64_t n)
+{
+    return (int64_t)(n >> 1) ^ -(int64_t)(n & 1);
+}
+
+/* Write N to BUF. Return the number of chars written. */
+static int putvarint(uint64_t n, char* buf)
+{
+    int len = 0;
+    for (; n >= 0x80; n >>= 7)
+        buf[len++] = (char)(n | 0x80);
+    buf[len++] = (char)n;
+    return len;
+}
+
+/* Read a varint from the chars from *P to END into N, advancing *P. Return
+false if the varint is unterminated or too long. */
+static bool getvarint(const char** p, const char* end, uint64_t* n)
+{
+    *n = 0;
+    for (int shift = 0; *p < end && shift < 7 * VARINTMAX; shift += 7) {
+        unsigned char c = *(*p)++;
+        *n |= (uint64_t)(c & 0x7f) << shift;
+        if (c < 0x80)
+            return true;
+    }
+    return false;
+}
+
+/* Encode REC, dated DAYS after the previous record, into BUF. Return the
+number of chars written, which is at most 4 * VARINTMAX. */
+static int putrec(const Record* rec, int32_t days, int64_t id, char* buf)
+{
+    int len = putvarint(days, buf);
+    len += putvarint(zigzag(rec->amt), buf + len);
+    len += putvarint(id, buf + len);
+    len += putvarint(strlen(rec->desc), buf + len);
+    return len;
+}
+
+
+// <3> Writing
+
+/* Write LEN zeros, where LEN is less than 8. */
+static void writepad(OutBuf* ob, size_t len)
+{
+    static const char zeros[8] = {0};
+    ob_write(ob, zeros, len);
+}
+
+bool ar_write(FILE* f, int y, const Record* recs, ptrdiff_t count)
+{
+    // intern categories; ids are assigned in order of first appearance
+    HashTable* ht = ht_new(HT_STR);
+    if (ht == NULL)
+        return false;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        if (NULL == ht_insert(ht, recs[i].cat, ht_count(ht))) {
+            ht_free(ht);
+            return false;
+        }
+    }
+    int64_t ncats = ht_count(ht);
+
+    // totals by month and category, and the encoded length of each section
+    ArTotal* totals = calloc(12 * ncats + 1, sizeof(*totals));
+    OutBuf ob;
+    if (totals == NULL || !ob_open(&ob, f, OB_DEFAULTCAP)) {
+        free(totals);
+        ht_free(ht);
+        return false;
+    }
+    int64_t recslen = 0, descslen = 0;
+    int32_t prev = dt_epochd(dt_dt(y, 1, 1));
+    for (ptrdiff_t i = 0; i < count; i++) {
+        const Record* rec = recs + i;
+        int64_t id = *ht_get(ht, rec->cat);
+        ArTotal* t = totals + (dt_getm(rec->dt) - 1) * ncats + id;
+        t->in += (rec->amt > 0) ? rec->amt : 0;
+        t->out += (rec->amt < 0) ? rec->amt : 0;
+        t->count++;
+        char buf[4 * VARINTMAX];
+        int32_t days = dt_epochd(rec->dt);
+        recslen += putrec(rec, days - prev, id, buf);
+        descslen += strlen(rec->desc);
+        prev = days;
+    }
+    int64_t ntotals = 0;
+    for (int64_t i = 0; i < 12 * ncats; i++) {
+        if (totals[i].count == 0)
+            continue;
+        totals[i].m = i / ncats + 1;
+        totals[i].cat = i % ncats;
+        totals[ntotals++] = totals[i];
+    }
+
+    // header
+    uint32_t bom = BOM;
+    int32_t year = y;
+    int64_t counts[] = {count, ncats, ntotals, recslen, descslen};
+    ob_write(&ob, MAGIC, sizeof MAGIC - 1);
+    ob_write(&ob, (const char*)&bom, sizeof bom);
+    ob_write(&ob, (const char*)&year, sizeof year);
+    ob_write(&ob, (const char*)counts, sizeof counts);
+    writepad(&ob, PAD(HEADERLEN) - HEADERLEN);
+
+    // totals, then the category table in id order
+    ob_write(&ob, (const char*)totals, ntotals * TOTALLEN);
+    const void* key;
+    ht_foreach(ht, key, NULL) {
+        char slot[CATSLOT] = {0};
+        strcpy(slot, key);
+        ob_write(&ob, slot, CATSLOT);
+    }
+    writepad(&ob, PAD(ncats * CATSLOT) - ncats * CATSLOT);
+
+    // records, then the description heap
+    prev = dt_epochd(dt_dt(y, 1, 1));
+    for (ptrdiff_t i = 0; i < count; i++) {
+        int32_t days = dt_epochd(recs[i].dt);
+        char* buf = ob_reserve(&ob, 4 * VARINTMAX);
+        ob_commit(&ob, putrec(recs + i, days - prev, *ht_get(ht, recs[i].cat), buf));
+        prev = days;
+    }
+    writepad(&ob, PAD(recslen) - recslen);
+    for (ptrdiff_t i = 0; i < count; i++)
+        ob_write(&ob, recs[i].desc, strlen(recs[i].desc));
+
+    free(totals);
+    ht_free(ht);
+    return ob_close(&ob);
+}
+
+
+// <4> Reading
+//
+// Archives may be mapped at any address, so integers are read with memcpy.
+
+static int64_t geti64(const char* p)
+{
+    int64_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+static int32_t geti32(const char* p)
+{
+    int32_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+bool ar_open(Archive* ar, const char* s, size_t len)
+{
+    if (len < HEADERLEN || memcmp(s, MAGIC, sizeof MAGIC - 1) != 0)
+        return false;
+    const char* p = s + sizeof MAGIC - 1;
+    uint32_t bom;
+    memcpy(&bom, p, sizeof bom);
+    int64_t count = geti64(p + 8);
+    int64_t ncats = geti64(p + 16);
+    int64_t ntotals = geti64(p + 24);
+    if (
+        bom != BOM
+        || !dt_isy(geti32(p + 4))
+        || count < 0 || count > PTRDIFF_MAX
+        || !layout(ar, ncats, ntotals, geti64(p + 32), geti64(p + 40), len)
+        || ar->end != len
+    ) return false;
+    ar->s = s;
+    ar->y = geti32(p + 4);
+    ar->count = count;
+    ar->ncats = ncats;
+    ar->ntotals = ntotals;
+
+    // each category must be usable as a record's category
+    for (int64_t i = 0; i < ncats; i++) {
+        const char* cat = s + ar->cats + i * CATSLOT;
+        const char* nul = memchr(cat, '\0', CATSLOT);
+        size_t catlen = nul ? (size_t)(nul - cat) : 0;
+        if (catlen == 0)
+            return false;
+        for (size_t j = 0; j < catlen; j++)
+            if (cat[j] == *REC_DELIM || cat[j] == '\n' || isupper((unsigned char)cat[j]))
+                return false;
+    }
+
+    // totals must refer to real months and categories
+    int64_t total = 0;
+    for (ptrdiff_t i = 0; i < ntotals; i++) {
+        ArTotal t = ar_total(ar, i);
+        if (
+            !dt_ism(t.m) || t.cat < 0 || t.cat >= ncats
+            || t.in < 0 || t.out > 0 || t.count <= 0 || t.count > count - total
+        ) return false;
+        total += t.count;
+    }
+    return total == count;
+}
+
+ArTotal ar_total(const Archive* ar, ptrdiff_t i)
+{
+    ArTotal t;
+    memcpy(&t, ar->s + ar->totals + i * TOTALLEN, sizeof t);
+    return t;
+}
+
+const char* ar_cat(const Archive* ar, ptrdiff_t id)
+{
+    return ar->s + ar->cats + id * CATSLOT;
+}
+
+ptrdiff_t ar_decode(const Archive* ar, Record* out)
+{
+    const char* p = ar->s + ar->recs;
+    const char* end = ar->s + ar->descs;
+    const char* desc = ar->s + ar->descs;
+    const char* descsend = ar->s + ar->end;
+    int32_t dt = dt_dt(ar->y, 1, 1);
+    for (ptrdiff_t i = 0; i < ar->count; i++) {
+        Record* rec = out + i;
+        uint64_t days, amt, id, desclen;
+        if (
+            !getvarint(&p, end, &days) || !getvarint(&p, end, &amt)
+            || !getvarint(&p, end, &id) || !getvarint(&p, end, &desclen)
+            || days > 366 || id >= (uint64_t)ar->ncats
+            || desclen > REC_DESCLEN || desclen > (uint64_t)(descsend - desc)
+        ) return i + 1;
+        if (days)
+            dt = dt_shiftd(dt, days);
+        rec->dt = dt;
+        rec->amt = unzigzag(amt);
+        if (
+            !dt_isdt(dt) || dt_gety(dt) != ar->y
+            || !rec->amt || rec->amt > REC_AMT_MAX || rec->amt < REC_AMT_MIN
+            || memchr(desc, '\n', desclen) || memchr(desc, '\0', desclen)
+        ) return i + 1;
+        memcpy(rec->cat, ar_cat(ar, id), CATSLOT);
+        memcpy(rec->desc, desc, desclen);
+        rec->desc[desclen] = '\0';
+        desc += desclen;
+    }
+
+    // every char of the record and description sections must be used
+    if (PAD(p - (ar->s + ar->recs)) != ar->descs - ar->recs || desc != descsend)
+        return ar->count + 1;
+    return 0;
+}
@@ -0,0 +1,96 @@
+// <1> Table
+// <2> Instruction
+// <3> Dispatch
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "crc.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_SSE42
+#define TARGET_SSE42 __attribute__((target("sse4.2")))
+#endif
+
+
+// <1> Table
+//
+// Checksums are computed 4 bits at a time using the reflected polynomial
+// 0x82f63b78. TABLE[N] is the checksum contribution of nibble N.
+
+static const uint32_t table[16] = {
+    0x00000000, 0x105ec76f, 0x20bd8ede, 0x30e349b1,
+    0x417b1dbc, 0x5125dad3, 0x61c69362, 0x7198540d,
+    0x82f63b78, 0x92a8fc17, 0xa24bb5a6, 0xb21572c9,
+    0xc38d26c4, 0xd3d3e1ab, 0xe330a81a, 0xf36e6f75,
+};
+
+static uint32_t crc_table(uint32_t crc, const char* s, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        crc ^= (unsigned char)s[i];
+        crc = (crc >> 4) ^ table[crc & 0xf];
+        crc = (crc >> 4) ^ table[crc & 0xf];
+    }
+    return crc;
+}
+
+
+// <2> Instruction
+
+#ifdef HAVE_SSE42
+TARGET_SSE42
+static uint32_t crc_sse42(uint32_t crc, const char* s, size_t len)
+{
+    size_t i = 0;
+    #ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; len - i >= 8; i += 8) {
+        uint64_t w;
+        memcpy(&w, s + i, 8);
+        crc64 = _mm_crc32_u64(crc64, w);
+    }
+    crc = (uint32_t)crc64;
+    #endif // __x86_64__
+    for (; i < len; i++)
+        crc = _mm_crc32_u8(crc, (unsigned char)s[i]);
+    return crc;
+}
+#endif // HAVE_SSE42
+
+
+// <3> Dispatch
+
+/* Whether the instruction is in use, or -1 if not yet determined. */
+static int st_hw = -1;
+
+static bool supported(void)
+{
+    #ifdef HAVE_SSE42
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("sse4.2");
+    #else
+    return false;
+    #endif
+}
+
+bool crc_sethw(bool enable)
+{
+    st_hw = enable && supported();
+    return st_hw;
+}
+
+uint32_t crc_32c(uint32_t crc, const char* s, size_t len)
+{
+    if (st_hw < 0)
+        st_hw = supported();
+    crc = ~crc;
+    #ifdef HAVE_SSE42
+    if (st_hw)
+        return ~crc_sse42(crc, s, len);
+    #endif
+    return ~crc_table(crc, s, len);
+}
@@ -93,13 +93,11 @@ int32_t dt_shiftm(int32_t dt, int offset)
     return dt_dt(y, m, util_min(d, ldom(y, m)));
 }
 
-int32_t dt_shiftd(int32_t dt, int offset)
+/* Number of days from 0000-03-01 to a valid date. From Howard Hinnant's
+chrono-compatible date algorithms. */
+static int32_t daynum(int32_t dt)
 {
-    // From Howard Hinnant's chrono-compatible date algorithms. Convert
-    // date components to an offset from 0000-03-01, shift days, then
-    // convert that offset back to components.
     DECOMPOSE(dt, y, m, d);
-
     int yy = y - (m < 3);
     int mm = m + (m < 3 ? 9 : -3);
     int dd = d - 1;
@@ -107,21 +105,33 @@ int32_t dt_shiftd(int32_t dt, int offset)
     int yoe = yy - era*400;
     int doy = (153*mm + 2) / 5 + dd;
     int32_t doe = yoe*365 + yoe/4 - yoe/100 + doy;
+    return era*146097 + doe;
+}
 
-    int32_t ts = era*146097 + doe + offset;
+int32_t dt_shiftd(int32_t dt, int offset)
+{
+    // convert date components to an offset from 0000-03-01, shift days,
+    // then convert that offset back to components
+    int32_t ts = daynum(dt) + offset;
     if (ts < 306 || ts > 3652364) return 0;
 
-    era = (ts >= 0 ? ts : ts + 1 - 146097) / 146097;
-    doe = ts - era*146097;
-    yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
-    doy = doe - yoe*365 - yoe/4 + yoe/100;
-    yy = yoe + era*400;
-    mm = (5*doy + 2) / 153;
-    dd = doy - (153*mm + 2) / 5;
+    int era = (ts >= 0 ? ts : ts + 1 - 146097) / 146097;
+    int32_t doe = ts - era*146097;
+    int yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    int doy = doe - yoe*365 - yoe/4 + yoe/100;
+    int yy = yoe + era*400;
+    int mm = (5*doy + 2) / 153;
+    int dd = doy - (153*mm + 2) / 5;
 
     return dt_dt(yy + (mm >= 10), mm + (mm < 10 ? 3 : -9), dd + 1);
 }
 
+int32_t dt_epochd(int32_t dt)
+{
+    // 1970-01-01 is day 719468 counting from 0000-03-01
+    return daynum(dt) - 719468;
+}
+
 
 // <3> String Conversion
 
@@ -136,32 +146,54 @@ const char* dt_mmm(int m)
 
 bool dt_isiso(const char* s)
 {
+    return dt_isisoprefix(s) && s[DT_ISOLEN] == '\0';
+}
+
+bool dt_isisoprefix(const char* s)
+{
+    // stops at the first mismatch, so never reads past a NUL
     for (int i = 0; i < DT_ISOLEN; i++) {
-        if (s[i] == '\0') return false;
         if (i == 4 || i == 7) {
             if (s[i] != '-') return false;
         } else if (s[i] < '0' || s[i] > '9') {
             return false;
         }
     }
-    return s[DT_ISOLEN] == '\0';
+    return true;
+}
+
+/* Decimal value of the LEN digits at S. */
+static int digits(const char* s, int len)
+{
+    int n = 0;
+    for (int i = 0; i < len; i++)
+        n = n*10 + (s[i] - '0');
+    return n;
 }
 
 int32_t dt_fromiso(const char* s)
 {
-    int y, m, d;
-    sscanf(s, "%d-%d-%d", &y, &m, &d);
-    return dt_dt(y, m, d);
+    return dt_dt(digits(s, 4), digits(s + 5, 2), digits(s + 8, 2));
 }
 
 char* dt_toiso(int32_t dt)
 {
     static char s[DT_ISOLEN + 1];
-    DECOMPOSE(dt, y, m, d);
-    sprintf(s, "%04d-%02d-%02d", y, m, d);
+    s[dt_writeiso(dt, s)] = '\0';
     return s;
 }
 
+int dt_writeiso(int32_t dt, char* buf)
+{
+    DECOMPOSE(dt, y, m, d);
+    util_fmtfixed(y, 4, buf);
+    buf[4] = '-';
+    util_fmtfixed(m, 2, buf + 5);
+    buf[7] = '-';
+    util_fmtfixed(d, 2, buf + 8);
+    return DT_ISOLEN;
+}
+
 char* dt_fmt(int32_t dt)
 {
     static char s[sizeof "mmm dd, yyyy"];
@@ -0,0 +1,192 @@
+// <1> Building
+// <2> IO
+// <3> Lookup
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "dateindex.h"
+
+/* Leading chars of a line identifying its month ("yyyy-mm"). */
+#define MONTHLEN 7
+
+/* First 8 bytes of a saved index. */
+#define MAGIC "lgridx1\n"
+
+
+// <1> Building
+
+/* Append an entry, growing the array as needed. Return false if there is
+insufficient memory. */
+static bool append(DateIndex* di, ptrdiff_t* cap, DateIndexEntry entry)
+{
+    if (di->count == *cap) {
+        ptrdiff_t newcap = *cap ? *cap * 2 : 64;
+        DateIndexEntry* new = realloc(di->entries, newcap * sizeof(*new));
+        if (new == NULL)
+            return false;
+        di->entries = new;
+        *cap = newcap;
+    }
+    di->entries[di->count++] = entry;
+    return true;
+}
+
+bool di_build(DateIndex* di, const char* s, size_t len)
+{
+    di->size = len;
+    di->mtime = 0;
+    di->count = 0;
+    di->entries = NULL;
+
+    ptrdiff_t cap = 0;
+    const char* prev = NULL;
+    const char* base = s;
+    const char* end = s + len;
+    for (int64_t line = 0; s < end; line++) {
+        if (end - s < DT_ISOLEN || !dt_isisoprefix(s))
+            goto fail;
+
+        // only lines starting a new month need their date decoded
+        if (prev == NULL || memcmp(s, prev, MONTHLEN) != 0) {
+            int32_t month = dt_fromiso(s) / 100;
+            if (di->count && month <= di->entries[di->count-1].month)
+                goto fail;
+            DateIndexEntry entry = {.month = month, .line = line, .offset = s - base};
+            if (!append(di, &cap, entry))
+                goto fail;
+            prev = s;
+        }
+
+        const char* eol = memchr(s, '\n', end - s);
+        s = eol ? eol + 1 : end;
+    }
+    return true;
+
+fail:
+    di_free(di);
+    return false;
+}
+
+
+// <2> IO
+//
+// A saved index is MAGIC followed by the size, modification time and entry
+// count as int64s, then each entry's month, line and offset as int64s. All
+// integers are in native byte order; an index is never moved between
+// machines.
+
+static bool writei(int64_t n, FILE* f)
+{
+    return fwrite(&n, sizeof n, 1, f) == 1;
+}
+
+static bool readi(int64_t* n, FILE* f)
+{
+    return fread(n, sizeof *n, 1, f) == 1;
+}
+
+bool di_write(const DateIndex* di, FILE* f)
+{
+    bool status = fwrite(MAGIC, 1, sizeof MAGIC - 1, f) == sizeof MAGIC - 1
+        && writei(di->size, f)
+        && writei(di->mtime, f)
+        && writei(di->count, f);
+    for (ptrdiff_t i = 0; status && i < di->count; i++) {
+        const DateIndexEntry* entry = di->entries + i;
+        status = writei(entry->month, f)
+            && writei(entry->line, f)
+            && writei(entry->offset, f);
+    }
+    return status;
+}
+
+bool di_read(DateIndex* di, FILE* f)
+{
+    di->count = 0;
+    di->entries = NULL;
+
+    char magic[sizeof MAGIC - 1];
+    int64_t count;
+    if (
+        fread(magic, 1, sizeof magic, f) != sizeof magic
+        || memcmp(magic, MAGIC, sizeof magic) != 0
+        || !readi(&di->size, f)
+        || !readi(&di->mtime, f)
+        || !readi(&count, f)
+        || count < 0
+        || count > di->size
+    ) return false;
+
+    di->entries = malloc((count ? count : 1) * sizeof(*di->entries));
+    if (di->entries == NULL)
+        return false;
+    for (; di->count < count; di->count++) {
+        DateIndexEntry* entry = di->entries + di->count;
+        int64_t month;
+        if (
+            !readi(&month, f)
+            || !readi(&entry->line, f)
+            || !readi(&entry->offset, f)
+            || month < 0 || month > INT32_MAX
+            || entry->offset < 0 || entry->offset >= di->size
+            || (di->count && month <= entry[-1].month)
+            || (di->count && entry->offset <= entry[-1].offset)
+        ) {
+            di_free(di);
+            return false;
+        }
+        entry->month = month;
+    }
+
+    // trailing data means the file is not an index
+    if (getc(f) != EOF) {
+        di_free(di);
+        return false;
+    }
+    return true;
+}
+
+
+// <3> Lookup
+
+/* Return the index of the first entry whose month is at least MONTH. */
+static ptrdiff_t search(const DateIndex* di, int32_t month)
+{
+    ptrdiff_t l = 0, r = di->count;
+    while (l < r) {
+        ptrdiff_t m = (l + r) / 2;
+        if (di->entries[m].month < month)
+            l = m + 1;
+        else
+            r = m;
+    }
+    return l;
+}
+
+void di_range(
+    const DateIndex* di, int32_t dt0, int32_t dt1,
+    int64_t* start, int64_t* stop, int64_t* line
+) {
+    ptrdiff_t i = search(di, dt0 / 100);
+    ptrdiff_t j = search(di, dt1 / 100 + 1);
+    if (i == j) {
+        *start = *stop = *line = 0;
+        return;
+    }
+    *start = di->entries[i].offset;
+    *line = di->entries[i].line;
+    *stop = (j < di->count) ? di->entries[j].offset : di->size;
+}
+
+void di_free(DateIndex* di)
+{
+    free(di->entries);
+    di->entries = NULL;
+    di->count = 0;
+}
@@ -0,0 +1,69 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "outbuf.h"
+
+bool ob_open(OutBuf* ob, FILE* f, size_t cap)
+{
+    ob->buf = malloc(cap);
+    if (ob->buf == NULL)
+        return false;
+    ob->f = f;
+    ob->len = 0;
+    ob->cap = cap;
+    ob->err = false;
+
+    // data already buffered by the stream must come first
+    if (fflush(f) != 0)
+        ob->err = true;
+    return true;
+}
+
+char* ob_reserve(OutBuf* ob, size_t n)
+{
+    if (ob->cap - ob->len < n)
+        ob_flush(ob);
+    return ob->buf + ob->len;
+}
+
+void ob_commit(OutBuf* ob, size_t n)
+{
+    ob->len += n;
+}
+
+void ob_write(OutBuf* ob, const char* s, size_t len)
+{
+    while (len) {
+        if (ob->len == ob->cap)
+            ob_flush(ob);
+        size_t n = ob->cap - ob->len;
+        if (n > len)
+            n = len;
+        memcpy(ob->buf + ob->len, s, n);
+        ob->len += n;
+        s += n;
+        len -= n;
+    }
+}
+
+bool ob_flush(OutBuf* ob)
+{
+    // a write this large skips the stream's buffer
+    if (ob->len && fwrite(ob->buf, 1, ob->len, ob->f) != ob->len)
+        ob->err = true;
+    ob->len = 0;
+    if (fflush(ob->f) != 0)
+        ob->err = true;
+    return !ob->err;
+}
+
+bool ob_close(OutBuf* ob)
+{
+    bool status = ob_flush(ob);
+    free(ob->buf);
+    ob->buf = NULL;
+    ob->cap = 0;
+    return status;
+}
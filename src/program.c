@@ -2,7 +2,16 @@
 // <2> Print And Exit
 // <3> Parse Numbers
 // <4> Convenience Functions
+// <5> Journal
+// <6> Tail Rewrites
+// <7> Date Index
+// <8> Record Cache
+// <9> Year Partitions
+// <10> Archives
+// <11> Checks
+// <12> Out-of-Core Operation
 
+#include <inttypes.h>
 #include <limits.h>
 #include <stdarg.h>
 #include <stdbool.h>
@@ -14,6 +23,12 @@
 #include "util.h"
 #include "date.h"
 #include "hashtable.h"
+#include "dateindex.h"
+#include "outbuf.h"
+#include "scan.h"
+#include "archive.h"
+#include "record.h"
+#include "recordcheck.h"
 #include "recordlist.h"
 #include "program.h"
 
@@ -34,6 +49,10 @@ void prog_loadconf(void)
         prog_err_nomem();
     ht_insert(st_conf, PROG_CONF_LOG_SIGN, 1);
     ht_insert(st_conf, PROG_CONF_LIM_TYPE, 'r');
+    ht_insert(st_conf, PROG_CONF_JOURNAL_MAX, 64 * 1024);
+    ht_insert(st_conf, PROG_CONF_LOAD_THREADS, 0);
+    ht_insert(st_conf, PROG_CONF_DATA_FORMAT, PROG_FORMAT_TSV);
+    ht_insert(st_conf, PROG_CONF_MEMORY_MAX, 0);
 
     // read
     FILE* f = fopen(PROG_IDFN, "r");
@@ -209,32 +228,190 @@ bool prog_parsecents(const char* s, int64_t* cents)
 
 // <4> Convenience Functions
 
-void prog_initrl(void)
+static void journal_replay(void);
+static void journal_fold(void);
+static void journal_discard(void);
+static void tail_apply(void);
+static void tail_write(ptrdiff_t start, int64_t offset);
+static bool index_range(
+    FILE* f, int32_t dt0, int32_t dt1, int64_t* start, int64_t* stop, int64_t* line
+);
+static void index_discard(void);
+
+/* Size of PROG_CACHEFN's tag; see <8> Record Cache. */
+#define CACHE_TAGLEN 32
+static bool cache_tag(FILE* f, char* tag);
+static bool cache_load(const char* tag);
+static void cache_save(const char* tag);
+static bool isyears(void);
+static void years_load(void);
+static void years_writechanged(void);
+static void years_touch(int32_t dt);
+static void archive_check(int y);
+static void ooc_write(RecordRuns* rr, int32_t cut0, int32_t cut1);
+
+/* Whether the record list was loaded by prog_initrlrange, and if so, the
+range of dates loaded. */
+static bool st_ranged;
+static int32_t st_dt0, st_dt1;
+
+/* Whether archived records were inserted by prog_loadarchives, after which
+the record list must not be written. */
+static bool st_witharchives;
+
+static bool isbin(void)
+{
+    return prog_getconf(PROG_CONF_DATA_FORMAT) == PROG_FORMAT_BIN;
+}
+
+const char* prog_datafn(void)
+{
+    if (isyears())
+        return NULL;
+    return isbin() ? PROG_BINFN : PROG_DATAFN;
+}
+
+/* Exit program with the error for a failed load of FN, where STATUS is
+the loader's nonzero return value and LINE is added to line numbers. */
+static void loaderr(const char* fn, ptrdiff_t status, int64_t line, bool bin)
+{
+    if (status == PTRDIFF_MAX)
+        prog_err("number of records in '%s' exceeds %td", fn, RL_MAXCOUNT);
+    if (status > 0 && bin)
+        prog_err("'%s' is corrupt at record %td", fn, status);
+    if (status > 0)
+        prog_err("%s:%" PRId64 ": line too long or cannot be deserialized", fn, line + status);
+    prog_err_nomem();
+}
+
+/* Initialize record list, loading only records dated st_dt0 to st_dt1 if
+st_ranged is set. st_ranged is cleared if the full list was loaded
+instead. */
+static void initrl(void)
 {
+    rl_setthreads(util_max(0, util_min(prog_getconf(PROG_CONF_LOAD_THREADS), INT_MAX)));
+    if (isyears()) {
+        years_load();
+        return;
+    }
+    if (util_fexists(PROG_TAILFN))
+        tail_apply();
+
+    bool bin = isbin();
+    const char* fn = prog_datafn();
     FILE* f = NULL;
     if (
-        util_fexists(PROG_DATAFN)
-        && !(f = fopen(PROG_DATAFN, "r"))
-    ) prog_err_read(PROG_DATAFN);
-    ptrdiff_t status = rl_init(f);
+        util_fexists(fn)
+        && !(f = fopen(fn, bin ? "rb" : "r"))
+    ) prog_err_read(fn);
+    int64_t start = 0, stop = INT64_MAX, line = 0;
+    bool ooc = prog_outofcore();
+    if (!st_ranged && ooc)
+        prog_err("'%s' is too large to load within " PROG_CONF_MEMORY_MAX, fn);
+    st_ranged = st_ranged && f && !bin
+        && index_range(f, st_dt0, st_dt1, &start, &stop, &line);
+    if (!st_ranged && ooc)
+        prog_err("'%s' has a bad or unsorted line; see '" PROG_NAME " check'", fn);
+    char tag[CACHE_TAGLEN];
+    bool cacheable = f && !bin && !st_ranged && cache_tag(f, tag);
+    bool cached = false;
+    ptrdiff_t status;
+    if (bin && f)
+        status = rl_initbin(f, 0);
+    else if (st_ranged)
+        status = rl_initrange(f, start, stop, st_dt0, st_dt1);
+    else if ((cached = cacheable && cache_load(tag)))
+        status = 0;
+    else
+        status = rl_init(f);
     if (f) fclose(f);
-    if (status == 0)
+    if (status == 0) {
+        if (cacheable && !cached)
+            cache_save(tag);
+        journal_replay();
         return;
-    if (status == PTRDIFF_MAX)
-        prog_err("number of lines in '" PROG_DATAFN "' exceeds %td", RL_MAXCOUNT);
-    if (status > 0)
-        prog_err(PROG_DATAFN ":%td: line too long or cannot be deserialized", status);
-    if (status < 0)
-        prog_err_nomem();
+    }
+    loaderr(fn, status, line, bin);
+}
+
+void prog_initrl(void)
+{
+    st_ranged = false;
+    initrl();
+}
+
+void prog_initrlrange(int32_t dt0, int32_t dt1)
+{
+    st_ranged = true;
+    st_dt0 = dt0;
+    st_dt1 = dt1;
+    initrl();
 }
 
 void prog_writerl(void)
 {
-    FILE* f = fopen(PROG_DATAFN, "w");
-    if (f == NULL)
-        prog_err_write(PROG_DATAFN);
-    rl_write(f);
-    fclose(f);
+    if (st_witharchives)
+        prog_err("archived transactions cannot be written to the ledger");
+    if (isyears()) {
+        years_writechanged();
+        return;
+    }
+
+    // writing a partial list would lose the rest of the file, unless the
+    // changes are all journaled
+    if (st_ranged && prog_outofcore()) {
+        ooc_write(NULL, 1, 0);
+        return;
+    }
+    if (st_ranged) {
+        rl_deinit();
+        prog_initrl();
+    }
+
+    // text mode translation on Windows makes loaded offsets unreliable
+    int64_t offset;
+    ptrdiff_t clean = rl_clean(&offset);
+    #ifdef _WIN32
+    clean = 0;
+    #endif // _WIN32
+    bool bin = isbin();
+    journal_fold();
+    if (!bin && clean > 0 && util_fexists(PROG_DATAFN)) {
+        tail_write(clean, offset);
+    } else {
+        const char* fn = prog_datafn();
+        FILE* f = fopen(fn, bin ? "wb" : "w");
+        if (f == NULL)
+            prog_err_write(fn);
+        bool written = bin ? rl_writebin(f) : rl_write(f);
+        if (fclose(f) != 0 || !written)
+            prog_err_write(fn);
+        index_discard();
+    }
+    journal_discard();
+}
+
+void prog_insertmany(Record* recs, ptrdiff_t count)
+{
+    for (ptrdiff_t i = 0; i < count; i++)
+        archive_check(dt_gety(recs[i].dt));
+    if (prog_outofcore()) {
+        RecordRuns rr;
+        prog_runsopen(&rr);
+        for (ptrdiff_t i = 0; i < count; i++)
+            prog_runsadd(&rr, recs + i);
+        prog_insertruns(&rr);
+        return;
+    }
+    prog_initrl();
+    if (!rl_insertmany(recs, count)) {
+        if (count > RL_MAXCOUNT - rl_count())
+            prog_err("transaction count would exceed limit of %td", RL_MAXCOUNT);
+        prog_err_nomem();
+    }
+    for (ptrdiff_t i = 0; i < count; i++)
+        years_touch(recs[i].dt);
+    prog_writerl();
 }
 
 void prog_printdaterange(int32_t dt0, int32_t dt1)
@@ -243,3 +420,1464 @@ void prog_printdaterange(int32_t dt0, int32_t dt1)
     fputs(" \xe2\x94\x80\xe2\x94\x80 ", stdout);
     puts(dt_fmt(dt1));
 }
+
+
+// <5> Journal
+//
+// Each journal line is one of the following entries:
+//      "@\t{size}\t{mtime}"        identity of prog_datafn(); first line only
+//      "+\t{record}"               insert a serialized record
+//      "-\t{yyyy-mm-dd}\t{dind}"   delete a date's DIND-th record
+//      "="                         the entries above are being folded in
+//
+// The identity line ties the journal to the data file it was started
+// against, and costs a stat rather than a read of the data file. Before the
+// data file is written, a fold line is appended; once the write is done the
+// identity no longer matches, and a journal ending in a fold line is
+// recognized as already folded in. A journal that matches neither, such as
+// one left behind when the data file is touched or replaced, is refused
+// rather than discarded.
+
+#define JOURNAL_HDR '@'
+#define JOURNAL_INS '+'
+#define JOURNAL_DEL '-'
+#define JOURNAL_FOLD '='
+
+/* Large enough to store any journal line, including its newline. */
+#define JOURNAL_LINELEN (2 + REC_STRLEN + 1)
+
+/* Whether PROG_JOURNALFN exists and belongs to the current data file. */
+static bool st_journal_current;
+
+/* Store the identity line of the current data file in BUF. An empty data
+file shares the identity of a missing one, since they hold the same
+records. */
+static char* journal_header(char* buf)
+{
+    int64_t size, mtime;
+    util_fstat(prog_datafn(), &size, &mtime);
+    if (size == 0)
+        mtime = 0;
+    sprintf(
+        buf,
+        "%c" REC_DELIM "%" PRId64 REC_DELIM "%" PRId64,
+        JOURNAL_HDR, size, mtime
+    );
+    return buf;
+}
+
+/* Whether records dated DT are loaded. */
+static bool journal_loaded(int32_t dt)
+{
+    return !st_ranged || (dt >= st_dt0 && dt <= st_dt1);
+}
+
+/* A parsed journal entry. */
+typedef struct {
+    ptrdiff_t lineno;   // line in PROG_JOURNALFN
+    int32_t dt;
+    ptrdiff_t dind;     // index of the record deleted, or -1 to insert REC
+    Record rec;
+} JournalEntry;
+
+/* Parse ENTRY, found on line LINENO, into E. Return false if the entry is
+invalid. */
+static bool journal_parse(const char* entry, ptrdiff_t lineno, JournalEntry* e)
+{
+    if (entry[0] == '\0' || entry[1] != *REC_DELIM)
+        return false;
+    const char* arg = entry + 2;
+    e->lineno = lineno;
+
+    if (entry[0] == JOURNAL_INS) {
+        if (NULL == rec_fromstr(&e->rec, arg))
+            return false;
+        e->dt = e->rec.dt;
+        e->dind = -1;
+        return true;
+    }
+
+    if (entry[0] == JOURNAL_DEL) {
+        char iso[DT_ISOLEN + 1];
+        memcpy(iso, arg, DT_ISOLEN);
+        iso[DT_ISOLEN] = '\0';
+        if (!dt_isiso(iso) || arg[DT_ISOLEN] != *REC_DELIM)
+            return false;
+        bool status;
+        long long dind = util_stoi(arg + DT_ISOLEN + 1, &status);
+        if (!status || dind < 0)
+            return false;
+        e->dt = dt_fromiso(iso);
+        e->dind = dind;
+        return true;
+    }
+
+    return false;
+}
+
+/* journal_foreach callback. Apply E to the record list, skipping entries
+for records that are not loaded. Return false if E deletes a record that
+does not exist. Exit program on insufficient memory. */
+static bool journal_apply(void* arg, const JournalEntry* e)
+{
+    (void)arg;
+    if (!journal_loaded(e->dt))
+        return true;
+    if (e->dind < 0) {
+        if (NULL == rl_insert(&e->rec))
+            prog_err_nomem();
+        return true;
+    }
+    if (e->dind >= rl_slice(e->dt, e->dt))
+        return false;
+    rl_delete(rl_slicestart() + e->dind);
+    return true;
+}
+
+/* Call FN(ARG, E) for each entry E of the journal in order, if it belongs
+to the current data file, and set st_journal_current. Exit program on
+error, including if FN returns false, or if the journal holds entries that
+belong to neither the current data file nor a finished write of it. */
+static void journal_foreach(bool (*fn)(void* arg, const JournalEntry* e), void* arg)
+{
+    st_journal_current = false;
+    if (!util_fexists(PROG_JOURNALFN))
+        return;
+    FILE* f = fopen(PROG_JOURNALFN, "r");
+    if (f == NULL)
+        prog_err_read(PROG_JOURNALFN);
+
+    char header[JOURNAL_LINELEN];
+    journal_header(header);
+    char buf[JOURNAL_LINELEN + 1];
+    bool pending = false;   // whether entries follow the last fold line
+    for (ptrdiff_t lineno = 1; fgets(buf, sizeof buf, f); lineno++) {
+        size_t len = strlen(buf);
+        if (len && buf[len-1] == '\n')
+            buf[len-1] = '\0';
+        else if (!feof(f))
+            prog_err(PROG_JOURNALFN ":%td: line too long", lineno);
+
+        // a fold line in a current journal is left by an interrupted write,
+        // so the entries around it are all replayed
+        JournalEntry e;
+        if (lineno == 1) {
+            st_journal_current = (strcmp(buf, header) == 0);
+        } else if (buf[0] == JOURNAL_FOLD && buf[1] == '\0') {
+            pending = false;
+        } else if (!journal_parse(buf, lineno, &e)
+                   || (st_journal_current && !fn(arg, &e))) {
+            prog_err(PROG_JOURNALFN ":%td: invalid entry", lineno);
+        } else {
+            pending = true;
+        }
+    }
+
+    fclose(f);
+    if (!st_journal_current && pending)
+        prog_err(
+            "'%s' holds changes to another version of '%s'; restore that "
+            "version, or remove '%s' to discard the changes",
+            PROG_JOURNALFN, prog_datafn(), PROG_JOURNALFN
+        );
+}
+
+/* Replay journal entries on top of the freshly initialized record list.
+Exit program on error. */
+static void journal_replay(void)
+{
+    journal_foreach(journal_apply, NULL);
+    rl_resetslice();
+}
+
+/* Mark the current journal, if any, as folded in, just before the data
+file is written. Exit program on error. */
+static void journal_fold(void)
+{
+    if (!st_journal_current)
+        return;
+    FILE* f = fopen(PROG_JOURNALFN, "a");
+    if (f == NULL)
+        prog_err_write(PROG_JOURNALFN);
+    putc(JOURNAL_FOLD, f);
+    putc('\n', f);
+    if (fclose(f) != 0)
+        prog_err_write(PROG_JOURNALFN);
+}
+
+/* Remove the journal after the data file has been written. */
+static void journal_discard(void)
+{
+    if (util_fexists(PROG_JOURNALFN) && remove(PROG_JOURNALFN) != 0)
+        prog_err_write(PROG_JOURNALFN);
+    st_journal_current = false;
+}
+
+/* Append ENTRY to the journal, starting a new journal if there is no
+current one. Fold the journal into the data file if it has grown too
+large. Exit program on error. */
+static void journal_append(const char* entry)
+{
+    // a partial list is reloaded from the journal before being written, so
+    // the entry must be journaled even if it is folded in immediately
+    int64_t maxsize = prog_getconf(PROG_CONF_JOURNAL_MAX);
+    if (maxsize <= 0 && !st_ranged) {
+        prog_writerl();
+        return;
+    }
+
+    FILE* f = fopen(PROG_JOURNALFN, st_journal_current ? "a" : "w");
+    if (f == NULL)
+        prog_err_write(PROG_JOURNALFN);
+    if (!st_journal_current) {
+        char header[JOURNAL_LINELEN];
+        fputs(journal_header(header), f);
+        putc('\n', f);
+    }
+    fputs(entry, f);
+    putc('\n', f);
+    long size = ftell(f);
+    if (fclose(f) != 0 || size < 0)
+        prog_err_write(PROG_JOURNALFN);
+    st_journal_current = true;
+
+    if (size > maxsize)
+        prog_writerl();
+}
+
+void prog_journalins(const Record* rec)
+{
+    archive_check(dt_gety(rec->dt));
+    if (isyears()) {
+        years_touch(rec->dt);
+        prog_writerl();
+        return;
+    }
+    char entry[JOURNAL_LINELEN];
+    sprintf(entry, "%c" REC_DELIM "%s", JOURNAL_INS, rec_tostr(rec));
+    journal_append(entry);
+}
+
+void prog_journaldel(int32_t dt, ptrdiff_t dind)
+{
+    archive_check(dt_gety(dt));
+    if (isyears()) {
+        years_touch(dt);
+        prog_writerl();
+        return;
+    }
+    char entry[JOURNAL_LINELEN];
+    sprintf(entry, "%c" REC_DELIM "%s" REC_DELIM "%td", JOURNAL_DEL, dt_toiso(dt), dind);
+    journal_append(entry);
+}
+
+
+// <6> Tail Rewrites
+//
+// PROG_TAILFN consists of a line containing a byte offset, followed by the
+// serialization of every record from the first changed one onward. It is
+// applied by truncating the data file at that offset and appending the
+// rest of PROG_TAILFN. The file is only renamed into place once complete,
+// so it is either absent or safe to apply again.
+
+#define TAIL_TMPFN PROG_TAILFN ".tmp"
+
+/* Apply PROG_TAILFN to the data file, then remove it. Exit program on
+error. */
+static void tail_apply(void)
+{
+    FILE* tf = fopen(PROG_TAILFN, "rb");
+    if (tf == NULL)
+        prog_err_read(PROG_TAILFN);
+    char buf[BUFSIZ];
+    bool status = false;
+    long long offset = 0;
+    if (fgets(buf, sizeof buf, tf) && strchr(buf, '\n')) {
+        *strchr(buf, '\n') = '\0';
+        offset = util_stoi(buf, &status);
+    }
+    if (!status || offset < 0)
+        prog_err(PROG_TAILFN ": invalid offset");
+
+    FILE* f = fopen(PROG_DATAFN, "r+b");
+    if (f == NULL || !util_fseek(f, offset))
+        prog_err_write(PROG_DATAFN);
+    int64_t end = offset;
+    for (size_t n; (n = fread(buf, 1, sizeof buf, tf)); end += n)
+        if (fwrite(buf, 1, n, f) != n)
+            prog_err_write(PROG_DATAFN);
+    if (ferror(tf))
+        prog_err_read(PROG_TAILFN);
+    if (!util_ftruncate(f, end) || fclose(f) != 0)
+        prog_err_write(PROG_DATAFN);
+
+    fclose(tf);
+    if (remove(PROG_TAILFN) != 0)
+        prog_err_write(PROG_TAILFN);
+    index_discard();
+}
+
+/* Rewrite the data file from record START onward, which begins at byte
+OFFSET. Exit program on error. */
+static void tail_write(ptrdiff_t start, int64_t offset)
+{
+    FILE* f = fopen(TAIL_TMPFN, "wb");
+    if (f == NULL)
+        prog_err_write(TAIL_TMPFN);
+    fprintf(f, "%" PRId64 "\n", offset);
+    bool written = rl_writefrom(f, start);
+    if (fclose(f) != 0 || !written)
+        prog_err_write(TAIL_TMPFN);
+    if (rename(TAIL_TMPFN, PROG_TAILFN) != 0)
+        prog_err_write(PROG_TAILFN);
+    tail_apply();
+}
+
+
+// <7> Date Index
+//
+// PROG_INDEXFN is a DateIndex of the data file. It records the data file's
+// size and modification time and is rebuilt when they no longer match. It
+// is also discarded whenever this program writes the data file, in case
+// the write leaves both unchanged.
+
+#define INDEX_TMPFN PROG_INDEXFN ".tmp"
+
+/* Save DI as PROG_INDEXFN. The index only saves time, so failing to save
+it is not an error. */
+static void index_save(const DateIndex* di)
+{
+    FILE* f = fopen(INDEX_TMPFN, "wb");
+    if (f == NULL)
+        return;
+    bool written = di_write(di, f);
+    if (fclose(f) != 0 || !written || rename(INDEX_TMPFN, PROG_INDEXFN) != 0)
+        remove(INDEX_TMPFN);
+}
+
+/* Locate the lines of F, which is PROG_DATAFN, in the months from DT0 to
+DT1. Rebuild and save the index if it is missing or stale. Return
+false if F cannot be indexed, which means it has a bad or unsorted line.
+On Windows, START, STOP and LINE are left spanning the whole file. */
+static bool index_range(
+    FILE* f, int32_t dt0, int32_t dt1, int64_t* start, int64_t* stop, int64_t* line
+) {
+    int64_t size, mtime;
+    util_fstat(PROG_DATAFN, &size, &mtime);
+
+    DateIndex di;
+    FILE* xf = fopen(PROG_INDEXFN, "rb");
+    bool current = xf && di_read(&di, xf);
+    if (xf) fclose(xf);
+    if (current && (di.size != size || di.mtime != mtime)) {
+        di_free(&di);
+        current = false;
+    }
+
+    if (!current) {
+        FileView view;
+        if (!util_mapfile(f, &view))
+            return false;
+        bool built = di_build(&di, view.data, view.len);
+        util_unmapfile(&view);
+        if (!built)
+            return false;
+        di.mtime = mtime;
+        index_save(&di);
+    }
+
+    // text mode translation on Windows makes indexed offsets unreliable, so
+    // the whole file is searched instead, once the index has vouched for it
+    #ifndef _WIN32
+    di_range(&di, dt0, dt1, start, stop, line);
+    #endif // _WIN32
+    di_free(&di);
+    return true;
+}
+
+/* Remove PROG_INDEXFN, if any. */
+static void index_discard(void)
+{
+    if (util_fexists(PROG_INDEXFN))
+        remove(PROG_INDEXFN);
+}
+
+
+// <8> Record Cache
+//
+// PROG_CACHEFN starts with a tag identifying the text data file: CACHE_MAGIC
+// followed by the data file's size, modification time and content hash as
+// int64s. Next come the number of clean records and their line offsets in
+// the data file, as written by rl_writeclean, so a cached list still has
+// only its changed tail rewritten, and the rest is a binary image of the
+// records (see recordbin.h). Hashing the data file is much faster than
+// parsing it, and catches edits that leave the size and modification time
+// unchanged.
+
+#define CACHE_MAGIC "lgrtag2\n"
+#define CACHE_TMPFN PROG_CACHEFN ".tmp"
+
+/* Data files smaller than this are parsed quickly enough not to cache. */
+#define CACHE_MINSIZE (1 << 20)
+
+/* Store the tag of F, which is PROG_DATAFN, in TAG. Return false if F is
+too small to be worth caching or cannot be read. */
+static bool cache_tag(FILE* f, char* tag)
+{
+    int64_t size, mtime;
+    if (!util_fstat(PROG_DATAFN, &size, &mtime) || size < CACHE_MINSIZE)
+        return false;
+    FileView view;
+    if (!util_mapfile(f, &view))
+        return false;
+    int64_t hash = util_hash(view.data, view.len);
+    util_unmapfile(&view);
+
+    int64_t fields[] = {size, mtime, hash};
+    memcpy(tag, CACHE_MAGIC, sizeof CACHE_MAGIC - 1);
+    memcpy(tag + sizeof CACHE_MAGIC - 1, fields, sizeof fields);
+    return true;
+}
+
+/* Initialize record list from PROG_CACHEFN. Return false if the cache is
+missing, does not match TAG, or cannot be decoded. */
+static bool cache_load(const char* tag)
+{
+    FILE* f = fopen(PROG_CACHEFN, "rb");
+    if (f == NULL)
+        return false;
+    // the image follows the clean records' offsets, which are restored
+    // once it is loaded
+    char buf[CACHE_TAGLEN];
+    int64_t clean;
+    bool status = fread(buf, 1, CACHE_TAGLEN, f) == CACHE_TAGLEN
+        && memcmp(buf, tag, CACHE_TAGLEN) == 0
+        && fread(&clean, sizeof(clean), 1, f) == 1
+        && clean >= 0 && clean < INT64_MAX / (int64_t)sizeof(clean) - 2
+        && rl_initbin(f, CACHE_TAGLEN + (clean + 2) * (int64_t)sizeof(clean)) == 0
+        && util_fseek(f, CACHE_TAGLEN)
+        && rl_readclean(f);
+    fclose(f);
+    return status;
+}
+
+/* Save the freshly loaded record list as PROG_CACHEFN with TAG. The cache
+only saves time, so failing to save it is not an error. */
+static void cache_save(const char* tag)
+{
+    FILE* f = fopen(CACHE_TMPFN, "wb");
+    if (f == NULL)
+        return;
+    bool written = fwrite(tag, 1, CACHE_TAGLEN, f) == CACHE_TAGLEN
+        && rl_writeclean(f)
+        && rl_writebin(f);
+    #ifdef _WIN32
+    remove(PROG_CACHEFN);
+    #endif // _WIN32
+    if (fclose(f) != 0 || !written || rename(CACHE_TMPFN, PROG_CACHEFN) != 0)
+        remove(CACHE_TMPFN);
+}
+
+
+// <9> Year Partitions
+//
+// In the PROG_FORMAT_YEARS layout, the records dated in year Y are stored
+// in the PROG_YEARFN file for Y, and years without records have no file.
+// Each year file is small, so changes are written to the affected years
+// directly instead of being journaled, and none of the sidecar files above
+// are used.
+
+#define YEARS_MAX 9999
+
+/* Whether each year has changed since the record list was loaded. */
+static bool st_changed[YEARS_MAX + 1];
+
+/* Size of a year file's name, including the NUL. */
+#define YEARS_FNSIZE (sizeof PROG_NAME "_data_yyyy.tsv")
+
+static bool isyears(void)
+{
+    return prog_getconf(PROG_CONF_DATA_FORMAT) == PROG_FORMAT_YEARS;
+}
+
+/* Store the name of year Y's file in BUF. */
+static char* years_fn(int y, char* buf)
+{
+    sprintf(buf, PROG_YEARFN, y);
+    return buf;
+}
+
+/* Return Y if NAME is FMT formatted with year Y, or 0 otherwise. FMT must
+contain a single "%04d" and be shorter than YEARS_FNSIZE + 8. */
+static int fnyear(const char* fmt, const char* name)
+{
+    size_t prefixlen = strchr(fmt, '%') - fmt;
+    if (strlen(name) != strlen(fmt) || strncmp(name, fmt, prefixlen) != 0)
+        return 0;
+    int y = 0;
+    for (const char* p = name + prefixlen; p < name + prefixlen + 4; p++) {
+        if (*p < '0' || *p > '9')
+            return 0;
+        y = y * 10 + (*p - '0');
+    }
+    char buf[YEARS_FNSIZE + 8];
+    sprintf(buf, fmt, y);
+    return (dt_isy(y) && strcmp(name, buf) == 0) ? y : 0;
+}
+
+/* util_lsdir callback. Set EXISTS[Y] if NAME is year Y's file. */
+static void years_found(void* exists, const char* name)
+{
+    int y = fnyear(PROG_YEARFN, name);
+    if (y)
+        ((bool*)exists)[y] = true;
+}
+
+/* Set EXISTS[Y] for each year Y that has a file, and clear it for the rest
+of the years from 0 to YEARS_MAX. Exit program on error. */
+static void years_list(bool* exists)
+{
+    memset(exists, 0, (YEARS_MAX + 1) * sizeof(*exists));
+    if (!util_lsdir(years_found, exists))
+        prog_err("cannot list the files in the current directory");
+}
+
+/* Initialize record list from every year file, or only from the years
+overlapping st_dt0 to st_dt1 if st_ranged is set. Ranged loads are widened
+to whole years, so every loaded year can be written back. Exit program on
+error. */
+static void years_load(void)
+{
+    bool exists[YEARS_MAX + 1] = {0};
+    char fn[YEARS_FNSIZE];
+    if (st_ranged) {
+        int y0 = dt_gety(st_dt0), y1 = dt_gety(st_dt1);
+        for (int y = y0; y <= y1; y++)
+            exists[y] = util_fexists(years_fn(y, fn));
+        st_dt0 = dt_dt(y0, 1, 1);
+        st_dt1 = dt_dt(y1, 12, 31);
+    } else {
+        years_list(exists);
+    }
+
+    if (rl_init(NULL) != 0)
+        prog_err_nomem();
+    for (int y = 1; y <= YEARS_MAX; y++) {
+        if (!exists[y])
+            continue;
+        FILE* f = fopen(years_fn(y, fn), "r");
+        if (f == NULL)
+            prog_err_read(fn);
+        ptrdiff_t first = rl_count();
+        ptrdiff_t status = rl_append(f);
+        fclose(f);
+        if (status != 0)
+            loaderr(fn, status, 0, false);
+
+        // files are sorted, so only the ends can stray into another year
+        if (
+            rl_count() > first
+            && (dt_gety(rl_get(first)->dt) != y || dt_gety(rl_get(rl_count() - 1)->dt) != y)
+        ) prog_err("'%s' has transactions dated outside %d", fn, y);
+    }
+    memset(st_changed, 0, sizeof st_changed);
+}
+
+/* Write year Y's records to its file, or remove the file if there are
+none. The file is replaced only once completely written. Exit program on
+error. */
+static void years_write(int y)
+{
+    char fn[YEARS_FNSIZE], tmpfn[YEARS_FNSIZE + 4];
+    years_fn(y, fn);
+    if (rl_slice(dt_dt(y, 1, 1), dt_dt(y, 12, 31)) == 0) {
+        if (util_fexists(fn) && remove(fn) != 0)
+            prog_err_write(fn);
+        return;
+    }
+
+    sprintf(tmpfn, "%s.tmp", fn);
+    FILE* f = fopen(tmpfn, "w");
+    if (f == NULL)
+        prog_err_write(tmpfn);
+    bool written = rl_writeslice(f);
+    if (fclose(f) != 0 || !written)
+        prog_err_write(tmpfn);
+    #ifdef _WIN32
+    remove(fn);
+    #endif // _WIN32
+    if (rename(tmpfn, fn) != 0)
+        prog_err_write(fn);
+}
+
+/* Mark the year of DT as changed. */
+static void years_touch(int32_t dt)
+{
+    st_changed[dt_gety(dt)] = true;
+}
+
+/* Write the years changed since the record list was loaded. Ranged loads
+read whole years, so every changed year is loaded in full. */
+static void years_writechanged(void)
+{
+    for (int y = 1; y <= YEARS_MAX; y++)
+        if (st_changed[y])
+            years_write(y);
+    rl_resetslice();
+    memset(st_changed, 0, sizeof st_changed);
+}
+
+void prog_writeyears(void)
+{
+    bool exists[YEARS_MAX + 1];
+    years_list(exists);
+    for (int y = 1; y <= YEARS_MAX; y++)
+        if (exists[y] || rl_slice(dt_dt(y, 1, 1), dt_dt(y, 12, 31)))
+            years_write(y);
+    rl_resetslice();
+    memset(st_changed, 0, sizeof st_changed);
+}
+
+void prog_convert(enum prog_format format, const char* fn)
+{
+    if (format == PROG_FORMAT_YEARS) {
+        prog_writeyears();
+    } else {
+        bool bin = (format == PROG_FORMAT_BIN);
+        FILE* f = fopen(fn, bin ? "wb" : "w");
+        if (f == NULL)
+            prog_err_write(fn);
+        bool written = bin ? rl_writebin(f) : rl_write(f);
+        if (fclose(f) != 0 || !written)
+            prog_err_write(fn);
+    }
+
+    // the journal belongs to the data file in use, and would not match the
+    // new one
+    if (st_journal_current)
+        prog_writerl();
+}
+
+
+// <10> Archives
+//
+// The records of an archived year Y are stored in the PROG_ARCHIVEFN file
+// for Y (see archive.h) and nowhere else. Archived years are closed, so
+// records are never added to or removed from them, and commands that only
+// total records read the archive's stored totals instead of its records.
+
+/* Size of an archive's name, including the NUL. */
+#define ARCHIVE_FNSIZE (sizeof PROG_NAME "_archive_yyyy.bin")
+
+/* Whether each year has an archive. Only valid once st_archivedlisted is
+set. */
+static bool st_archived[YEARS_MAX + 1];
+static bool st_archivedlisted;
+
+/* Store the name of year Y's archive in BUF. */
+static char* archive_fn(int y, char* buf)
+{
+    sprintf(buf, PROG_ARCHIVEFN, y);
+    return buf;
+}
+
+/* util_lsdir callback. Set ARCHIVED[Y] if NAME is year Y's archive. */
+static void archive_found(void* archived, const char* name)
+{
+    int y = fnyear(PROG_ARCHIVEFN, name);
+    if (y)
+        ((bool*)archived)[y] = true;
+}
+
+bool prog_isarchived(int y)
+{
+    if (!st_archivedlisted) {
+        if (!util_lsdir(archive_found, st_archived))
+            prog_err("cannot list the files in the current directory");
+        st_archivedlisted = true;
+    }
+    return dt_isy(y) && st_archived[y];
+}
+
+/* Exit program if year Y is archived. */
+static void archive_check(int y)
+{
+    if (prog_isarchived(y))
+        prog_err("%d is archived and cannot be changed", y);
+}
+
+/* Exit program because records dated in archived year Y were found
+outside its archive, which only an interrupted archive leaves behind.
+Reading Y's archive as well would count those records twice. */
+static void archive_errunfinished(int y)
+{
+    prog_err("%d was not fully archived; archive it again to finish", y);
+}
+
+/* Exit program if the loaded record list still holds records from year
+Y. */
+static void archive_checkloaded(int y)
+{
+    // records are sorted, so find the first dated Y or later
+    int32_t dt0 = dt_dt(y, 1, 1);
+    ptrdiff_t lo = 0, hi = rl_count();
+    while (lo < hi) {
+        ptrdiff_t mid = lo + (hi - lo) / 2;
+        if (rl_get(mid)->dt < dt0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo < rl_count() && dt_gety(rl_get(lo)->dt) == y)
+        archive_errunfinished(y);
+}
+
+/* Map year Y's archive into VIEW and describe it in AR. Exit program on
+error. */
+static void archive_open(int y, FileView* view, Archive* ar)
+{
+    char fn[ARCHIVE_FNSIZE];
+    FILE* f = fopen(archive_fn(y, fn), "rb");
+    if (f == NULL)
+        prog_err_read(fn);
+    bool mapped = util_mapfile(f, view);
+    fclose(f);
+    if (!mapped)
+        prog_err_read(fn);
+    if (!ar_open(ar, view->data, view->len) || ar->y != y)
+        prog_err("'%s' is corrupt", fn);
+}
+
+/* Decode AR's records into the array at *RECS, which holds *COUNT records,
+growing it and adding to *COUNT. Exit program on error. */
+static void archive_decode(const Archive* ar, Record** recs, ptrdiff_t* count)
+{
+    if (ar->count > RL_MAXCOUNT - *count)
+        prog_err("transaction count would exceed limit of %td", RL_MAXCOUNT);
+    Record* new = realloc(*recs, (*count + ar->count + 1) * sizeof(*new));
+    if (new == NULL)
+        prog_err_nomem();
+    *recs = new;
+    ptrdiff_t status = ar_decode(ar, new + *count);
+    if (status) {
+        char fn[ARCHIVE_FNSIZE];
+        prog_err("'%s' is corrupt at record %td", archive_fn(ar->y, fn), status);
+    }
+    *count += ar->count;
+}
+
+/* Write the COUNT records at RECS, all dated in year Y, as Y's archive.
+The archive is replaced only once completely written. Exit program on
+error. */
+static void archive_write(int y, const Record* recs, ptrdiff_t count)
+{
+    char fn[ARCHIVE_FNSIZE], tmpfn[ARCHIVE_FNSIZE + 4];
+    archive_fn(y, fn);
+    sprintf(tmpfn, "%s.tmp", fn);
+    FILE* f = fopen(tmpfn, "wb");
+    if (f == NULL)
+        prog_err_write(tmpfn);
+    bool written = ar_write(f, y, recs, count);
+    if (fclose(f) != 0 || !written)
+        prog_err_write(tmpfn);
+    #ifdef _WIN32
+    remove(fn);
+    #endif // _WIN32
+    if (rename(tmpfn, fn) != 0)
+        prog_err_write(fn);
+}
+
+ptrdiff_t prog_archive(int y)
+{
+    int32_t dt0 = dt_dt(y, 1, 1), dt1 = dt_dt(y, 12, 31);
+    bool ooc = prog_outofcore();
+    if (ooc)
+        prog_initrlrange(dt0, dt1);
+    else
+        prog_initrl();
+    ptrdiff_t count = rl_slice(dt0, dt1);
+    Record* recs = malloc((count + 1) * sizeof(*recs));
+    if (recs == NULL)
+        prog_err_nomem();
+    rl_copy(rl_slicestart(), rl_slicestop(), recs);
+    if (!prog_isarchived(y)) {
+        if (count == 0)
+            prog_err("no transactions in %d", y);
+        archive_write(y, recs, count);
+        st_archived[y] = true;
+    } else {
+        // records are only left in an archived year by an interrupted
+        // archive, whose archive must hold exactly those records
+        if (count == 0)
+            prog_err("%d is already archived", y);
+        FileView view;
+        Archive ar;
+        archive_open(y, &view, &ar);
+        Record* archived = NULL;
+        ptrdiff_t narchived = 0;
+        archive_decode(&ar, &archived, &narchived);
+        util_unmapfile(&view);
+        bool same = (narchived == count);
+        for (ptrdiff_t i = 0; same && i < count; i++)
+            same = archived[i].dt == recs[i].dt
+                && archived[i].amt == recs[i].amt
+                && strcmp(archived[i].cat, recs[i].cat) == 0
+                && strcmp(archived[i].desc, recs[i].desc) == 0;
+        free(archived);
+        if (!same) {
+            char fn[ARCHIVE_FNSIZE];
+            prog_err("'%s' does not match the transactions in %d", archive_fn(y, fn), y);
+        }
+    }
+    free(recs);
+
+    if (ooc) {
+        ooc_write(NULL, dt0, dt1);
+        return count;
+    }
+    rl_deleteslice();
+    years_touch(dt0);
+    prog_writerl();
+    return count;
+}
+
+/* Call FN(ARG, REC) for every archived record REC dated in years Y0 to Y1
+that matches RF, decoding one archive at a time. Return the number of
+records matched. Exit program on error. */
+static ptrdiff_t archive_stream(
+    int y0, int y1, const RecordFilter* rf,
+    void (*fn)(void* arg, const Record* rec), void* arg
+) {
+    ptrdiff_t count = 0;
+    for (int y = y0; y <= y1; y++) {
+        if (!prog_isarchived(y))
+            continue;
+        FileView view;
+        Archive ar;
+        archive_open(y, &view, &ar);
+        Record* recs = NULL;
+        ptrdiff_t n = 0;
+        archive_decode(&ar, &recs, &n);
+        util_unmapfile(&view);
+        for (ptrdiff_t i = 0; i < n; i++) {
+            if (rs_match(rf, recs + i)) {
+                fn(arg, recs + i);
+                count++;
+            }
+        }
+        free(recs);
+    }
+    return count;
+}
+
+/* Store the range of archivable years overlapping DT0 to DT1 in Y0 and
+Y1. */
+static void archive_years(int32_t dt0, int32_t dt1, int* y0, int* y1)
+{
+    *y0 = util_max(1, dt_gety(dt0));
+    *y1 = util_min(YEARS_MAX, dt_gety(dt1));
+}
+
+void prog_loadarchives(int32_t dt0, int32_t dt1)
+{
+    Record* recs = NULL;
+    ptrdiff_t count = 0;
+    int y0, y1;
+    archive_years(dt0, dt1, &y0, &y1);
+    for (int y = y0; y <= y1; y++) {
+        if (!prog_isarchived(y))
+            continue;
+        archive_checkloaded(y);
+        FileView view;
+        Archive ar;
+        archive_open(y, &view, &ar);
+        archive_decode(&ar, &recs, &count);
+        util_unmapfile(&view);
+    }
+    if (count && !rl_insertmany(recs, count)) {
+        if (count > RL_MAXCOUNT - rl_count())
+            prog_err("transaction count would exceed limit of %td", RL_MAXCOUNT);
+        prog_err_nomem();
+    }
+    free(recs);
+    st_witharchives = st_witharchives || count;
+}
+
+ptrdiff_t prog_sumarchives(
+    const RecordFilter* rf,
+    void (*fn)(void* arg, int y, const ArTotal* t, const char* cat),
+    void* arg
+) {
+    ptrdiff_t count = 0;
+    int y0, y1;
+    archive_years(rf->dt0, rf->dt1, &y0, &y1);
+    for (int y = y0; y <= y1; y++) {
+        if (!prog_isarchived(y))
+            continue;
+        archive_checkloaded(y);
+        FileView view;
+        Archive ar;
+        archive_open(y, &view, &ar);
+
+        // stored totals answer ranges covering whole months of the year,
+        // unless descriptions must be matched
+        int32_t dt0 = util_max(rf->dt0, dt_dt(y, 1, 1));
+        int32_t dt1 = util_min(rf->dt1, dt_dt(y, 12, 31));
+        bool whole = rf->ndescs == 0
+            && dt_getd(dt0) == 1
+            && (dt1 == dt_dt(y, 12, 31) || dt_getd(dt_shiftd(dt1, 1)) == 1);
+        if (whole) {
+            for (ptrdiff_t i = 0; i < ar.ntotals; i++) {
+                ArTotal t = ar_total(&ar, i);
+                const char* cat = ar_cat(&ar, t.cat);
+                if (t.m < dt_getm(dt0) || t.m > dt_getm(dt1) || !rs_matchcat(rf, cat))
+                    continue;
+                fn(arg, y, &t, cat);
+                count += t.count;
+            }
+        } else {
+            Record* recs = NULL;
+            ptrdiff_t n = 0;
+            archive_decode(&ar, &recs, &n);
+            for (ptrdiff_t i = 0; i < n; i++) {
+                const Record* rec = recs + i;
+                if (!rs_match(rf, rec))
+                    continue;
+                ArTotal t = {
+                    .m = dt_getm(rec->dt),
+                    .in = (rec->amt > 0) ? rec->amt : 0,
+                    .out = (rec->amt < 0) ? rec->amt : 0,
+                    .count = 1,
+                };
+                fn(arg, y, &t, rec->cat);
+                count++;
+            }
+            free(recs);
+        }
+        util_unmapfile(&view);
+    }
+    return count;
+}
+
+
+// <11> Checks
+//
+// PROG_CHECKFN holds the valid blocks found by the last check (see
+// recordcheck.h), of every checked file in turn. Blocks are matched by
+// their contents, so the file never goes stale: at worst, nothing in it
+// matches and every line is deserialized again.
+
+#define CHECK_TMPFN PROG_CHECKFN ".tmp"
+
+/* Load the blocks saved by the last check into *BLOCKS and their number
+into *COUNT, or none if there are no usable saved blocks. */
+static void check_load(RcBlock** blocks, ptrdiff_t* count)
+{
+    FILE* f = fopen(PROG_CHECKFN, "rb");
+    if (f == NULL || !rc_read(blocks, count, f)) {
+        *blocks = NULL;
+        *count = 0;
+    }
+    if (f) fclose(f);
+}
+
+/* Save the COUNT blocks at BLOCKS as PROG_CHECKFN. The blocks only save
+time, so failing to save them is not an error. */
+static void check_save(const RcBlock* blocks, ptrdiff_t count)
+{
+    FILE* f = fopen(CHECK_TMPFN, "wb");
+    if (f == NULL)
+        return;
+    bool written = rc_write(blocks, count, f);
+    #ifdef _WIN32
+    remove(PROG_CHECKFN);
+    #endif // _WIN32
+    if (fclose(f) != 0 || !written || rename(CHECK_TMPFN, PROG_CHECKFN) != 0)
+        remove(CHECK_TMPFN);
+}
+
+/* State of a check across files. */
+typedef struct {
+    const RcBlock* known;
+    ptrdiff_t nknown;
+    RcBlock* blocks;    // valid blocks of the files checked so far
+    ptrdiff_t nblocks;
+    int64_t lines;
+    int64_t parsed;
+    ptrdiff_t nissues;
+    void (*fn)(void* arg, const char* name, const RcIssue* issue);
+    void* arg;
+} Check;
+
+/* Check the text file FN, adding its results to CHECK. Exit program on
+error. */
+static void check_file(Check* check, const char* fn)
+{
+    FILE* f = fopen(fn, "r");
+    if (f == NULL)
+        prog_err_read(fn);
+    FileView view;
+    bool mapped = util_mapfile(f, &view);
+    fclose(f);
+    if (!mapped)
+        prog_err_read(fn);
+
+    RcResult res;
+    int threads = util_max(0, util_min(prog_getconf(PROG_CONF_LOAD_THREADS), INT_MAX));
+    if (!rc_check(view.data, view.len, check->known, check->nknown, threads, &res))
+        prog_err_nomem();
+    util_unmapfile(&view);
+
+    for (ptrdiff_t i = 0; i < res.nissues; i++)
+        check->fn(check->arg, fn, res.issues + i);
+    RcBlock* new = realloc(check->blocks, (check->nblocks + res.nblocks + 1) * sizeof(*new));
+    if (new == NULL)
+        prog_err_nomem();
+    memcpy(new + check->nblocks, res.blocks, res.nblocks * sizeof(*new));
+    check->blocks = new;
+    check->nblocks += res.nblocks;
+    check->lines += res.lines;
+    check->parsed += res.parsed;
+    check->nissues += res.nissues;
+    rc_free(&res);
+}
+
+ptrdiff_t prog_check(
+    bool full, void (*fn)(void* arg, const char* name, const RcIssue* issue),
+    void* arg, int64_t* lines, int64_t* parsed
+) {
+    // a binary data file is validated in full whenever it is loaded
+    if (isbin()) {
+        prog_initrl();
+        *lines = *parsed = rl_count();
+        return 0;
+    }
+
+    RcBlock* known = NULL;
+    ptrdiff_t nknown = 0;
+    if (!full)
+        check_load(&known, &nknown);
+    Check check = {.known = known, .nknown = nknown, .fn = fn, .arg = arg};
+    if (isyears()) {
+        bool exists[YEARS_MAX + 1];
+        years_list(exists);
+        char yfn[YEARS_FNSIZE];
+        for (int y = 1; y <= YEARS_MAX; y++)
+            if (exists[y])
+                check_file(&check, years_fn(y, yfn));
+    } else {
+        if (util_fexists(PROG_TAILFN))
+            tail_apply();
+        if (util_fexists(PROG_DATAFN))
+            check_file(&check, PROG_DATAFN);
+    }
+
+    check_save(check.blocks, check.nblocks);
+    free(check.blocks);
+    free(known);
+    *lines = check.lines;
+    *parsed = check.parsed;
+    return check.nissues;
+}
+
+
+// <12> Out-of-Core Operation
+//
+// A PROG_DATAFN ledger is never loaded in full once its record list would
+// not fit in PROG_CONF_MEMORY_MAX bytes. Reads and writes instead stream
+// the data file from the first month they need, a day at a time: the
+// day's records are read from the file, the journal's entries for the day
+// are applied to them in order, and records inserted as a batch are added
+// after them, just as replaying the journal and then rl_insertmany would
+// order them in a loaded list. Only the journal, one day of records, and
+// the part of a batch that external merge sort keeps in memory are held at
+// once. Writes stream into PROG_TAILFN, which is applied as usual.
+
+/* Fewest chars in a serialized record, including its newline. */
+#define OOC_MINLINE (DT_ISOLEN + 6)
+
+/* Chars at the start of PROG_DATAFN read to estimate its line length. */
+#define OOC_SAMPLE (1 << 16)
+
+/* Most memory LINES loaded lines of SIZE chars in total can take: each
+line's description is shorter than the line by at least OOC_MINLINE. */
+#define OOC_LOADSIZE(lines, size) \
+    ((lines) * ((int64_t)RL_RECSIZE - OOC_MINLINE) + (size))
+
+/* Whether the ledger runs out of core. Only valid once st_outofcorechecked
+is set. */
+static bool st_outofcore;
+static bool st_outofcorechecked;
+
+/* A stream over the ledger's records. */
+typedef struct {
+    FILE* f;                // PROG_DATAFN, or NULL if there is none
+    RecordStream rs;
+    int64_t line;           // line number where the stream started
+    int32_t dt0, dt1;       // range of dates streamed
+    int32_t cut0, cut1;     // range of dates dropped
+    int32_t lastdt;         // date of the last line read
+    Record next;            // next record of the file, if HASNEXT
+    bool hasnext;
+    JournalEntry* entries;  // sorted by date, then line
+    ptrdiff_t nentries;
+    ptrdiff_t ientry;       // next entry to apply
+    ptrdiff_t entrycap;
+    RecordRuns* rr;         // batch to insert, or NULL
+    Record rrnext;          // next record of the batch, if RRHASNEXT
+    bool rrhasnext;
+    Record* day;            // records of the current day
+    ptrdiff_t nday;
+    ptrdiff_t iday;         // next record of the day to stream
+    ptrdiff_t daycap;
+} Ooc;
+
+bool prog_outofcore(void)
+{
+    if (st_outofcorechecked)
+        return st_outofcore;
+    st_outofcorechecked = true;
+    int64_t budget = prog_getconf(PROG_CONF_MEMORY_MAX);
+    int64_t size, mtime;
+    if (budget <= 0 || isbin() || isyears() || !util_fstat(PROG_DATAFN, &size, &mtime))
+        return false;
+    if (OOC_LOADSIZE(size / OOC_MINLINE, size) <= budget)
+        return false;
+
+    // estimate the number of lines from the first ones
+    FILE* f = fopen(PROG_DATAFN, "rb");
+    char* buf = malloc(OOC_SAMPLE);
+    if (f == NULL)
+        prog_err_read(PROG_DATAFN);
+    if (buf == NULL)
+        prog_err_nomem();
+    size_t n = fread(buf, 1, OOC_SAMPLE, f);
+    ptrdiff_t lines = scan_count(buf, n);
+    free(buf);
+    fclose(f);
+    int64_t linelen = lines ? n / lines : n;
+    st_outofcore = OOC_LOADSIZE(size / linelen, size) > budget;
+    return st_outofcore;
+}
+
+/* journal_foreach callback. Add E to the Ooc at OOC. */
+static bool ooc_addentry(void* ooc, const JournalEntry* e)
+{
+    Ooc* o = ooc;
+    if (o->nentries == o->entrycap) {
+        o->entrycap = o->entrycap ? o->entrycap * 2 : 64;
+        JournalEntry* new = realloc(o->entries, o->entrycap * sizeof(*new));
+        if (new == NULL)
+            prog_err_nomem();
+        o->entries = new;
+    }
+    o->entries[o->nentries++] = *e;
+    return true;
+}
+
+static int cmpentries(const void* a, const void* b)
+{
+    const JournalEntry* x = a;
+    const JournalEntry* y = b;
+    if (x->dt != y->dt)
+        return (x->dt > y->dt) - (x->dt < y->dt);
+    return (x->lineno > y->lineno) - (x->lineno < y->lineno);
+}
+
+/* Exit program because the temporary files of a batch cannot be used. */
+static void ooc_errruns(void)
+{
+    prog_err("cannot sort the batch in temporary " PROG_NAME "_run files");
+}
+
+/* Read the next record of the batch, if any. */
+static void ooc_readrun(Ooc* o)
+{
+    o->rrhasnext = false;
+    if (o->rr == NULL)
+        return;
+    enum rr_status status = rr_next(o->rr, &o->rrnext);
+    if (status == RR_READERR)
+        ooc_errruns();
+    if (status == RR_OK) {
+        archive_check(dt_gety(o->rrnext.dt));
+        o->rrhasnext = true;
+    }
+}
+
+/* Read the next record of the data file dated within the stream's range,
+if any. */
+static void ooc_readfile(Ooc* o)
+{
+    o->hasnext = false;
+    while (o->f) {
+        enum rs_status status = rs_next(&o->rs, &o->next);
+        int64_t line = o->line + o->rs.lineno;
+        if (status == RS_END)
+            return;
+        if (status == RS_READERR)
+            prog_err_read(PROG_DATAFN);
+        if (status == RS_BADLINE)
+            prog_err(PROG_DATAFN ":%" PRId64 ": line too long or cannot be deserialized", line);
+        if (o->next.dt < o->lastdt)
+            prog_err(PROG_DATAFN ":%" PRId64 ": line out of order", line);
+        o->lastdt = o->next.dt;
+        if (o->next.dt > o->dt1)
+            return;
+        if (o->next.dt >= o->dt0) {
+            o->hasnext = true;
+            return;
+        }
+    }
+}
+
+/* Initialize O to stream the ledger with the records of RR, which must be
+finished, inserted, if RR is not NULL, and the records dated CUT0 to CUT1
+dropped. Finish any interrupted write and read the journal. Call ooc_seek
+before streaming. */
+static void ooc_open(Ooc* o, RecordRuns* rr, int32_t cut0, int32_t cut1)
+{
+    *o = (Ooc){.cut0 = cut0, .cut1 = cut1, .rr = rr};
+    if (util_fexists(PROG_TAILFN))
+        tail_apply();
+    journal_foreach(ooc_addentry, o);
+    qsort(o->entries, o->nentries, sizeof(*o->entries), cmpentries);
+    ooc_readrun(o);
+}
+
+/* Stream the records dated DT0 to DT1. Return the offset in the data file
+where streaming starts, at the first line of DT0's month or later. If
+WHOLE, the file's records are streamed from that offset on, even those
+dated before DT0. */
+static int64_t ooc_seek(Ooc* o, int32_t dt0, int32_t dt1, bool whole)
+{
+    o->dt0 = dt0;
+    o->dt1 = dt1;
+    o->lastdt = INT32_MIN;
+    while (o->ientry < o->nentries && o->entries[o->ientry].dt < dt0)
+        o->ientry++;
+    if (!util_fexists(PROG_DATAFN))
+        return 0;
+
+    // without an index, the whole file is read
+    o->f = fopen(PROG_DATAFN, "r");
+    if (o->f == NULL)
+        prog_err_read(PROG_DATAFN);
+    int64_t start = 0, stop = INT64_MAX, size, mtime;
+    if (!index_range(o->f, dt0, INT32_MAX, &start, &stop, &o->line))
+        start = o->line = 0;
+    else if (start == stop && util_fstat(PROG_DATAFN, &size, &mtime))
+        start = size;
+    if (!util_fseek(o->f, start))
+        prog_err_read(PROG_DATAFN);
+    if (!rs_open(&o->rs, o->f))
+        prog_err_nomem();
+    if (whole)
+        o->dt0 = INT32_MIN;
+    ooc_readfile(o);
+    return start;
+}
+
+/* Add REC to the current day. */
+static void ooc_push(Ooc* o, const Record* rec)
+{
+    if (o->nday == o->daycap) {
+        o->daycap = o->daycap ? o->daycap * 2 : 64;
+        Record* new = realloc(o->day, o->daycap * sizeof(*new));
+        if (new == NULL)
+            prog_err_nomem();
+        o->day = new;
+    }
+    o->day[o->nday++] = *rec;
+}
+
+/* Gather the next day with records into the current day. Return false if
+there are no more. */
+static bool ooc_nextday(Ooc* o)
+{
+    while (true) {
+        int32_t dt = INT32_MAX;
+        bool any = o->hasnext || o->ientry < o->nentries || o->rrhasnext;
+        if (o->hasnext)
+            dt = o->next.dt;
+        if (o->ientry < o->nentries)
+            dt = util_min(dt, o->entries[o->ientry].dt);
+        if (o->rrhasnext)
+            dt = util_min(dt, o->rrnext.dt);
+        if (!any || dt > o->dt1)
+            return false;
+
+        o->nday = o->iday = 0;
+        for (; o->hasnext && o->next.dt == dt; ooc_readfile(o))
+            ooc_push(o, &o->next);
+        for (; o->ientry < o->nentries && o->entries[o->ientry].dt == dt; o->ientry++) {
+            const JournalEntry* e = o->entries + o->ientry;
+            if (e->dind < 0) {
+                ooc_push(o, &e->rec);
+                continue;
+            }
+            if (e->dind >= o->nday)
+                prog_err(PROG_JOURNALFN ":%td: invalid entry", e->lineno);
+            o->nday--;
+            for (ptrdiff_t i = e->dind; i < o->nday; i++)
+                o->day[i] = o->day[i+1];
+        }
+        for (; o->rrhasnext && o->rrnext.dt == dt; ooc_readrun(o))
+            ooc_push(o, &o->rrnext);
+        if (dt >= o->cut0 && dt <= o->cut1)
+            o->nday = 0;
+        if (o->nday)
+            return true;
+    }
+}
+
+/* Read the next record into REC. Return false if there are no more. */
+static bool ooc_next(Ooc* o, Record* rec)
+{
+    if (o->iday == o->nday && !ooc_nextday(o))
+        return false;
+    *rec = o->day[o->iday++];
+    return true;
+}
+
+/* Deallocate. */
+static void ooc_close(Ooc* o)
+{
+    if (o->f) {
+        rs_close(&o->rs);
+        fclose(o->f);
+    }
+    free(o->entries);
+    free(o->day);
+}
+
+/* Write the ledger with the journal folded in, the records of RR
+inserted if RR is not NULL, and the records dated CUT0 to CUT1 dropped,
+streaming from the first month changed into PROG_TAILFN. Exit program on
+error. */
+static void ooc_write(RecordRuns* rr, int32_t cut0, int32_t cut1)
+{
+    Ooc o;
+    ooc_open(&o, rr, cut0, cut1);
+    int32_t first = INT32_MAX;
+    if (o.nentries)
+        first = o.entries[0].dt;
+    if (o.rrhasnext)
+        first = util_min(first, o.rrnext.dt);
+    if (cut0 <= cut1)
+        first = util_min(first, cut0);
+    if (first == INT32_MAX) {
+        ooc_close(&o);
+        journal_discard();
+        return;
+    }
+
+    FILE* f = fopen(TAIL_TMPFN, "wb");
+    if (f == NULL)
+        prog_err_write(TAIL_TMPFN);
+    fprintf(f, "%" PRId64 "\n", ooc_seek(&o, first, INT32_MAX, true));
+    OutBuf ob;
+    if (!ob_open(&ob, f, OB_DEFAULTCAP))
+        prog_err_nomem();
+    for (Record rec; ooc_next(&o, &rec);) {
+        char* p = ob_reserve(&ob, REC_STRLEN + 1);
+        int len = rec_tobuf(&rec, p);
+        p[len] = '\n';
+        ob_commit(&ob, len + 1);
+    }
+    bool written = ob_close(&ob);
+    ooc_close(&o);
+    if (fclose(f) != 0 || !written)
+        prog_err_write(TAIL_TMPFN);
+    journal_fold();
+    if (rename(TAIL_TMPFN, PROG_TAILFN) != 0)
+        prog_err_write(PROG_TAILFN);
+    tail_apply();
+    journal_discard();
+}
+
+ptrdiff_t prog_streamrl(
+    const RecordFilter* rf, bool archives,
+    void (*fn)(void* arg, const Record* rec), void* arg
+) {
+    ptrdiff_t count = 0;
+    if (isbin() || isyears()) {
+        prog_initrlrange(rf->dt0, rf->dt1);
+        if (archives)
+            prog_loadarchives(rf->dt0, rf->dt1);
+        for (ptrdiff_t i = 0; i < rl_count(); i++) {
+            if (rs_match(rf, rl_get(i))) {
+                fn(arg, rl_get(i));
+                count++;
+            }
+        }
+        return count;
+    }
+
+    // archived years hold no other records, so each is streamed before the
+    // first record of a later year
+    int y, y1;
+    archive_years(rf->dt0, rf->dt1, &y, &y1);
+    Ooc o;
+    ooc_open(&o, NULL, 1, 0);
+    ooc_seek(&o, rf->dt0, rf->dt1, false);
+    Record rec;
+    for (int lasty = 0; ooc_next(&o, &rec);) {
+        int recy = dt_gety(rec.dt);
+        if (recy != lasty) {
+            if (prog_isarchived(recy))
+                archive_errunfinished(recy);
+            if (archives)
+                count += archive_stream(y, recy - 1, rf, fn, arg);
+            y = util_max(y, recy + 1);
+            lasty = recy;
+        }
+        if (rs_match(rf, &rec)) {
+            fn(arg, &rec);
+            count++;
+        }
+    }
+    if (archives)
+        count += archive_stream(y, y1, rf, fn, arg);
+    ooc_close(&o);
+    return count;
+}
+
+void prog_runsopen(RecordRuns* rr)
+{
+    int64_t budget = prog_getconf(PROG_CONF_MEMORY_MAX);
+    size_t size = (budget > 0 && (uint64_t)budget < SIZE_MAX) ? (size_t)budget : SIZE_MAX;
+    if (!rr_open(rr, size, PROG_RUNFN))
+        prog_err_nomem();
+}
+
+void prog_runsadd(RecordRuns* rr, const Record* rec)
+{
+    if (!rr_add(rr, rec))
+        ooc_errruns();
+}
+
+void prog_insertruns(RecordRuns* rr)
+{
+    if (!rr_finish(rr))
+        ooc_errruns();
+
+    // other formats are always loaded
+    if (isbin() || isyears()) {
+        Record* recs = malloc((rr->total + 1) * sizeof(*recs));
+        if (recs == NULL)
+            prog_err_nomem();
+        ptrdiff_t count = 0;
+        for (enum rr_status status; (status = rr_next(rr, recs + count)) != RR_END; count++)
+            if (status == RR_READERR)
+                ooc_errruns();
+        rr_close(rr);
+        prog_insertmany(recs, count);
+        free(recs);
+        return;
+    }
+
+    if (rr->total)
+        ooc_write(rr, 1, 0);
+    rr_close(rr);
+}
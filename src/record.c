@@ -1,10 +1,11 @@
 #include <ctype.h>
-#include <inttypes.h>
-#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "util.h"
 #include "date.h"
+#include "hashtable.h"
 #include "record.h"
 
 Record* rec_init(Record* rec, int32_t dt, int64_t amt, const char* cat, const char* desc)
@@ -35,53 +36,256 @@ Record* rec_init(Record* rec, int32_t dt, int64_t amt, const char* cat, const ch
 
 Record* rec_fromstr(Record* rec, const char* s)
 {
-    enum {DT, AMT, CAT, DESC, ATTRCOUNT};
-
-    // copy s to scpy, replacing DELIM with NUL
-    // ensure DELIM appears at least 3 times
-    char scpy[REC_STRLEN + 1];
-    char* attrptrs[ATTRCOUNT];
-    {
-        const char* src = s;
-        char* dest = scpy;
-        attrptrs[0] = dest;
-        int delims = 0;
-        for (; *src; src++, dest++) {
-            if (*src != *REC_DELIM || delims >= ATTRCOUNT - 1) {
-                *dest = *src;
-            } else {
-                *dest = '\0';
-                attrptrs[++delims] = dest + 1;
-            }
-        }
-        if (delims < ATTRCOUNT - 1) return NULL;
-        *dest = '\0';
+    return rec_fromstrn(rec, s, strlen(s));
+}
+
+/* Parse an amount field ending at END with the same syntax util_stoi
+accepts: optional whitespace, an optional sign, then digits. Return 0 if
+the field is invalid or out of range. */
+static int64_t parseamt(const char* s, const char* end)
+{
+    // the field cannot contain DELIM, so only the other whitespace chars
+    // need skipping
+    while (s < end && (*s == ' ' || (*s >= '\n' && *s <= '\r')))
+        s++;
+    bool neg = false;
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = (*s++ == '-');
+    if (s == end)
+        return 0;
+
+    // stop accumulating once out of range to avoid overflowing
+    int64_t mag = 0;
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9')
+            return 0;
+        if (mag <= REC_AMT_MAX)
+            mag = mag*10 + (*s - '0');
+    }
+    if (mag > REC_AMT_MAX)
+        return 0;
+    return neg ? -mag : mag;
+}
+
+/* Return why parseamt rejects the amount field ending at END: it is either
+not an integer or zero, or out of range. */
+static enum rec_fault amtfault(const char* s, const char* end)
+{
+    while (s < end && (*s == ' ' || (*s >= '\n' && *s <= '\r')))
+        s++;
+    if (s < end && (*s == '-' || *s == '+'))
+        s++;
+    bool nonzero = false;
+    for (const char* p = s; p < end; p++) {
+        if (*p < '0' || *p > '9')
+            return REC_FAULT_AMT;
+        nonzero = nonzero || *p != '0';
+    }
+    return nonzero ? REC_FAULT_RANGE : REC_FAULT_AMT;
+}
+
+enum rec_fault rec_diagnose(const char* s, size_t len)
+{
+    if (len > REC_STRLEN)
+        return REC_FAULT_LONG;
+    size_t delims[REC_NDELIMS];
+    const char* p = s;
+    for (int i = 0; i < REC_NDELIMS; i++, p++) {
+        p = memchr(p, *REC_DELIM, s + len - p);
+        if (p == NULL)
+            return REC_FAULT_FIELDS;
+        delims[i] = p - s;
+    }
+
+    Record rec;
+    if (rec_fromfields(&rec, s, len, delims))
+        return REC_VALID;
+    if (
+        delims[0] != DT_ISOLEN || !dt_isisoprefix(s)
+        || !dt_isdt(dt_fromiso(s))
+    ) return REC_FAULT_DATE;
+    if (!parseamt(s + delims[0] + 1, s + delims[1]))
+        return amtfault(s + delims[0] + 1, s + delims[1]);
+    return REC_FAULT_CAT;
+}
+
+Record* rec_fromstrn(Record* rec, const char* s, size_t len)
+{
+    size_t delims[REC_NDELIMS];
+    const char* p = s;
+    for (int i = 0; i < REC_NDELIMS; i++, p++) {
+        p = memchr(p, *REC_DELIM, s + len - p);
+        if (p == NULL)
+            return NULL;
+        delims[i] = p - s;
+    }
+    return rec_fromfields(rec, s, len, delims);
+}
+
+Record* rec_fromfields(
+    Record* rec, const char* s, size_t len, const size_t* delims
+) {
+    enum {DT, AMT, CAT};
+
+    // date
+    if (delims[DT] != DT_ISOLEN || !dt_isisoprefix(s))
+        return NULL;
+    int32_t dt = dt_fromiso(s);
+    if (!dt_isdt(dt))
+        return NULL;
+
+    // amount
+    int64_t amt = parseamt(s + delims[DT] + 1, s + delims[AMT]);
+    if (!amt)
+        return NULL;
+
+    // category; a NUL would end the line for rec_fromstr, leaving too few
+    // delimiters
+    const char* cat = s + delims[AMT] + 1;
+    size_t catfield = delims[CAT] - delims[AMT] - 1;
+    if (catfield == 0 || memchr(cat, '\0', catfield))
+        return NULL;
+    size_t catlen = util_min(catfield, REC_CATLEN);
+    for (size_t i = 0; i < catlen; i++) {
+        char c = cat[i];
+        rec->cat[i] = (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
     }
+    rec->cat[catlen] = '\0';
+
+    // description; everything else, including further delimiters
+    size_t desclen = util_min(len - delims[CAT] - 1, REC_DESCLEN);
+    memcpy(rec->desc, s + delims[CAT] + 1, desclen);
+    rec->desc[desclen] = '\0';
 
-    int64_t amt;
-    return (
-        (amt = util_stoi(attrptrs[AMT], NULL))
-        && dt_isiso(attrptrs[DT])
-        && rec_init(
-            rec,
-            dt_fromiso(attrptrs[DT]),
-            amt,
-            attrptrs[CAT],
-            attrptrs[DESC]
-        )
-    ) ? rec : NULL;
+    rec->dt = dt;
+    rec->amt = amt;
+    return rec;
+}
+
+bool rec_initcats(RecordCats* cats)
+{
+    *cats = (RecordCats){.ids = ht_new(HT_STR)};
+    return cats->ids != NULL;
+}
+
+void rec_freecats(RecordCats* cats)
+{
+    free(cats->names);
+    ht_free(cats->ids);
+    *cats = (RecordCats){0};
+}
+
+int32_t rec_intern(RecordCats* cats, const char* cat)
+{
+    int64_t* id = ht_get(cats->ids, cat);
+    if (id)
+        return *id;
+    if (cats->count == cats->cap) {
+        if (cats->cap > INT32_MAX / 2)
+            return -1;
+        int32_t cap = cats->cap ? cats->cap * 2 : 16;
+        char (*names)[REC_CATLEN + 1] = realloc(cats->names, cap * sizeof(*names));
+        if (names == NULL)
+            return -1;
+        cats->names = names;
+        cats->cap = cap;
+    }
+    char* name = cats->names[cats->count];
+    memset(name, 0, sizeof(*cats->names));
+    strncpy(name, cat, REC_CATLEN);
+    if (NULL == ht_insert(cats->ids, name, cats->count))
+        return -1;
+    return cats->count++;
+}
+
+int32_t rec_catid(const RecordCats* cats, const char* cat)
+{
+    const int64_t* id = ht_get(cats->ids, cat);
+    return id ? *id : -1;
+}
+
+bool rec_reservedescs(RecordDescs* descs, size_t len)
+{
+    // the chars are allocated even for no descriptions, so every
+    // description has a valid address
+    if (descs->chars && len <= (size_t)(descs->cap - descs->len))
+        return true;
+    if (len > (size_t)(INT64_MAX / 2 - descs->len))
+        return false;
+    int64_t cap = util_max(descs->len + (int64_t)len, descs->cap * 2);
+    cap = util_max(cap, 4096);
+    if ((uint64_t)cap > SIZE_MAX)
+        return false;
+    char* chars = realloc(descs->chars, cap);
+    if (chars == NULL)
+        return false;
+    descs->chars = chars;
+    descs->cap = cap;
+    return true;
+}
+
+int64_t rec_putdescs(RecordDescs* descs, const char* s, size_t len)
+{
+    if (!rec_reservedescs(descs, len))
+        return -1;
+    int64_t off = descs->len;
+    memcpy(descs->chars + off, s, len);
+    descs->len += len;
+    return off;
+}
+
+void rec_freedescs(RecordDescs* descs)
+{
+    free(descs->chars);
+    *descs = (RecordDescs){0};
+}
+
+Record* rec_fromcols(Record* rec, const RecordColumns* cols, ptrdiff_t index)
+{
+    rec->dt = cols->dt[index];
+    rec->amt = cols->amt[index];
+    memcpy(rec->cat, cols->cats->names[cols->cat[index]], sizeof(rec->cat));
+    size_t desclen = cols->desclen[index];
+    memcpy(rec->desc, cols->descs->chars + cols->descoff[index], desclen);
+    rec->desc[desclen] = '\0';
+    return rec;
+}
+
+bool rec_tocols(const Record* rec, const RecordColumns* cols, ptrdiff_t index)
+{
+    int32_t id = rec_intern(cols->cats, rec->cat);
+    size_t desclen = strlen(rec->desc);
+    int64_t descoff = (id < 0) ? -1 : rec_putdescs(cols->descs, rec->desc, desclen);
+    if (descoff < 0)
+        return false;
+    cols->dt[index] = rec->dt;
+    cols->amt[index] = rec->amt;
+    cols->cat[index] = id;
+    cols->descoff[index] = descoff;
+    cols->desclen[index] = desclen;
+    return true;
 }
 
 char* rec_tostr(const Record* rec)
 {
     static char buf[REC_STRLEN + 1];
-    sprintf(
-        buf,
-        "%s" REC_DELIM "%" PRId64 REC_DELIM "%s" REC_DELIM "%s",
-        dt_toiso(rec->dt),
-        rec->amt,
-        rec->cat,
-        rec->desc
-    );
+    buf[rec_tobuf(rec, buf)] = '\0';
     return buf;
 }
+
+int rec_tobuf(const Record* rec, char* buf)
+{
+    char* p = buf;
+    p += dt_writeiso(rec->dt, p);
+    *p++ = *REC_DELIM;
+    p += util_fmtint(rec->amt, p);
+    *p++ = *REC_DELIM;
+    size_t catlen = strlen(rec->cat);
+    memcpy(p, rec->cat, catlen);
+    p += catlen;
+    *p++ = *REC_DELIM;
+    size_t desclen = strlen(rec->desc);
+    memcpy(p, rec->desc, desclen);
+    p += desclen;
+    return p - buf;
+}
@@ -0,0 +1,511 @@
+// <1> Flatbuffers
+// <2> Metadata
+// <3> Writing
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "hashtable.h"
+#include "outbuf.h"
+#include "record.h"
+#include "recordarrow.h"
+
+
+// <1> Flatbuffers
+//
+// Arrow metadata is serialized as flatbuffers. Objects are built front to
+// back: a table is written before the objects it refers to, whose offsets
+// are filled in once they are written, so every offset points forward as
+// the format requires. A table is preceded by its vtable.
+
+/* Most fields in any table built here. */
+#define MAXFIELDS 6
+
+typedef struct {
+    char* buf;
+    size_t len;
+    size_t cap;
+    bool err;       // whether an allocation has failed
+} Builder;
+
+/* Append LEN chars from S, or zeros if S is NULL. Return the position of
+the first. */
+static size_t append(Builder* b, const void* s, size_t len)
+{
+    size_t pos = b->len;
+    if (b->cap - b->len < len) {
+        size_t cap = 2*b->cap + len;
+        char* buf = realloc(b->buf, cap);
+        if (buf == NULL) {
+            b->err = true;
+            return pos;
+        }
+        b->buf = buf;
+        b->cap = cap;
+    }
+    if (s)
+        memcpy(b->buf + pos, s, len);
+    else
+        memset(b->buf + pos, 0, len);
+    b->len += len;
+    return pos;
+}
+
+/* Append zeros until the length is a multiple of N. */
+static void align(Builder* b, size_t n)
+{
+    append(b, NULL, (n - b->len % n) % n);
+}
+
+/* Overwrite LEN chars at POS with those at S. */
+static void put(Builder* b, size_t pos, const void* s, size_t len)
+{
+    if (!b->err)
+        memcpy(b->buf + pos, s, len);
+}
+
+/* Point the offset at POS to the object at TARGET, which follows it. */
+static void setref(Builder* b, size_t pos, size_t target)
+{
+    uint32_t off = target - pos;
+    put(b, pos, &off, sizeof off);
+}
+
+/* Start a new buffer whose root offset is at position 0. */
+static void reset(Builder* b)
+{
+    b->len = 0;
+    append(b, NULL, 4);
+}
+
+/* Write a table of N fields with the given SIZES, where a size of 0 marks
+an absent field, storing the position of each field in POS. Fields start
+zeroed and are aligned to their sizes. Return the table's position. */
+static size_t table(Builder* b, int n, const int* sizes, size_t* pos)
+{
+    uint16_t vt[2 + MAXFIELDS];
+    size_t off = 4;
+    for (int i = 0; i < n; i++) {
+        if (sizes[i] == 0) {
+            vt[2+i] = 0;
+            continue;
+        }
+        off = (off + sizes[i] - 1) / sizes[i] * sizes[i];
+        vt[2+i] = off;
+        off += sizes[i];
+    }
+    vt[0] = 2 * (2+n);
+    vt[1] = off;
+
+    align(b, 2);
+    size_t vtpos = append(b, vt, vt[0]);
+    align(b, 8);
+    size_t tpos = append(b, NULL, off);
+    int32_t soff = tpos - vtpos;
+    put(b, tpos, &soff, sizeof soff);
+    for (int i = 0; i < n; i++)
+        pos[i] = tpos + vt[2+i];
+    return tpos;
+}
+
+/* Write a vector of N elements of SIZE chars at ELEMS, or zeros if ELEMS
+is NULL. Elements are aligned to 8. Return the vector's position. */
+static size_t vector(Builder* b, const void* elems, size_t n, size_t size)
+{
+    align(b, 4);
+    if (b->len % 8 == 0)
+        append(b, NULL, 4);
+    uint32_t len = n;
+    size_t pos = append(b, &len, sizeof len);
+    append(b, elems, n * size);
+    return pos;
+}
+
+/* Write S as a string. Return its position. */
+static size_t string(Builder* b, const char* s)
+{
+    align(b, 4);
+    uint32_t len = strlen(s);
+    size_t pos = append(b, &len, sizeof len);
+    append(b, s, len + 1);
+    return pos;
+}
+
+
+// <2> Metadata
+//
+// Tables, unions and enums from Arrow's Schema.fbs, Message.fbs and
+// File.fbs, with only the fields used here.
+
+#define METADATA_V5 4
+
+enum header {HEADER_SCHEMA = 1, HEADER_DICTIONARYBATCH = 2, HEADER_RECORDBATCH = 3};
+enum type {TYPE_INT = 2, TYPE_UTF8 = 5, TYPE_DATE = 8};
+
+/* The dictionary id of the category column. */
+#define CATDICT 0
+
+/* Column count and buffers per record batch. */
+#define NCOLS 4
+#define NBUFS 9
+
+/* A file block, as in File.fbs. */
+typedef struct {
+    int64_t offset;
+    int32_t metalen;
+    int32_t pad;
+    int64_t bodylen;
+} Block;
+
+static size_t inttype(Builder* b, int32_t width, bool issigned)
+{
+    size_t pos[2];
+    size_t t = table(b, 2, (int[]){4, 1}, pos);
+    put(b, pos[0], &width, sizeof width);
+    put(b, pos[1], &issigned, 1);
+    return t;
+}
+
+/* Write a non-nullable field of TYPE named NAME, dictionary encoded with
+int32 indices if DICT. */
+static size_t field(Builder* b, const char* name, uint8_t type, bool dict)
+{
+    size_t pos[6];
+    size_t t = table(b, 6, (int[]){4, 1, 1, 4, dict ? 4 : 0, 4}, pos);
+    put(b, pos[2], &type, 1);
+    setref(b, pos[0], string(b, name));
+
+    size_t tt, ttpos[1];
+    if (type == TYPE_INT) {
+        tt = inttype(b, 64, true);
+    } else if (type == TYPE_DATE) {
+        // the unit defaults to milliseconds, so days must be written
+        tt = table(b, 1, (int[]){2}, ttpos);
+    } else {
+        tt = table(b, 0, NULL, ttpos);
+    }
+    setref(b, pos[3], tt);
+
+    if (dict) {
+        size_t dpos[3];
+        size_t d = table(b, 3, (int[]){8, 4, 1}, dpos);
+        int64_t id = CATDICT;
+        put(b, dpos[0], &id, sizeof id);
+        setref(b, dpos[1], inttype(b, 32, true));
+        setref(b, pos[4], d);
+    }
+    setref(b, pos[5], vector(b, NULL, 0, 4));
+    return t;
+}
+
+static size_t schema(Builder* b)
+{
+    size_t pos[2];
+    size_t t = table(b, 2, (int[]){2, 4}, pos);
+    uint16_t one = 1;
+    int16_t endianness = (*(char*)&one == 1) ? 0 : 1;
+    put(b, pos[0], &endianness, sizeof endianness);
+
+    struct {const char* name; uint8_t type; bool dict;} fields[NCOLS] = {
+        {"date", TYPE_DATE, false},
+        {"amount", TYPE_INT, false},
+        {"category", TYPE_UTF8, true},
+        {"description", TYPE_UTF8, false},
+    };
+    size_t v = vector(b, NULL, NCOLS, 4);
+    setref(b, pos[1], v);
+    for (int i = 0; i < NCOLS; i++)
+        setref(b, v + 4 + 4*i, field(b, fields[i].name, fields[i].type, fields[i].dict));
+    return t;
+}
+
+/* Write the root Message table with a header of TYPE and a body of
+BODYLEN chars. Return the position of the header's offset. */
+static size_t message(Builder* b, uint8_t type, int64_t bodylen)
+{
+    reset(b);
+    size_t pos[4];
+    setref(b, 0, table(b, 4, (int[]){2, 1, 4, 8}, pos));
+    int16_t version = METADATA_V5;
+    put(b, pos[0], &version, sizeof version);
+    put(b, pos[1], &type, 1);
+    put(b, pos[3], &bodylen, sizeof bodylen);
+    return pos[2];
+}
+
+/* Write a RecordBatch table of LENGTH rows with NNODES columns of the same
+length and no nulls. BUFS holds NBUFS offset and length pairs. */
+static size_t recordbatch(
+    Builder* b, int64_t length, int nnodes, const int64_t* bufs, int nbufs
+) {
+    size_t pos[3];
+    size_t t = table(b, 3, (int[]){8, 4, 4}, pos);
+    put(b, pos[0], &length, sizeof length);
+    size_t v = vector(b, NULL, nnodes, 16);
+    for (int i = 0; i < nnodes; i++)
+        put(b, v + 4 + 16*i, &length, sizeof length);
+    setref(b, pos[1], v);
+    setref(b, pos[2], vector(b, bufs, nbufs, 16));
+    return t;
+}
+
+static void footer(Builder* b, const Block* blocks, ptrdiff_t nblocks)
+{
+    reset(b);
+    size_t pos[4];
+    setref(b, 0, table(b, 4, (int[]){2, 4, 4, 4}, pos));
+    int16_t version = METADATA_V5;
+    put(b, pos[0], &version, sizeof version);
+    setref(b, pos[1], schema(b));
+    // the first block is the dictionary batch
+    setref(b, pos[2], vector(b, blocks, 1, sizeof *blocks));
+    setref(b, pos[3], vector(b, blocks + 1, nblocks - 1, sizeof *blocks));
+}
+
+
+// <3> Writing
+//
+// The file starts with a magic string, followed by the schema, the
+// category dictionary and the record batches, each an encapsulated
+// message: a continuation marker, the metadata length, the metadata, and
+// then the body of column buffers. The footer repeats the schema and
+// locates every message.
+
+#define MAGIC "ARROW1"
+#define CONTINUATION UINT32_C(0xffffffff)
+
+/* Round N up to a multiple of 8. */
+#define PAD(n) (((n) + 7) & ~(int64_t)7)
+
+typedef struct {
+    OutBuf ob;
+    int64_t pos;        // chars written so far
+    Builder b;
+} Writer;
+
+static void emit(Writer* w, const void* s, size_t len)
+{
+    ob_write(&w->ob, s, len);
+    w->pos += len;
+}
+
+static void writepad(Writer* w)
+{
+    static const char zeros[8] = {0};
+    emit(w, zeros, PAD(w->pos) - w->pos);
+}
+
+/* Write the message built in W's builder, followed by nothing yet of its
+body. Store its location in BLOCK. */
+static void writemessage(Writer* w, Block* block, int64_t bodylen)
+{
+    uint32_t prefix[2] = {CONTINUATION, PAD(w->b.len)};
+    block->offset = w->pos;
+    block->metalen = sizeof prefix + prefix[1];
+    block->pad = 0;
+    block->bodylen = bodylen;
+    emit(w, prefix, sizeof prefix);
+    emit(w, w->b.buf, w->b.len);
+    writepad(w);
+}
+
+/* Lay out buffers of the given LENS one after another, storing offset and
+length pairs in BUFS. Return the body length. */
+static int64_t layout(const int64_t* lens, int n, int64_t* bufs)
+{
+    int64_t off = 0;
+    for (int i = 0; i < n; i++) {
+        bufs[2*i] = off;
+        bufs[2*i + 1] = lens[i];
+        off += PAD(lens[i]);
+    }
+    return off;
+}
+
+/* Write the category dictionary, whose categories are HT's keys in id
+order. */
+static void writedict(Writer* w, HashTable* ht, Block* block)
+{
+    int32_t ncats = ht_count(ht);
+    int64_t datalen = 0;
+    const void* key;
+    ht_foreach(ht, key, NULL)
+        datalen += strlen(key);
+    int64_t lens[3] = {0, 4 * ((int64_t)ncats + 1), datalen};
+    int64_t bufs[2*3];
+    int64_t bodylen = layout(lens, 3, bufs);
+
+    size_t header = message(&w->b, HEADER_DICTIONARYBATCH, bodylen);
+    size_t pos[3];
+    setref(&w->b, header, table(&w->b, 3, (int[]){8, 4, 1}, pos));
+    int64_t id = CATDICT;
+    put(&w->b, pos[0], &id, sizeof id);
+    setref(&w->b, pos[1], recordbatch(&w->b, ncats, 1, bufs, 3));
+    writemessage(w, block, bodylen);
+
+    int32_t off = 0;
+    emit(w, &off, sizeof off);
+    ht_foreach(ht, key, NULL) {
+        off += strlen(key);
+        emit(w, &off, sizeof off);
+    }
+    writepad(w);
+    ht_foreach(ht, key, NULL)
+        emit(w, key, strlen(key));
+    writepad(w);
+}
+
+/* Write the COUNT records at RECS, selected by SEL as for ra_write, as a
+record batch. */
+static void writebatch(
+    Writer* w, HashTable* ht, const Record* recs, const ptrdiff_t* sel,
+    ptrdiff_t count, Block* block
+) {
+    #define REC(i) (sel ? recs + sel[i] : recs + (i))
+
+    int64_t desclen = 0;
+    for (ptrdiff_t i = 0; i < count; i++)
+        desclen += strlen(REC(i)->desc);
+    int64_t lens[NBUFS] = {
+        0, 4*count,
+        0, 8*count,
+        0, 4*count,
+        0, 4*(count + 1), desclen,
+    };
+    int64_t bufs[2*NBUFS];
+    int64_t bodylen = layout(lens, NBUFS, bufs);
+
+    size_t header = message(&w->b, HEADER_RECORDBATCH, bodylen);
+    setref(&w->b, header, recordbatch(&w->b, count, NCOLS, bufs, NBUFS));
+    writemessage(w, block, bodylen);
+
+    // one column at a time
+    for (ptrdiff_t i = 0; i < count; i++) {
+        int32_t days = dt_epochd(REC(i)->dt);
+        emit(w, &days, sizeof days);
+    }
+    writepad(w);
+    for (ptrdiff_t i = 0; i < count; i++)
+        emit(w, &REC(i)->amt, sizeof REC(i)->amt);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        int32_t id = *ht_get(ht, REC(i)->cat);
+        emit(w, &id, sizeof id);
+    }
+    writepad(w);
+    int32_t off = 0;
+    emit(w, &off, sizeof off);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        off += strlen(REC(i)->desc);
+        emit(w, &off, sizeof off);
+    }
+    writepad(w);
+    for (ptrdiff_t i = 0; i < count; i++)
+        emit(w, REC(i)->desc, strlen(REC(i)->desc));
+    writepad(w);
+
+    #undef REC
+}
+
+struct RaFile {
+    Writer w;
+    HashTable* ht;      // category ids
+    Block* blocks;      // the dictionary's, then each record batch's
+    ptrdiff_t nblocks;
+    ptrdiff_t cap;
+    bool nomem;
+};
+
+RaFile* ra_open(FILE* f, HashTable* cats)
+{
+    RaFile* ra = malloc(sizeof(*ra));
+    if (ra == NULL)
+        return NULL;
+    *ra = (RaFile){.w = {.pos = 0}, .ht = cats, .nblocks = 1, .cap = 16};
+    ra->blocks = malloc(ra->cap * sizeof(*ra->blocks));
+    if (ra->blocks == NULL || !ob_open(&ra->w.ob, f, OB_DEFAULTCAP)) {
+        free(ra->blocks);
+        free(ra);
+        return NULL;
+    }
+
+    emit(&ra->w, MAGIC "\0", PAD(sizeof MAGIC - 1));
+    Block schemablock;
+    setref(&ra->w.b, message(&ra->w.b, HEADER_SCHEMA, 0), schema(&ra->w.b));
+    writemessage(&ra->w, &schemablock, 0);
+    writedict(&ra->w, cats, ra->blocks);
+    return ra;
+}
+
+/* Write the COUNT records at RECS, selected by SEL as for ra_write, as one
+record batch. */
+static void appendbatch(RaFile* ra, const Record* recs, const ptrdiff_t* sel, ptrdiff_t count)
+{
+    if (ra->nblocks == ra->cap) {
+        Block* new = realloc(ra->blocks, 2 * ra->cap * sizeof(*new));
+        if (new == NULL) {
+            ra->nomem = true;
+            return;
+        }
+        ra->blocks = new;
+        ra->cap *= 2;
+    }
+    writebatch(&ra->w, ra->ht, recs, sel, count, ra->blocks + ra->nblocks++);
+}
+
+void ra_append(RaFile* ra, const Record* recs, ptrdiff_t count)
+{
+    appendbatch(ra, recs, NULL, count);
+}
+
+bool ra_close(RaFile* ra)
+{
+    // end of stream marker, then the footer, its length, and the magic
+    Writer* w = &ra->w;
+    uint32_t eos[2] = {CONTINUATION, 0};
+    emit(w, eos, sizeof eos);
+    footer(&w->b, ra->blocks, ra->nblocks);
+    int32_t footerlen = w->b.len;
+    emit(w, w->b.buf, w->b.len);
+    emit(w, &footerlen, sizeof footerlen);
+    emit(w, MAGIC, sizeof MAGIC - 1);
+
+    bool ok = !w->b.err && !ra->nomem;
+    free(w->b.buf);
+    free(ra->blocks);
+    ok = ob_close(&w->ob) && ok;
+    free(ra);
+    return ok;
+}
+
+bool ra_write(FILE* f, const Record* recs, const ptrdiff_t* sel, ptrdiff_t count)
+{
+    // intern categories; ids are assigned in order of first appearance
+    HashTable* ht = ht_new(HT_STR);
+    if (ht == NULL)
+        return false;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        const char* cat = (sel ? recs + sel[i] : recs + i)->cat;
+        if (NULL == ht_insert(ht, cat, ht_count(ht)) || ht_count(ht) > INT32_MAX / REC_CATLEN) {
+            ht_free(ht);
+            return false;
+        }
+    }
+
+    RaFile* ra = ra_open(f, ht);
+    if (ra == NULL) {
+        ht_free(ht);
+        return false;
+    }
+    for (ptrdiff_t start = 0; start < count; start += RA_BATCHLEN) {
+        ptrdiff_t len = (count - start < RA_BATCHLEN) ? count - start : RA_BATCHLEN;
+        appendbatch(ra, sel ? recs : recs + start, sel ? sel + start : NULL, len);
+    }
+    bool ok = ra_close(ra);
+    ht_free(ht);
+    return ok;
+}
@@ -0,0 +1,306 @@
+// <1> Layout
+// <2> Writing
+// <3> Reading
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "outbuf.h"
+#include "record.h"
+#include "recordbin.h"
+
+
+// <1> Layout
+//
+// An image consists of a header followed by sections, each starting at a
+// multiple of 8 bytes from the beginning:
+//      amts        int64[count]
+//      dts         int32[count]
+//      ids         uint16[count] or uint32[count], per the header's idsize
+//      cats        char[ncats][REC_CATLEN + 1], NUL-padded
+//      descoffs    int64[count + 1], offsets into descs
+//      descs       char[descslen], descriptions without NULs
+//
+// The header consists of MAGIC, a uint32 BOM, a uint32 idsize, then the
+// int64s count, ncats and descslen.
+
+#define MAGIC "lgrbin1\n"
+#define BOM UINT32_C(0x01020304)
+#define HEADERLEN (sizeof MAGIC - 1 + 2*4 + 3*8)
+#define CATSLOT (REC_CATLEN + 1)
+
+/* Round N up to a multiple of 8. */
+#define PAD(n) (((n) + 7) & ~(size_t)7)
+
+/* Section offsets for an image. */
+typedef struct {
+    size_t amts, dts, ids, cats, descoffs, descs, end;
+} Layout;
+
+/* Compute the section offsets of an image. Return false if the image
+would not fit in LIMIT chars; the counts are checked before multiplying so
+nothing can overflow. */
+static bool layout(
+    Layout* lo, uint32_t idsize, int64_t count, int64_t ncats, int64_t descslen,
+    size_t limit
+) {
+    if (
+        count < 0 || ncats < 0 || descslen < 0
+        || (uint64_t)count > limit / 8
+        || (uint64_t)ncats > limit / CATSLOT
+        || (uint64_t)descslen > limit
+    ) return false;
+    lo->amts = PAD(HEADERLEN);
+    lo->dts = lo->amts + count * 8;
+    lo->ids = lo->dts + PAD(count * 4);
+    lo->cats = lo->ids + PAD(count * idsize);
+    lo->descoffs = lo->cats + ncats * CATSLOT;
+    lo->descs = lo->descoffs + (count + 1) * 8;
+    lo->end = lo->descs + descslen;
+    return lo->end <= limit;
+}
+
+
+// <2> Writing
+
+/* Write LEN zeros, where LEN is less than 8. */
+static void writepad(OutBuf* ob, size_t len)
+{
+    static const char zeros[8] = {0};
+    ob_write(ob, zeros, len);
+}
+
+bool rb_write(
+    FILE* f, const RecordColumns* blocks, const ptrdiff_t* counts, ptrdiff_t nblocks
+) {
+    // renumber the categories used in order of first appearance; IDS maps
+    // the columns' ids to the image's, and ORDER the other way
+    int32_t ndict = nblocks ? blocks->cats->count : 0;
+    int32_t* ids = malloc((ndict + 1) * sizeof(*ids));
+    int32_t* order = malloc((ndict + 1) * sizeof(*order));
+    if (ids == NULL || order == NULL) {
+        free(ids);
+        free(order);
+        return false;
+    }
+    for (int32_t i = 0; i < ndict; i++)
+        ids[i] = -1;
+    int64_t count = 0, ncats = 0, descslen = 0;
+    for (ptrdiff_t b = 0; b < nblocks; b++) {
+        const RecordColumns* cols = blocks + b;
+        for (ptrdiff_t i = 0; i < counts[b]; i++) {
+            if (ids[cols->cat[i]] < 0) {
+                order[ncats] = cols->cat[i];
+                ids[cols->cat[i]] = ncats++;
+            }
+            descslen += cols->desclen[i];
+        }
+        count += counts[b];
+    }
+    uint32_t idsize = (ncats <= UINT16_MAX + 1) ? 2 : 4;
+
+    OutBuf ob;
+    if (!ob_open(&ob, f, OB_DEFAULTCAP)) {
+        free(ids);
+        free(order);
+        return false;
+    }
+
+    // header
+    uint32_t bom = BOM;
+    int64_t header[] = {count, ncats, descslen};
+    ob_write(&ob, MAGIC, sizeof MAGIC - 1);
+    ob_write(&ob, (const char*)&bom, sizeof bom);
+    ob_write(&ob, (const char*)&idsize, sizeof idsize);
+    ob_write(&ob, (const char*)header, sizeof header);
+    writepad(&ob, PAD(HEADERLEN) - HEADERLEN);
+
+    // columns, a block at a time
+    for (ptrdiff_t b = 0; b < nblocks; b++)
+        ob_write(&ob, (const char*)blocks[b].amt, counts[b] * 8);
+    for (ptrdiff_t b = 0; b < nblocks; b++)
+        ob_write(&ob, (const char*)blocks[b].dt, counts[b] * 4);
+    writepad(&ob, PAD(count * 4) - count * 4);
+    for (ptrdiff_t b = 0; b < nblocks; b++) {
+        for (ptrdiff_t i = 0; i < counts[b]; i++) {
+            int32_t id = ids[blocks[b].cat[i]];
+            uint16_t id16 = id;
+            uint32_t id32 = id;
+            ob_write(&ob, (idsize == 2) ? (const char*)&id16 : (const char*)&id32, idsize);
+        }
+    }
+    writepad(&ob, PAD(count * idsize) - count * idsize);
+
+    // category table, in id order; names are already NUL-padded
+    for (int64_t i = 0; i < ncats; i++)
+        ob_write(&ob, blocks->cats->names[order[i]], CATSLOT);
+
+    // description offsets and heap
+    int64_t off = 0;
+    ob_write(&ob, (const char*)&off, 8);
+    for (ptrdiff_t b = 0; b < nblocks; b++) {
+        for (ptrdiff_t i = 0; i < counts[b]; i++) {
+            off += blocks[b].desclen[i];
+            ob_write(&ob, (const char*)&off, 8);
+        }
+    }
+    for (ptrdiff_t b = 0; b < nblocks; b++) {
+        const RecordColumns* cols = blocks + b;
+        for (ptrdiff_t i = 0; i < counts[b]; i++)
+            ob_write(&ob, cols->descs->chars + cols->descoff[i], cols->desclen[i]);
+    }
+
+    free(ids);
+    free(order);
+    return ob_close(&ob);
+}
+
+
+// <3> Reading
+//
+// Images may be mapped at any address, so integers are read with memcpy.
+
+static int64_t geti64(const char* p)
+{
+    int64_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+static uint32_t getu32(const char* p)
+{
+    uint32_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+/* Parse and validate the header and category table of the image of LEN
+chars at S. Return false if S is not a valid image. */
+static bool readheader(
+    const char* s, size_t len, Layout* lo, uint32_t* idsize,
+    int64_t* count, int64_t* ncats
+) {
+    if (len < HEADERLEN || memcmp(s, MAGIC, sizeof MAGIC - 1) != 0)
+        return false;
+    const char* p = s + sizeof MAGIC - 1;
+    *idsize = getu32(p + 4);
+    *count = geti64(p + 8);
+    *ncats = geti64(p + 16);
+    int64_t descslen = geti64(p + 24);
+    if (
+        getu32(p) != BOM
+        || (*idsize != 2 && *idsize != 4)
+        || !layout(lo, *idsize, *count, *ncats, descslen, len)
+        || lo->end != len
+    ) return false;
+
+    // each category must be usable as a record's category
+    for (int64_t i = 0; i < *ncats; i++) {
+        const char* cat = s + lo->cats + i * CATSLOT;
+        const char* nul = memchr(cat, '\0', CATSLOT);
+        size_t catlen = nul ? (size_t)(nul - cat) : 0;
+        if (catlen == 0)
+            return false;
+        for (size_t j = 0; j < catlen; j++)
+            if (cat[j] == *REC_DELIM || cat[j] == '\n' || isupper((unsigned char)cat[j]))
+                return false;
+    }
+
+    // description offsets must start at 0 and end at the heap's end
+    return geti64(s + lo->descoffs) == 0
+        && geti64(s + lo->descoffs + *count * 8) == descslen;
+}
+
+ptrdiff_t rb_count(const char* s, size_t len)
+{
+    Layout lo;
+    uint32_t idsize;
+    int64_t count, ncats;
+    if (!readheader(s, len, &lo, &idsize, &count, &ncats) || count > PTRDIFF_MAX)
+        return -1;
+    return count;
+}
+
+ptrdiff_t rb_decode(
+    const char* s, size_t len,
+    const RecordColumns* blocks, const ptrdiff_t* counts, ptrdiff_t nblocks
+) {
+    Layout lo;
+    uint32_t idsize;
+    int64_t count, ncats;
+    if (!readheader(s, len, &lo, &idsize, &count, &ncats))
+        return 1;
+    if (count == 0)
+        return 0;
+
+    // the image's categories are interned first, so IDS maps its ids to
+    // the dictionary's, and its description heap is appended to the arena
+    // whole, to be taken back if any record is invalid
+    RecordCats* cats = blocks->cats;
+    RecordDescs* descs = blocks->descs;
+    int32_t* ids = malloc((ncats + 1) * sizeof(*ids));
+    if (ids == NULL)
+        return -1;
+    for (int64_t i = 0; i < ncats; i++) {
+        if ((ids[i] = rec_intern(cats, s + lo.cats + i * CATSLOT)) < 0) {
+            free(ids);
+            return -1;
+        }
+    }
+    int64_t descbase = rec_putdescs(descs, s + lo.descs, len - lo.descs);
+    if (descbase < 0) {
+        free(ids);
+        return -1;
+    }
+
+    // fixed-width columns are copied a block at a time, then checked
+    int64_t descstart = 0;
+    int32_t prevdt = 0;
+    for (ptrdiff_t b = 0, i = 0; b < nblocks; b++) {
+        const RecordColumns* out = blocks + b;
+        memcpy(out->amt, s + lo.amts + i * 8, counts[b] * 8);
+        memcpy(out->dt, s + lo.dts + i * 4, counts[b] * 4);
+        for (ptrdiff_t j = 0; j < counts[b]; j++, i++) {
+            int64_t amt = out->amt[j];
+            int32_t dt = out->dt[j];
+            uint32_t id;
+            if (idsize == 2) {
+                uint16_t id16;
+                memcpy(&id16, s + lo.ids + i * 2, 2);
+                id = id16;
+            } else {
+                id = getu32(s + lo.ids + i * 4);
+            }
+            int64_t descstop = geti64(s + lo.descoffs + (i + 1) * 8);
+            int64_t desclen = descstop - descstart;
+
+            if (
+                !amt || amt > REC_AMT_MAX || amt < REC_AMT_MIN
+                || !dt_isdt(dt)
+                || dt < prevdt
+                || id >= ncats
+                || desclen < 0 || desclen > REC_DESCLEN
+                || descstop > (int64_t)(len - lo.descs)
+                || memchr(s + lo.descs + descstart, '\n', desclen)
+                || memchr(s + lo.descs + descstart, '\0', desclen)
+            ) {
+                descs->len = descbase;
+                free(ids);
+                return i + 1;
+            }
+            out->cat[j] = ids[id];
+            out->descoff[j] = descbase + descstart;
+            out->desclen[j] = desclen;
+            descstart = descstop;
+            prevdt = dt;
+        }
+    }
+    free(ids);
+    return 0;
+}
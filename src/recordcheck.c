@@ -0,0 +1,429 @@
+// <1> Partitioning
+// <2> Checking Blocks
+// <3> Merging
+// <4> IO
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "date.h"
+#include "scan.h"
+#include "crc.h"
+#include "record.h"
+#include "recordcheck.h"
+
+/* Leading chars of a line identifying its month ("yyyy-mm"). */
+#define MONTHLEN 7
+
+/* Maximum number of lines in a new block. Months with more lines are split,
+so a single large month can still be checked on several threads. */
+#define BLOCKLINES (1 << 16)
+
+/* Lines scanned per batch. */
+#define SCAN_BATCH 256
+
+/* Minimum number of chars to check per thread. */
+#define MINCHUNK (1 << 20)
+
+/* First 8 bytes of saved blocks. */
+#define MAGIC "lgrchk1\n"
+
+/* A block of the list being checked. */
+typedef struct {
+    size_t start;           // offset of first char
+    size_t stop;            // offset past last char
+    int64_t line;           // number of lines before the block
+    int64_t lines;          // number of lines in the block
+    const RcBlock* known;   // matching block of an earlier check, if any
+
+    // set by checking a block that is not known
+    bool valid;             // whether every line is valid and sorted
+    int64_t first;          // line number of the first valid line
+    int32_t dt0, dt1;       // dates of the first and last valid lines, or 0
+    uint32_t crc;           // checksum, if valid
+} Block;
+
+/* A growable array of issues. */
+typedef struct {
+    RcIssue* arr;
+    ptrdiff_t count;
+    ptrdiff_t cap;
+    bool nomem;
+} IssueList;
+
+/* Append an issue, or set LIST->nomem if there is insufficient memory. */
+static void push(IssueList* list, int64_t line, int kind)
+{
+    if (list->count == list->cap) {
+        ptrdiff_t newcap = list->cap ? list->cap * 2 : 64;
+        RcIssue* new = realloc(list->arr, newcap * sizeof(*new));
+        if (new == NULL) {
+            list->nomem = true;
+            return;
+        }
+        list->arr = new;
+        list->cap = newcap;
+    }
+    list->arr[list->count++] = (RcIssue){.line = line, .kind = kind};
+}
+
+
+// <1> Partitioning
+//
+// The list is split into blocks in a single pass. Where a block of an
+// earlier check matches the chars at the current position, it is skipped
+// over by its length without scanning its lines.
+
+/* Whether KNOWN matches the chars of S from POS onward. */
+static bool matches(const char* s, size_t len, size_t pos, const RcBlock* known)
+{
+    return known->len > 0
+        && (uint64_t)known->len <= len - pos
+        && s[pos + known->len - 1] == '\n'
+        && crc_32c(0, s + pos, known->len) == known->crc;
+}
+
+/* Find the end of the run of lines starting at POS that share the first
+line's month, up to BLOCKLINES lines. Store the offset past the run in
+STOP and its number of lines in LINES. */
+static void run(const char* s, size_t len, size_t pos, size_t* stop, int64_t* lines)
+{
+    const char* first = s + pos;
+    bool dated = len - pos >= MONTHLEN;
+    ScanLine batch[SCAN_BATCH];
+    *lines = 0;
+    for (ptrdiff_t n; (n = scan_lines(s, len, &pos, *REC_DELIM, batch, SCAN_BATCH));) {
+        for (const ScanLine* line = batch; line < batch + n; line++) {
+            bool same = dated && line->len >= MONTHLEN
+                && memcmp(s + line->start, first, MONTHLEN) == 0;
+            if (*lines && (!same || *lines == BLOCKLINES)) {
+                *stop = line->start;
+                return;
+            }
+            (*lines)++;
+        }
+    }
+    *stop = len;
+}
+
+/* Split the LEN chars at S into blocks, stored in an allocated array at
+*BLOCKS with their number in *COUNT. Return false if there is insufficient
+memory. */
+static bool partition(
+    const char* s, size_t len, const RcBlock* known, ptrdiff_t nknown,
+    Block** blocks, ptrdiff_t* count
+) {
+    ptrdiff_t cap = 64;
+    *count = 0;
+    *blocks = malloc(cap * sizeof(**blocks));
+    if (*blocks == NULL)
+        return false;
+
+    ptrdiff_t j = 0;
+    int64_t line = 0;
+    for (size_t pos = 0; pos < len;) {
+        // known blocks are in file order, so the cursor only moves forward
+        const RcBlock* match = NULL;
+        if (len - pos >= DT_ISOLEN && dt_isisoprefix(s + pos)) {
+            int32_t month = dt_fromiso(s + pos) / 100;
+            while (j < nknown && known[j].dt0 / 100 < month)
+                j++;
+            for (ptrdiff_t k = j; !match && k < nknown && known[k].dt0 / 100 == month; k++) {
+                if (matches(s, len, pos, known + k)) {
+                    match = known + k;
+                    j = k + 1;
+                }
+            }
+        }
+
+        Block b = {.start = pos, .line = line, .known = match};
+        if (match) {
+            b.stop = pos + match->len;
+            b.lines = match->lines;
+        } else {
+            run(s, len, pos, &b.stop, &b.lines);
+        }
+        if (*count == cap) {
+            Block* new = realloc(*blocks, 2 * cap * sizeof(*new));
+            if (new == NULL) {
+                free(*blocks);
+                return false;
+            }
+            *blocks = new;
+            cap *= 2;
+        }
+        (*blocks)[(*count)++] = b;
+        pos = b.stop;
+        line += b.lines;
+    }
+    return true;
+}
+
+
+// <2> Checking Blocks
+
+/* Deserialize every line of B, which is not known, adding its issues to
+LIST. Lines are only compared with earlier lines of B. */
+static void checkblock(const char* s, Block* b, IssueList* list)
+{
+    b->valid = true;
+    b->dt0 = b->dt1 = 0;
+    ScanLine batch[SCAN_BATCH];
+    size_t pos = b->start;
+    int64_t lineno = b->line;
+    for (ptrdiff_t n; (n = scan_lines(s, b->stop, &pos, *REC_DELIM, batch, SCAN_BATCH));) {
+        for (const ScanLine* line = batch; line < batch + n; line++) {
+            lineno++;
+            Record rec;
+            if (
+                line->len > REC_STRLEN
+                || line->ndelims < REC_NDELIMS
+                || NULL == rec_fromfields(&rec, s + line->start, line->len, line->delims)
+            ) {
+                push(list, lineno, rec_diagnose(s + line->start, line->len));
+                b->valid = false;
+                continue;
+            }
+            if (b->dt0 == 0) {
+                b->dt0 = rec.dt;
+                b->first = lineno;
+            } else if (rec.dt < b->dt1) {
+                push(list, lineno, RC_UNSORTED);
+                b->valid = false;
+            }
+            b->dt1 = rec.dt;
+        }
+    }
+    if (b->valid)
+        b->crc = crc_32c(0, s + b->start, b->stop - b->start);
+}
+
+/* Shared state for checking blocks on multiple threads. Thread I checks
+the blocks from BOUNDS[I] up to BOUNDS[I+1]. */
+typedef struct {
+    const char* s;
+    Block* blocks;
+    ptrdiff_t* bounds;
+    IssueList* lists;
+} CheckJob;
+
+static void checkjob(void* arg, int i)
+{
+    CheckJob* job = arg;
+    for (ptrdiff_t k = job->bounds[i]; k < job->bounds[i+1]; k++)
+        if (job->blocks[k].known == NULL)
+            checkblock(job->s, job->blocks + k, job->lists + i);
+}
+
+
+// <3> Merging
+
+static int cmpissue(const void* a, const void* b)
+{
+    int64_t x = ((const RcIssue*)a)->line, y = ((const RcIssue*)b)->line;
+    return (x > y) - (x < y);
+}
+
+/* Check BLOCKS on up to THREADS threads, storing their issues in LIST.
+Return false if there is insufficient memory. */
+static bool checkall(
+    const char* s, Block* blocks, ptrdiff_t count, int threads, IssueList* list
+) {
+    // split the unknown chars evenly between threads, keeping each
+    // thread's blocks contiguous so their issues stay in order
+    size_t total = 0;
+    for (ptrdiff_t k = 0; k < count; k++)
+        if (blocks[k].known == NULL)
+            total += blocks[k].stop - blocks[k].start;
+    int nthreads = util_max(1, util_min(
+        threads > 0 ? threads : util_ncpus(),
+        total / MINCHUNK
+    ));
+    ptrdiff_t* bounds = malloc((nthreads + 1) * sizeof(*bounds));
+    IssueList* lists = calloc(nthreads, sizeof(*lists));
+    if (bounds == NULL || lists == NULL) {
+        free(bounds);
+        free(lists);
+        return false;
+    }
+    bounds[0] = 0;
+    size_t sum = 0;
+    ptrdiff_t k = 0;
+    for (int i = 1; i < nthreads; i++) {
+        for (; k < count && sum < total / nthreads * i; k++)
+            if (blocks[k].known == NULL)
+                sum += blocks[k].stop - blocks[k].start;
+        bounds[i] = k;
+    }
+    bounds[nthreads] = count;
+
+    CheckJob job = {.s = s, .blocks = blocks, .bounds = bounds, .lists = lists};
+    util_parallel(nthreads, checkjob, &job);
+
+    // concatenate in thread order
+    bool status = true;
+    for (int i = 0; i < nthreads; i++) {
+        status = status && !lists[i].nomem;
+        for (ptrdiff_t j = 0; status && j < lists[i].count; j++) {
+            push(list, lists[i].arr[j].line, lists[i].arr[j].kind);
+            status = !list->nomem;
+        }
+        free(lists[i].arr);
+    }
+    free(lists);
+    free(bounds);
+    return status;
+}
+
+bool rc_check(
+    const char* s, size_t len, const RcBlock* known, ptrdiff_t nknown,
+    int threads, RcResult* res
+) {
+    *res = (RcResult){0};
+    Block* blocks;
+    ptrdiff_t count;
+    if (!partition(s, len, known, nknown, &blocks, &count))
+        return false;
+    IssueList list = {0};
+    res->blocks = malloc((count ? count : 1) * sizeof(*res->blocks));
+    if (res->blocks == NULL || !checkall(s, blocks, count, threads, &list)) {
+        free(list.arr);
+        free(blocks);
+        rc_free(res);
+        return false;
+    }
+
+    // compare each block's first valid line with the last valid line
+    // before it, and keep the valid blocks
+    int32_t prev = 0;
+    for (ptrdiff_t k = 0; k < count; k++) {
+        Block* b = blocks + k;
+        res->lines += b->lines;
+        if (b->known) {
+            b->dt0 = b->known->dt0;
+            b->dt1 = b->known->dt1;
+            b->first = b->line + 1;
+            b->crc = b->known->crc;
+            b->valid = true;
+        } else {
+            res->parsed += b->lines;
+        }
+        if (b->dt0) {
+            if (b->dt0 < prev)
+                push(&list, b->first, RC_UNSORTED);
+            prev = b->dt1;
+        }
+        if (b->valid && s[b->stop - 1] == '\n') {
+            res->blocks[res->nblocks++] = (RcBlock){
+                .dt0 = b->dt0, .dt1 = b->dt1, .crc = b->crc,
+                .len = b->stop - b->start, .lines = b->lines,
+            };
+        }
+    }
+    free(blocks);
+    if (list.nomem) {
+        free(list.arr);
+        rc_free(res);
+        return false;
+    }
+    qsort(list.arr, list.count, sizeof(*list.arr), cmpissue);
+    res->issues = list.arr;
+    res->nissues = list.count;
+    return true;
+}
+
+void rc_free(RcResult* res)
+{
+    free(res->issues);
+    free(res->blocks);
+    *res = (RcResult){0};
+}
+
+
+// <4> IO
+//
+// Saved blocks are MAGIC followed by the block count as an int64, then each
+// block's dates, checksum, length and line count as int64s. All integers
+// are in native byte order; saved blocks are never moved between machines.
+
+static bool writei(int64_t n, FILE* f)
+{
+    return fwrite(&n, sizeof n, 1, f) == 1;
+}
+
+static bool readi(int64_t* n, FILE* f)
+{
+    return fread(n, sizeof *n, 1, f) == 1;
+}
+
+bool rc_write(const RcBlock* blocks, ptrdiff_t count, FILE* f)
+{
+    bool status = fwrite(MAGIC, 1, sizeof MAGIC - 1, f) == sizeof MAGIC - 1
+        && writei(count, f);
+    for (ptrdiff_t i = 0; status && i < count; i++) {
+        const RcBlock* b = blocks + i;
+        status = writei(b->dt0, f)
+            && writei(b->dt1, f)
+            && writei(b->crc, f)
+            && writei(b->len, f)
+            && writei(b->lines, f);
+    }
+    return status;
+}
+
+bool rc_read(RcBlock** blocks, ptrdiff_t* count, FILE* f)
+{
+    *blocks = NULL;
+    *count = 0;
+
+    char magic[sizeof MAGIC - 1];
+    int64_t n;
+    if (
+        fread(magic, 1, sizeof magic, f) != sizeof magic
+        || memcmp(magic, MAGIC, sizeof magic) != 0
+        || !readi(&n, f)
+        || n < 0
+        || (uint64_t)n > PTRDIFF_MAX / sizeof(**blocks)
+    ) return false;
+
+    // grow as blocks are read, so a bad count cannot force a huge
+    // allocation
+    ptrdiff_t cap = 0;
+    for (; *count < n; (*count)++) {
+        if (*count == cap) {
+            cap = cap ? util_min(2 * cap, n) : util_min(64, n);
+            RcBlock* new = realloc(*blocks, cap * sizeof(*new));
+            if (new == NULL)
+                goto fail;
+            *blocks = new;
+        }
+        int64_t dt0, dt1, crc;
+        RcBlock* b = *blocks + *count;
+        if (
+            !readi(&dt0, f) || !readi(&dt1, f) || !readi(&crc, f)
+            || !readi(&b->len, f) || !readi(&b->lines, f)
+            || dt0 < 0 || dt0 > INT32_MAX || !dt_isdt(dt0)
+            || dt1 < dt0 || dt1 > INT32_MAX || !dt_isdt(dt1)
+            || crc < 0 || crc > UINT32_MAX
+            || b->lines <= 0 || b->len < b->lines
+        ) goto fail;
+        b->dt0 = dt0;
+        b->dt1 = dt1;
+        b->crc = crc;
+    }
+
+    // trailing data means the file does not hold saved blocks
+    if (getc(f) == EOF)
+        return true;
+
+fail:
+    free(*blocks);
+    *blocks = NULL;
+    *count = 0;
+    return false;
+}
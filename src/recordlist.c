@@ -1,7 +1,8 @@
-// <1> Getters
-// <2> IO
-// <3> General
-// <4> Slicing
+// <1> Blocks
+// <2> Getters
+// <3> IO
+// <4> General
+// <5> Slicing
 
 #include <ctype.h>
 #include <stdbool.h>
@@ -12,128 +13,846 @@
 #include <string.h>
 
 #include "util.h"
+#include "date.h"
+#include "outbuf.h"
 #include "record.h"
+#include "recordbin.h"
+#include "scan.h"
 #include "recordlist.h"
 
-/* The array of records. */
-static Record* st_records;
+/* Most records per block. A block's columns take about 50 KiB. */
+#define BLOCKCAP 2048
+
+/* Chars of a block's columns. */
+#define BLOCKSIZE (BLOCKCAP * ( \
+    sizeof(int64_t) + sizeof(int64_t) + sizeof(int32_t) + sizeof(int32_t) \
+    + sizeof(uint8_t) \
+))
+
+/* The records are stored in blocks of at most BLOCKCAP records, each with
+one array per field, so inserting or deleting a record only moves records
+of its own block. Block I holds COUNTS[I] records in BLOCKS[I], the first
+of which is record FIRSTS[I], and is never empty; FIRSTS[NBLOCKS] is the
+number of records. Every block uses the same categories and descriptions.
+Ids are never removed from the dictionary, even once no record uses them. */
+static RecordColumns* st_blocks;
+static ptrdiff_t* st_counts;
+static ptrdiff_t* st_firsts;
+static ptrdiff_t st_nblocks;
+static ptrdiff_t st_blockcap;
+static RecordCats st_cats;
+static RecordDescs st_descs;
+
+/* Block of the record last looked up, checked first since records are
+mostly visited in order. */
+static ptrdiff_t st_lastblock;
+
+/* Number of chars in the description arena no record refers to. */
+static int64_t st_descdead;
 
 /* Number of records. */
 static ptrdiff_t st_count;
 
+/* The first `clean` records are serialized in the file exactly as they
+were when loaded or last written. `offsets[i]` is the byte offset of
+record I in that file for I <= `clean`, so `offsets[clean]` is where the
+first changed record starts. The offsets array has room for `offsetcap +
+1` elements. */
+static int64_t* st_offsets;
+static ptrdiff_t st_offsetcap;
+static ptrdiff_t st_clean;
+
 /* The active slice is the range of indices I such that `slicestart` <= I <
 `slicestop`. If the active slice is empty, `slicestart` and `slicestop` are
 equal. */
 static ptrdiff_t st_slicestart;
 static ptrdiff_t st_slicestop;
 
+/* Filters select records of the active slice without deleting any. `sel`
+holds the list indices of the `selcount` selected records in ascending
+order, or is NULL if every active slice record is selected. The selection
+is reset to the whole active slice whenever the slice is set or the list
+is modified. */
+static ptrdiff_t* st_sel;
+static ptrdiff_t st_selcount;
+
+
+// <1> Blocks
+
+/* Allocate the columns of a block of BLOCKCAP records in COLS, in a single
+allocation. Return false if there is insufficient memory. */
+static bool allocblock(RecordColumns* cols)
+{
+    int64_t* p = malloc(BLOCKSIZE);
+    if (p == NULL)
+        return false;
+    cols->amt = p;
+    cols->descoff = p + BLOCKCAP;
+    cols->dt = (int32_t*)(cols->descoff + BLOCKCAP);
+    cols->cat = cols->dt + BLOCKCAP;
+    cols->desclen = (uint8_t*)(cols->cat + BLOCKCAP);
+    cols->cats = &st_cats;
+    cols->descs = &st_descs;
+    return true;
+}
+
+/* Recompute the first record of every block after block FROM. */
+static void renumber(ptrdiff_t from)
+{
+    if (st_nblocks == 0) {
+        st_count = 0;
+        return;
+    }
+    for (ptrdiff_t k = from; k < st_nblocks; k++)
+        st_firsts[k+1] = st_firsts[k] + st_counts[k];
+    st_count = st_firsts[st_nblocks];
+}
+
+/* Insert COUNT empty blocks before block AT. Return false if there is
+insufficient memory, in which case the blocks are unchanged. */
+static bool addblocks(ptrdiff_t at, ptrdiff_t count)
+{
+    if (st_nblocks + count > st_blockcap) {
+        ptrdiff_t cap = util_max(st_nblocks + count, st_blockcap * 2);
+        RecordColumns* blocks = realloc(st_blocks, cap * sizeof(*blocks));
+        if (blocks == NULL)
+            return false;
+        st_blocks = blocks;
+        ptrdiff_t* counts = realloc(st_counts, cap * sizeof(*counts));
+        if (counts == NULL)
+            return false;
+        st_counts = counts;
+        ptrdiff_t* firsts = realloc(st_firsts, (cap + 1) * sizeof(*firsts));
+        if (firsts == NULL)
+            return false;
+        st_firsts = firsts;
+        st_firsts[0] = 0;
+        st_blockcap = cap;
+    }
+
+    // allocate the new blocks after the last, then rotate them into place
+    for (ptrdiff_t i = 0; i < count; i++) {
+        if (!allocblock(st_blocks + st_nblocks + i)) {
+            while (i--)
+                free(st_blocks[st_nblocks + i].amt);
+            return false;
+        }
+    }
+    for (ptrdiff_t i = st_nblocks - 1; i >= at; i--) {
+        RecordColumns tmp = st_blocks[i + count];
+        st_blocks[i + count] = st_blocks[i];
+        st_blocks[i] = tmp;
+        st_counts[i + count] = st_counts[i];
+    }
+    for (ptrdiff_t i = at; i < at + count; i++)
+        st_counts[i] = 0;
+    st_nblocks += count;
+    renumber(at);
+    return true;
+}
+
+/* Free blocks AT to AT+COUNT-1 and remove them, along with any records
+they still hold. */
+static void removeblocks(ptrdiff_t at, ptrdiff_t count)
+{
+    for (ptrdiff_t i = at; i < at + count; i++)
+        free(st_blocks[i].amt);
+    ptrdiff_t after = st_nblocks - at - count;
+    memmove(st_blocks + at, st_blocks + at + count, after * sizeof(*st_blocks));
+    memmove(st_counts + at, st_counts + at + count, after * sizeof(*st_counts));
+    st_nblocks -= count;
+    renumber(at);
+}
+
+/* Move COUNT records from index SRC of block SRCBLOCK to index DST of
+block DSTBLOCK, which may overlap. */
+static void moverecs(
+    RecordColumns* dstblock, ptrdiff_t dst,
+    const RecordColumns* srcblock, ptrdiff_t src, ptrdiff_t count
+) {
+    #define MOVE(col) memmove( \
+        dstblock->col + dst, srcblock->col + src, count * sizeof(*dstblock->col) \
+    )
+    MOVE(dt);
+    MOVE(amt);
+    MOVE(cat);
+    MOVE(descoff);
+    MOVE(desclen);
+    #undef MOVE
+}
+
+/* Split block K in two, moving its upper half to a new block after it.
+Return false if there is insufficient memory. */
+static bool splitblock(ptrdiff_t k)
+{
+    if (!addblocks(k + 1, 1))
+        return false;
+    ptrdiff_t half = st_counts[k] / 2;
+    moverecs(st_blocks + k + 1, 0, st_blocks + k, half, st_counts[k] - half);
+    st_counts[k+1] = st_counts[k] - half;
+    st_counts[k] = half;
+    renumber(k);
+    return true;
+}
+
+/* Remove block K if it is empty, or merge it with a neighbour if both fit
+in half a block, so blocks never become sparse. */
+static void tidyblock(ptrdiff_t k)
+{
+    if (st_counts[k] == 0) {
+        removeblocks(k, 1);
+        return;
+    }
+    if (k > 0 && st_counts[k-1] + st_counts[k] <= BLOCKCAP / 2)
+        k--;
+    else if (k + 1 == st_nblocks || st_counts[k] + st_counts[k+1] > BLOCKCAP / 2)
+        return;
+    moverecs(st_blocks + k, st_counts[k], st_blocks + k + 1, 0, st_counts[k+1]);
+    st_counts[k] += st_counts[k+1];
+    st_counts[k+1] = 0;
+    removeblocks(k + 1, 1);
+    renumber(k);
+}
+
+/* Return the block holding record INDEX, which must be in bounds. */
+static ptrdiff_t findblock(ptrdiff_t index)
+{
+    ptrdiff_t k = st_lastblock;
+    if (k < st_nblocks && st_firsts[k] <= index && index < st_firsts[k+1])
+        return k;
 
-// <1> Getters
+    // the last block whose first record is at most INDEX
+    ptrdiff_t l = 0, r = st_nblocks - 1;
+    while (l < r) {
+        ptrdiff_t m = l + (r - l + 1) / 2;
+        if (st_firsts[m] <= index)
+            l = m;
+        else
+            r = m - 1;
+    }
+    st_lastblock = l;
+    return l;
+}
+
+
+// <2> Getters
 
 const Record* rl_get(ptrdiff_t index)
 {
-    return (index < 0 || index >= st_count)
-        ? NULL
-        : st_records + index;
+    static Record rec;
+    if (index < 0 || index >= st_count)
+        return NULL;
+    ptrdiff_t k = findblock(index);
+    return rec_fromcols(&rec, st_blocks + k, index - st_firsts[k]);
+}
+
+void rl_copy(ptrdiff_t start, ptrdiff_t stop, Record* out)
+{
+    for (ptrdiff_t i = start; i < stop;) {
+        ptrdiff_t k = findblock(i);
+        ptrdiff_t end = util_min(stop, st_firsts[k+1]);
+        for (; i < end; i++)
+            rec_fromcols(out++, st_blocks + k, i - st_firsts[k]);
+    }
 }
 
+RlSpan rl_span(ptrdiff_t start, ptrdiff_t stop)
+{
+    if (start >= stop)
+        return (RlSpan){0};
+    ptrdiff_t k = findblock(start);
+    const RecordColumns* cols = st_blocks + k;
+    ptrdiff_t pos = start - st_firsts[k];
+    return (RlSpan){
+        .dt = cols->dt + pos,
+        .amt = cols->amt + pos,
+        .cat = cols->cat + pos,
+        .descoff = cols->descoff + pos,
+        .desclen = cols->desclen + pos,
+        .descs = st_descs.chars,
+        .len = util_min(stop, st_firsts[k+1]) - start,
+    };
+}
+
+/* Select every active slice record. */
+static void resetsel(void)
+{
+    free(st_sel);
+    st_sel = NULL;
+    st_selcount = 0;
+}
+
+ptrdiff_t rl_selindex(ptrdiff_t pos)
+{
+    return st_sel ? st_sel[pos] : st_slicestart + pos;
+}
+
+RlSpan rl_selspan(ptrdiff_t start, ptrdiff_t stop)
+{
+    if (st_sel == NULL || start >= stop)
+        return rl_span(st_slicestart + start, st_slicestart + stop);
+
+    // the run of selected records that follow each other in the list, up
+    // to the end of the first one's block
+    ptrdiff_t index = st_sel[start];
+    ptrdiff_t k = findblock(index);
+    stop = util_min(stop, start + st_firsts[k+1] - index);
+    ptrdiff_t len = 1;
+    while (start + len < stop && st_sel[start + len] == index + len)
+        len++;
+    return rl_span(index, index + len);
+}
+
+int32_t rl_catcount(void) {return st_cats.count;}
+const char* rl_catname(int32_t id) {return st_cats.names[id];}
+
 ptrdiff_t rl_count(void) {return st_count;}
 ptrdiff_t rl_slicestart(void) {return st_slicestart;}
 ptrdiff_t rl_slicestop(void) {return st_slicestop;}
 ptrdiff_t rl_slicecount(void) {return st_slicestop - st_slicestart;}
+ptrdiff_t rl_selcount(void) {return st_sel ? st_selcount : rl_slicecount();}
 
 
-// <2> IO
+// <3> IO
 
-ptrdiff_t rl_init(FILE* f)
+/* Lines scanned per batch when loading. */
+#define SCAN_BATCH 256
+
+/* Minimum number of chars per loading thread. Smaller files are loaded by
+fewer threads, so tiny files never pay for thread creation. */
+#define MINCHUNK (1 << 20)
+
+/* Number of loading threads requested; nonpositive for one per CPU. */
+static int st_threads = 1;
+
+void rl_setthreads(int count)
 {
-    // count lines and check line widths
-    // too many lines means the first MAXLEN or more lines are nonempty
-    ptrdiff_t lines = 0;
-    if (f) {
-        ptrdiff_t line_index = 0;
-        int cur_linepos = 0;
-        fseek(f, 0, SEEK_SET);
-        for (int c; EOF != (c = getc(f));) {
-            if (c != '\n') {
-                if (REC_STRLEN == cur_linepos++)
-                    return line_index + 1;
-            } else {
-                cur_linepos = 0;
-                line_index++;
-                if (line_index > RL_MAXCOUNT) return PTRDIFF_MAX;
+    st_threads = count;
+}
+
+/* Deserialize the lines in the chars of S between offsets START and
+STOP, storing them from index FIRST onward of the full blocks at BLOCKS,
+with their categories and descriptions in CATS and DESCS, and their offsets
+in OFFSETS. Return 0 on success, -1 if there is insufficient memory, or the
+line number (relative to START) of the first line that cannot be
+deserialized. */
+static ptrdiff_t parsechunk(
+    const char* s, size_t start, size_t stop,
+    const RecordColumns* blocks, RecordCats* cats, RecordDescs* descs,
+    ptrdiff_t first, int64_t* offsets
+) {
+    ptrdiff_t k = first / BLOCKCAP;
+    ptrdiff_t pos = first % BLOCKCAP;
+    RecordColumns cols = {0};
+    ScanLine batch[SCAN_BATCH];
+    size_t at = start;
+    for (ptrdiff_t i = 0, n; (n = scan_lines(s, stop, &at, *REC_DELIM, batch, SCAN_BATCH));) {
+        for (const ScanLine* line = batch; line < batch + n; line++, i++) {
+            Record rec;
+            if (
+                line->len > REC_STRLEN
+                || line->ndelims < REC_NDELIMS
+                || NULL == rec_fromfields(&rec, s + line->start, line->len, line->delims)
+            ) return i + 1;
+            if (cols.dt == NULL || pos == BLOCKCAP) {
+                k += (pos == BLOCKCAP);
+                pos %= BLOCKCAP;
+                cols = blocks[k];
+                cols.cats = cats;
+                cols.descs = descs;
             }
+            if (!rec_tocols(&rec, &cols, pos++))
+                return -1;
+            offsets[i] = line->start;
         }
-        if (line_index < RL_MAXCOUNT)
-            lines = line_index + !!cur_linepos;
-        else if (cur_linepos == 0)
-            lines = line_index;
-        else
-            return PTRDIFF_MAX;
     }
+    return 0;
+}
 
-    Record* arr = malloc((lines + 1) * sizeof(*arr));
-    if (arr == NULL)
+/* A newline-aligned portion of the file being loaded. */
+typedef struct {
+    size_t start;       // offset of first char
+    size_t stop;        // offset past last char
+    ptrdiff_t first;    // index of first line in the whole file
+    ptrdiff_t status;   // parsechunk's return value
+    RecordCats* cats;   // the list's, or LOCALCATS and LOCALDESCS if there
+    RecordDescs* descs; // are other chunks
+    RecordCats localcats;
+    RecordDescs localdescs;
+} Chunk;
+
+/* Shared state for parsing chunks on multiple threads. */
+typedef struct {
+    const char* s;
+    Chunk* chunks;
+    const RecordColumns* blocks;    // the file's, filled in order
+    int64_t* offsets;
+} ChunkJob;
+
+static void parsejob(void* arg, int i)
+{
+    ChunkJob* job = arg;
+    Chunk* chunk = job->chunks + i;
+    chunk->status = parsechunk(
+        job->s, chunk->start, chunk->stop, job->blocks, chunk->cats, chunk->descs,
+        chunk->first, job->offsets + chunk->first
+    );
+}
+
+/* Change the file's records START to STOP-1, held from the full block at
+BLOCKS onward, whose categories and descriptions are in CHUNK's dictionary
+and arena, to refer to the list's instead. Return false if there is
+insufficient memory. */
+static bool mergechunk(
+    const Chunk* chunk, const RecordColumns* blocks, ptrdiff_t start, ptrdiff_t stop
+) {
+    const RecordCats* cats = &chunk->localcats;
+    int32_t* ids = malloc((cats->count + 1) * sizeof(*ids));
+    if (ids == NULL)
+        return false;
+    for (int32_t i = 0; i < cats->count; i++) {
+        if ((ids[i] = rec_intern(&st_cats, cats->names[i])) < 0) {
+            free(ids);
+            return false;
+        }
+    }
+    const RecordDescs* descs = &chunk->localdescs;
+    int64_t base = rec_putdescs(&st_descs, descs->chars, descs->len);
+    if (base < 0) {
+        free(ids);
+        return false;
+    }
+    for (ptrdiff_t i = start; i < stop; i++) {
+        const RecordColumns* cols = blocks + i / BLOCKCAP;
+        cols->cat[i % BLOCKCAP] = ids[cols->cat[i % BLOCKCAP]];
+        cols->descoff[i % BLOCKCAP] += base;
+    }
+    free(ids);
+    return true;
+}
+
+/* Prepare the list to hold COUNT records: initialize the dictionary, and
+grow the offsets to hold COUNT+1 elements. Blocks are added as records
+are. Return false if there is insufficient memory. */
+static bool reserve(ptrdiff_t count)
+{
+    if (st_cats.ids == NULL && !rec_initcats(&st_cats))
+        return false;
+    if (st_offsets && count <= st_offsetcap)
+        return true;
+    ptrdiff_t cap = util_max(count, util_min(st_offsetcap * 2, RL_MAXCOUNT));
+    int64_t* offsets = realloc(st_offsets, (cap + 1) * sizeof(*offsets));
+    if (offsets == NULL)
+        return false;
+    st_offsets = offsets;
+    st_offsetcap = cap;
+    return true;
+}
+
+/* Append records deserialized from the LEN chars at S to the list, in
+blocks of their own. Return values are the same as for rl_init; on failure
+the list is unchanged. */
+static ptrdiff_t loadbuf(const char* s, size_t len)
+{
+    int nchunks = util_max(1, util_min(
+        st_threads > 0 ? st_threads : util_ncpus(),
+        len / MINCHUNK
+    ));
+    Chunk chunkbuf[1];
+    Chunk* chunks = (nchunks == 1) ? chunkbuf : malloc(nchunks * sizeof(*chunks));
+    if (chunks == NULL)
+        return -1;
+
+    // split at newlines and count each chunk's lines; the final line need
+    // not end with a newline
+    ptrdiff_t lines = 0;
+    for (int i = 0; i < nchunks; i++) {
+        Chunk* chunk = chunks + i;
+        chunk->start = i ? chunks[i-1].stop : 0;
+        chunk->stop = len;
+        if (i < nchunks - 1) {
+            size_t target = util_max(chunk->start, len / nchunks * (i + 1));
+            const char* eol = memchr(s + target, '\n', len - target);
+            if (eol)
+                chunk->stop = eol - s + 1;
+        }
+        chunk->first = lines;
+        lines += scan_count(s + chunk->start, chunk->stop - chunk->start);
+    }
+    if (len && s[len-1] != '\n')
+        lines++;
+    if (lines > RL_MAXCOUNT - st_count) {
+        if (chunks != chunkbuf)
+            free(chunks);
+        return PTRDIFF_MAX;
+    }
+
+    // the file's records fill blocks of their own, appended to the list's
+    ptrdiff_t at = st_nblocks;
+    ptrdiff_t nblocks = (lines + BLOCKCAP - 1) / BLOCKCAP;
+    if (!reserve(st_count + lines) || !addblocks(at, nblocks)) {
+        if (chunks != chunkbuf)
+            free(chunks);
+        return -1;
+    }
+
+    // threads intern categories and append descriptions into dictionaries
+    // and arenas of their own
+    int64_t desclen0 = st_descs.len;
+    bool nomem = false;
+    for (int i = 0; i < nchunks; i++) {
+        chunks[i].cats = &st_cats;
+        chunks[i].descs = &st_descs;
+        chunks[i].localdescs = (RecordDescs){0};
+        if (nchunks > 1) {
+            chunks[i].cats = &chunks[i].localcats;
+            chunks[i].descs = &chunks[i].localdescs;
+            if (!rec_initcats(&chunks[i].localcats))
+                nomem = true;
+        }
+    }
+
+    // parse chunks directly into their place in the blocks; report the
+    // earliest bad line
+    ChunkJob job = {
+        .s = s, .chunks = chunks,
+        .blocks = st_blocks + at, .offsets = st_offsets + st_count
+    };
+    if (!nomem)
+        util_parallel(nchunks, parsejob, &job);
+    ptrdiff_t status = nomem ? -1 : 0;
+    for (int i = 0; i < nchunks && !status; i++)
+        if (chunks[i].status)
+            status = (chunks[i].status < 0) ? -1 : chunks[i].first + chunks[i].status;
+
+    // then they are merged into the list's, chunk by chunk, so ids are
+    // numbered in order of first appearance however many threads ran
+    for (int i = 0; i < nchunks && nchunks > 1; i++) {
+        ptrdiff_t stop = (i < nchunks - 1) ? chunks[i+1].first : lines;
+        if (!status && !mergechunk(chunks + i, st_blocks + at, chunks[i].first, stop))
+            status = -1;
+        rec_freecats(&chunks[i].localcats);
+        rec_freedescs(&chunks[i].localdescs);
+    }
+    if (chunks != chunkbuf)
+        free(chunks);
+    if (status) {
+        removeblocks(at, nblocks);
+        st_descs.len = desclen0;
+        return status;
+    }
+
+    // offsets are only tracked for a list loaded from a single file, and a
+    // final line without a newline must be rewritten with one
+    if (st_count == 0) {
+        st_offsets[lines] = len;
+        st_clean = (len && s[len-1] != '\n') ? lines - 1 : lines;
+    } else {
+        st_clean = 0;
+    }
+
+    for (ptrdiff_t k = at; k < at + nblocks; k++)
+        st_counts[k] = util_min(BLOCKCAP, lines - (k - at) * BLOCKCAP);
+    renumber(at);
+    rl_resetslice();
+    return 0;
+}
+
+/* Map F, or nothing if F is NULL, and append its records to the list. */
+static ptrdiff_t loadfile(FILE* f)
+{
+    FileView view = {0};
+    if (f && !util_mapfile(f, &view))
         return -1;
+    ptrdiff_t status = loadbuf(view.data, view.len);
+    if (f)
+        util_unmapfile(&view);
+    return status;
+}
 
-    // deserialize lines
-    if (f) {
-        char buf[REC_STRLEN + 1];
-        fseek(f, 0, SEEK_SET);
-        for (ptrdiff_t i = 0; i < lines; i++) {
-            size_t slen = strlen(fgets(buf, sizeof buf, f));
-            if (buf[slen-1] == '\n')
-                buf[slen-1] = 0;
-            if (NULL == rec_fromstr(arr + i, buf)) {
-                free(arr);
-                return i + 1;
-            };
+ptrdiff_t rl_init(FILE* f)
+{
+    rl_deinit();
+    return loadfile(f);
+}
+
+ptrdiff_t rl_append(FILE* f)
+{
+    return loadfile(f);
+}
+
+/* Return the offset of the first line in the LEN chars at S whose date
+prefix is greater than (if UPPER) or not less than (otherwise) the ISO date
+at ISO. Lines must be sorted by date. A line too short for a date prefix
+compares as less than any date. */
+static size_t bsline(const char* s, size_t len, const char* iso, bool upper)
+{
+    size_t l = 0, r = len;
+    while (l < r) {
+        // back up to the start of the middle line; L is a line start
+        size_t m = l + (r - l) / 2;
+        while (m > l && s[m-1] != '\n')
+            m--;
+
+        size_t n = util_min(DT_ISOLEN, len - m);
+        int cmp = memcmp(s + m, iso, n);
+        if (cmp == 0 && n < DT_ISOLEN)
+            cmp = -1;
+        if (cmp < 0 || (upper && cmp == 0)) {
+            const char* eol = memchr(s + m, '\n', len - m);
+            l = eol ? (size_t)(eol - s) + 1 : len;
+        } else {
+            r = m;
         }
     }
+    return l;
+}
+
+ptrdiff_t rl_initrange(
+    FILE* f, int64_t start, int64_t stop, int32_t dt0, int32_t dt1
+) {
+    rl_deinit();
+    FileView view = {0};
+    if (!util_mapfile(f, &view))
+        return -1;
+    size_t stopc = util_min(util_max(0, stop), (int64_t)view.len);
+    size_t startc = util_min(util_max(0, start), (int64_t)stopc);
+    const char* s = view.len ? view.data + startc : "";
+    size_t len = stopc - startc;
 
-    st_records = arr;
-    st_count = lines;
+    // records in range are contiguous, so only their lines are parsed
+    char iso0[DT_ISOLEN], iso1[DT_ISOLEN];
+    dt_writeiso(dt0, iso0);
+    dt_writeiso(dt1, iso1);
+    size_t first = 0, last = 0;
+    if (dt0 <= dt1) {
+        first = bsline(s, len, iso0, false);
+        last = first + bsline(s + first, len - first, iso1, true);
+    }
+    ptrdiff_t status = loadbuf(s + first, last - first);
+    if (status > 0 && status != PTRDIFF_MAX)
+        status += scan_count(s, first);
+    util_unmapfile(&view);
+
+    // offsets are relative to START, and nothing before it is loaded
+    st_clean = 0;
+    return status;
+}
+
+ptrdiff_t rl_initbin(FILE* f, int64_t start)
+{
+    rl_deinit();
+    FileView view = {0};
+    if (!util_mapfile(f, &view))
+        return -1;
+    size_t startc = util_min(util_max(0, start), (int64_t)view.len);
+    const char* s = view.len ? view.data + startc : "";
+    size_t len = view.len - startc;
+    ptrdiff_t count = rb_count(s, len);
+    if (count < 0) {
+        util_unmapfile(&view);
+        return 1;
+    }
+    if (count > RL_MAXCOUNT) {
+        util_unmapfile(&view);
+        return PTRDIFF_MAX;
+    }
+
+    // the records fill blocks in order
+    ptrdiff_t nblocks = (count + BLOCKCAP - 1) / BLOCKCAP;
+    ptrdiff_t status = -1;
+    if (reserve(count) && addblocks(0, nblocks)) {
+        for (ptrdiff_t k = 0; k < nblocks; k++)
+            st_counts[k] = util_min(BLOCKCAP, count - k * BLOCKCAP);
+        status = rb_decode(s, len, st_blocks, st_counts, nblocks);
+    }
+    util_unmapfile(&view);
+    if (status) {
+        rl_deinit();
+        return status;
+    }
+
+    // the image has no text offsets, so every record counts as changed
+    st_offsets[0] = 0;
+    st_clean = 0;
+
+    renumber(0);
     st_slicestart = 0;
     st_slicestop = st_count;
     return 0;
 }
 
-void rl_write(FILE* f)
+bool rl_write(FILE* f)
+{
+    if (st_offsets)
+        st_offsets[0] = 0;
+    st_clean = 0;
+    return rl_writefrom(f, 0);
+}
+
+/* Serialize records START to STOP-1. If OFFSETS is not NULL, store the
+offset just past record I in OFFSETS[I+1], counting from OFFSETS[START]. */
+static bool writerecs(FILE* f, ptrdiff_t start, ptrdiff_t stop, int64_t* offsets)
 {
-    for (int i = 0; i < st_count; i++) {
-        fputs(rec_tostr(st_records + i), f);
-        putc('\n', f);
+    OutBuf ob;
+    if (!ob_open(&ob, f, OB_DEFAULTCAP))
+        return false;
+    for (ptrdiff_t i = start; i < stop;) {
+        ptrdiff_t k = findblock(i);
+        ptrdiff_t end = util_min(stop, st_firsts[k+1]);
+        for (; i < end; i++) {
+            Record rec;
+            char* p = ob_reserve(&ob, REC_STRLEN + 1);
+            int len = rec_tobuf(rec_fromcols(&rec, st_blocks + k, i - st_firsts[k]), p);
+            p[len] = '\n';
+            ob_commit(&ob, len + 1);
+            if (offsets)
+                offsets[i+1] = offsets[i] + len + 1;
+        }
     }
-    fflush(f);
+    return ob_close(&ob);
 }
 
-void rl_deinit(void)
+bool rl_writefrom(FILE* f, ptrdiff_t start)
 {
-    if (st_records) {
-        free(st_records);
-        st_records = NULL;
-        st_count = 0;
-        st_slicestart = 0;
-        st_slicestart = 0;
+    if (start > st_clean || !writerecs(f, start, st_count, st_offsets))
+        return false;
+    if (st_offsets)
+        st_clean = st_count;
+    return true;
+}
+
+bool rl_writeslice(FILE* f)
+{
+    return writerecs(f, st_slicestart, st_slicestop, NULL);
+}
+
+bool rl_writebin(FILE* f)
+{
+    return rb_write(f, st_blocks, st_counts, st_nblocks);
+}
+
+bool rl_writeclean(FILE* f)
+{
+    int64_t clean = st_offsets ? st_clean : 0;
+    int64_t zero = 0;
+    const int64_t* offsets = st_offsets ? st_offsets : &zero;
+    return fwrite(&clean, sizeof(clean), 1, f) == 1
+        && fwrite(offsets, sizeof(*offsets), clean + 1, f) == (size_t)clean + 1;
+}
+
+bool rl_readclean(FILE* f)
+{
+    int64_t clean;
+    if (
+        fread(&clean, sizeof(clean), 1, f) != 1
+        || clean < 0 || clean > st_count
+        || !reserve(st_count)
+    ) return false;
+    if (fread(st_offsets, sizeof(*st_offsets), clean + 1, f) != (size_t)clean + 1) {
+        st_offsets[0] = 0;
+        st_clean = 0;
+        return false;
     }
+    st_clean = clean;
+    return true;
 }
 
+ptrdiff_t rl_clean(int64_t* offset)
+{
+    *offset = st_offsets ? st_offsets[st_clean] : 0;
+    return st_clean;
+}
 
-// <3> General
+void rl_deinit(void)
+{
+    for (ptrdiff_t k = 0; k < st_nblocks; k++)
+        free(st_blocks[k].amt);
+    free(st_blocks);
+    free(st_counts);
+    free(st_firsts);
+    free(st_offsets);
+    rec_freecats(&st_cats);
+    rec_freedescs(&st_descs);
+    resetsel();
+    st_blocks = NULL;
+    st_counts = NULL;
+    st_firsts = NULL;
+    st_offsets = NULL;
+    st_nblocks = 0;
+    st_blockcap = 0;
+    st_lastblock = 0;
+    st_descdead = 0;
+    st_count = 0;
+    st_offsetcap = 0;
+    st_clean = 0;
+    st_slicestart = 0;
+    st_slicestop = 0;
+}
+
+
+// <4> General
+
+/* Fewest dead chars the description arena is compacted for. */
+#define MINDEAD 4096
+
+/* Count the descriptions of records START to STOP-1, which are about to
+be deleted, as dead. Once dead chars make up most of the arena, rewrite it
+with only the descriptions still referred to, in record order, so each
+deletion costs amortized O(1) chars. The arena is left as is if there is
+insufficient memory for the rewrite. */
+static void freedescs(ptrdiff_t start, ptrdiff_t stop)
+{
+    for (ptrdiff_t i = start; i < stop; i++) {
+        ptrdiff_t k = findblock(i);
+        st_descdead += st_blocks[k].desclen[i - st_firsts[k]];
+    }
+    if (st_descdead < MINDEAD || st_descdead < st_descs.len / 2)
+        return;
+
+    RecordDescs new = {0};
+    if (!rec_reservedescs(&new, st_descs.len - st_descdead))
+        return;
+    for (ptrdiff_t k = 0; k < st_nblocks; k++) {
+        RecordColumns* cols = st_blocks + k;
+        for (ptrdiff_t i = 0; i < st_counts[k]; i++) {
+            if (st_firsts[k] + i >= start && st_firsts[k] + i < stop)
+                continue;
+            const char* desc = st_descs.chars + cols->descoff[i];
+            cols->descoff[i] = rec_putdescs(&new, desc, cols->desclen[i]);
+        }
+    }
+    rec_freedescs(&st_descs);
+    st_descs = new;
+    st_descdead = 0;
+}
 
 /* Return the rightmost record insertion point for the record list to
 remain sorted. */
 static ptrdiff_t rl_bsr(int32_t dt)
 {
-    ptrdiff_t l = 0, r = st_count;
+    // the first block whose last record is dated after DT holds it
+    ptrdiff_t l = 0, r = st_nblocks;
     while (l < r) {
         ptrdiff_t m = (l + r) / 2;
-        if (dt >= st_records[m].dt)
+        if (dt >= st_blocks[m].dt[st_counts[m] - 1])
             l = m + 1;
         else
             r = m;
     }
-    return l;
+    if (l == st_nblocks)
+        return st_count;
+    const int32_t* dts = st_blocks[l].dt;
+    ptrdiff_t k = l;
+    l = 0, r = st_counts[k];
+    while (l < r) {
+        ptrdiff_t m = (l + r) / 2;
+        if (dt >= dts[m])
+            l = m + 1;
+        else
+            r = m;
+    }
+    return st_firsts[k] + l;
 }
 
 /* Return the leftmost record insertion point for the record list to remain
@@ -145,33 +864,195 @@ static ptrdiff_t rl_bsl(int32_t dt)
 
 const Record* rl_insert(const Record* rec)
 {
+    // making room for the record first, the only steps that can fail
+    if (
+        st_count == RL_MAXCOUNT
+        || !reserve(st_count + 1)
+        || rec_intern(&st_cats, rec->cat) < 0
+        || !rec_reservedescs(&st_descs, strlen(rec->desc))
+    ) return NULL;
+
+    // a record goes in the block holding its insertion point, or after the
+    // last record; a full block is split, except the last one when
+    // appending, which is followed by a new block
     ptrdiff_t index = rl_bsr(rec->dt);
-    for (ptrdiff_t i = st_count; i > index; i--)
-        st_records[i] = st_records[i-1];
-    st_records[index] = *rec;
-    st_count++;
+    ptrdiff_t k = (index < st_count) ? findblock(index) : st_nblocks - 1;
+    if (k < 0 || st_counts[k] == BLOCKCAP) {
+        if (index == st_count) {
+            if (!addblocks(st_nblocks, 1))
+                return NULL;
+            k = st_nblocks - 1;
+        } else {
+            if (!splitblock(k))
+                return NULL;
+            k += (index >= st_firsts[k+1]);
+        }
+    }
+
+    ptrdiff_t pos = index - st_firsts[k];
+    moverecs(st_blocks + k, pos + 1, st_blocks + k, pos, st_counts[k] - pos);
+    rec_tocols(rec, st_blocks + k, pos);
+    st_counts[k]++;
+    renumber(k);
+    st_clean = util_min(st_clean, index);
     st_slicestart += (index <= st_slicestart);
     st_slicestop += (index < st_slicestop);
-    return st_records + index;
+    resetsel();
+    return rl_get(index);
+}
+
+/* Stably sort the COUNT records at RECS by date. Return false if there is
+insufficient memory. */
+static bool sortrecs(Record* recs, ptrdiff_t count)
+{
+    // batches are often sorted already
+    ptrdiff_t sorted = 1;
+    while (sorted < count && recs[sorted-1].dt <= recs[sorted].dt)
+        sorted++;
+    if (sorted >= count)
+        return true;
+
+    // bottom-up merge sort, alternating between RECS and a buffer
+    Record* buf = malloc(count * sizeof(*buf));
+    if (buf == NULL)
+        return false;
+    Record* src = recs;
+    Record* dst = buf;
+    for (ptrdiff_t width = 1; width < count; width *= 2) {
+        for (ptrdiff_t lo = 0; lo < count; lo += 2 * width) {
+            ptrdiff_t mid = util_min(lo + width, count);
+            ptrdiff_t hi = util_min(lo + 2 * width, count);
+            ptrdiff_t i = lo, j = mid, k = lo;
+            while (i < mid && j < hi)
+                dst[k++] = (src[j].dt < src[i].dt) ? src[j++] : src[i++];
+            while (i < mid)
+                dst[k++] = src[i++];
+            while (j < hi)
+                dst[k++] = src[j++];
+        }
+        Record* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+    if (src != recs)
+        memcpy(recs, src, count * sizeof(*recs));
+    free(buf);
+    return true;
+}
+
+bool rl_insertmany(Record* recs, ptrdiff_t count)
+{
+    if (
+        count > RL_MAXCOUNT - st_count
+        || !sortrecs(recs, count)
+        || !reserve(st_count + count)
+    ) return false;
+    size_t desclen = 0;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        if (rec_intern(&st_cats, recs[i].cat) < 0)
+            return false;
+        desclen += strlen(recs[i].desc);
+    }
+    if (!rec_reservedescs(&st_descs, desclen))
+        return false;
+
+    // the records from the block where the batch starts onward are merged
+    // with it into new blocks after the last, allocated up front so a
+    // failure leaves the list unchanged, which then replace the old ones
+    ptrdiff_t index = count ? rl_bsr(recs[0].dt) : st_count;
+    ptrdiff_t k = (index < st_count) ? findblock(index) : st_nblocks;
+    ptrdiff_t oldn = st_nblocks;
+    ptrdiff_t total = st_count - ((k < oldn) ? st_firsts[k] : st_count) + count;
+    if (!addblocks(oldn, (total + BLOCKCAP - 1) / BLOCKCAP))
+        return false;
+
+    // list records go before batch records of the same date
+    ptrdiff_t src = k, pos = 0, j = 0, dst = oldn;
+    while (src < oldn || j < count) {
+        // an exhausted source block is passed over first, since the last
+        // destination block fills with the last record merged
+        RecordColumns* out = st_blocks + dst;
+        if (src < oldn && pos == st_counts[src]) {
+            src++;
+            pos = 0;
+        } else if (st_counts[dst] == BLOCKCAP) {
+            dst++;
+        } else if (src < oldn && (j == count || st_blocks[src].dt[pos] <= recs[j].dt)) {
+            // a run of list records moves at once
+            const int32_t* dts = st_blocks[src].dt;
+            ptrdiff_t room = BLOCKCAP - st_counts[dst];
+            ptrdiff_t run = pos + 1;
+            while (
+                run < st_counts[src] && run - pos < room
+                && (j == count || dts[run] <= recs[j].dt)
+            ) run++;
+            moverecs(out, st_counts[dst], st_blocks + src, pos, run - pos);
+            st_counts[dst] += run - pos;
+            pos = run;
+        } else {
+            rec_tocols(recs + j++, out, st_counts[dst]++);
+        }
+    }
+    removeblocks(k, oldn - k);
+
+    st_clean = util_min(st_clean, index);
+    rl_resetslice();
+    return true;
 }
 
 bool rl_delete(ptrdiff_t index)
 {
     if (index < 0 || index >= st_count)
         return false;
-    st_count--;
-    for (ptrdiff_t i = index; i < st_count; i++)
-        st_records[i] = st_records[i+1];
+    st_clean = util_min(st_clean, index);
+    freedescs(index, index + 1);
+    ptrdiff_t k = findblock(index);
+    ptrdiff_t pos = index - st_firsts[k];
+    moverecs(st_blocks + k, pos, st_blocks + k, pos + 1, st_counts[k] - pos - 1);
+    st_counts[k]--;
+    renumber(k);
+    tidyblock(k);
     st_slicestart -= (index < st_slicestart);
     st_slicestop -= (index < st_slicestop);
+    resetsel();
     return true;
 }
 
+ptrdiff_t rl_deleteslice(void)
+{
+    ptrdiff_t start = st_slicestart, stop = st_slicestop;
+    if (start == stop)
+        return rl_resetslice(), 0;
+    st_clean = util_min(st_clean, start);
+    freedescs(start, stop);
 
-// <4> Slicing
+    // the records of block KA before the slice and of block KB after it
+    // stay, and every block between them goes
+    ptrdiff_t ka = findblock(start), kb = findblock(stop - 1);
+    ptrdiff_t posa = start - st_firsts[ka], posb = stop - st_firsts[kb];
+    if (ka == kb) {
+        moverecs(st_blocks + ka, posa, st_blocks + ka, posb, st_counts[ka] - posb);
+        st_counts[ka] -= stop - start;
+        renumber(ka);
+    } else {
+        moverecs(st_blocks + kb, 0, st_blocks + kb, posb, st_counts[kb] - posb);
+        st_counts[kb] -= posb;
+        st_counts[ka] = posa;
+        removeblocks(ka + 1, kb - ka - 1);
+        renumber(ka);
+        tidyblock(ka + 1);
+    }
+    tidyblock(ka);
+    rl_resetslice();
+    return stop - start;
+}
+
+
+// <5> Slicing
 
 ptrdiff_t rl_resetslice(void)
 {
+    resetsel();
     st_slicestart = 0;
     st_slicestop = st_count;
     return st_count;
@@ -179,6 +1060,7 @@ ptrdiff_t rl_resetslice(void)
 
 ptrdiff_t rl_slice(int32_t dt0, int32_t dt1)
 {
+    resetsel();
     st_slicestart = rl_bsl(dt0);
     st_slicestop = rl_bsr(dt1);
     return rl_slicecount();
@@ -208,57 +1090,109 @@ static char* lcasecpy(const char* src, char* dest, int len)
     return dest;
 }
 
-#define MK_FILTER(member) \
-ptrdiff_t rl_filter##member(const char* patterns, int delim) \
-{ \
+/* Check if at least one of the patterns in PATTERNS is a substring of the
+LEN chars at S, lowercased. PATTERNS is lowercased, with each of its
+DELIM_COUNT delimiters, at DELIM_POSITIONS, changed to the null byte. */
+static bool matchany(
+    const char* s, size_t len,
+    const char* patterns, const int* delim_positions, int delim_count
+) {
+    char lcased[REC_DESCLEN + 1];
+    lcasecpy(s, lcased, util_min(len, sizeof(lcased) - 1));
+    if (strstr(lcased, patterns))
+        return true;
+    for (int j = 0; j < delim_count; j++)
+        if (strstr(lcased, patterns + delim_positions[j] + 1))
+            return true;
+    return false;
+}
+
+/* Deselect records whose category, if BYCAT, or description matches none
+of PATTERNS. Only the selected records are visited, a span at a time, and
+categories are matched once per id rather than once per record. */
+static ptrdiff_t filter(const char* patterns, int delim, bool bycat)
+{
     /* Make a copy of PATTERNS lowercased, with all DELIM characters
     changed to the null byte. Create an array tracking the location of each
     DELIM character. For each record member, check if at least one of the
-    patterns in PATTERN's copy is a substring of that member. */ \
-\
-    /* -1 for malloc failure. */ \
-    ptrdiff_t retval = -1;  \
-\
-    int* delim_positions = NULL; \
-    char* patterns_lcased = NULL; \
-\
-    /* Get delim positions. */ \
-    int delim_count = countchars(patterns, delim, NULL); \
-    delim_positions = malloc(delim_count * sizeof(*delim_positions)); \
-    if (delim_positions == NULL) \
-        goto cleanup; \
-    countchars(patterns, delim, delim_positions); \
-\
-    /* Lcase-copy patterns. */ \
-    int patlen = strlen(patterns); \
-    patterns_lcased = malloc(patlen + 1); \
-    if (patterns_lcased == NULL) \
-        goto cleanup; \
-    lcasecpy(patterns, patterns_lcased, patlen); \
-    for (int i = 0; i < delim_count; i++) \
-        patterns_lcased[delim_positions[i]] = '\0'; \
-\
-    for (ptrdiff_t i = st_slicestop - 1; i >= st_slicestart; i--) { \
-        /* Lcase-copy member. */ \
-        char curmember[util_membersize(Record, member)]; \
-        lcasecpy(st_records[i].member, curmember, util_membersize(Record, member) - 1); \
-\
-        /* Substring compare. */ \
-        if (strstr(curmember, patterns_lcased)) \
-            continue; \
-        for (int j = 0; j < delim_count; j++) \
-            if (strstr(curmember, patterns_lcased + delim_positions[j] + 1)) \
-                goto matches; \
-\
-        rl_delete(i); \
-    matches:; \
-    } \
-\
-    retval = rl_slicecount(); \
-cleanup: \
-    free(delim_positions); \
-    free(patterns_lcased); \
-    return retval; \
-}
-MK_FILTER(cat)
-MK_FILTER(desc)
+    patterns in PATTERN's copy is a substring of that member. */
+
+    /* -1 for malloc failure. */
+    ptrdiff_t retval = -1;
+
+    int* delim_positions = NULL;
+    char* patterns_lcased = NULL;
+    bool* catmatches = NULL;
+    ptrdiff_t* sel = NULL;
+
+    /* Get delim positions. */
+    int delim_count = countchars(patterns, delim, NULL);
+    delim_positions = malloc(delim_count * sizeof(*delim_positions));
+    if (delim_positions == NULL)
+        goto cleanup;
+    countchars(patterns, delim, delim_positions);
+
+    /* Lcase-copy patterns. */
+    int patlen = strlen(patterns);
+    patterns_lcased = malloc(patlen + 1);
+    if (patterns_lcased == NULL)
+        goto cleanup;
+    lcasecpy(patterns, patterns_lcased, patlen);
+    for (int i = 0; i < delim_count; i++)
+        patterns_lcased[delim_positions[i]] = '\0';
+
+    /* Match each category once. */
+    if (bycat) {
+        catmatches = malloc((st_cats.count + 1) * sizeof(*catmatches));
+        if (catmatches == NULL)
+            goto cleanup;
+        for (int32_t id = 0; id < st_cats.count; id++)
+            catmatches[id] = matchany(
+                st_cats.names[id], strlen(st_cats.names[id]),
+                patterns_lcased, delim_positions, delim_count
+            );
+    }
+
+    /* Narrow the selection to the matches. */
+    sel = malloc((rl_selcount() + 1) * sizeof(*sel));
+    if (sel == NULL)
+        goto cleanup;
+    ptrdiff_t count = 0;
+    RlSpan span;
+    ptrdiff_t pos;
+    rl_foreachsel(span, pos) {
+        ptrdiff_t index = rl_selindex(pos);
+        for (ptrdiff_t i = 0; i < span.len; i++) {
+            bool matches = bycat
+                ? catmatches[span.cat[i]]
+                : matchany(
+                    span.descs + span.descoff[i], span.desclen[i],
+                    patterns_lcased, delim_positions, delim_count
+                );
+            if (matches)
+                sel[count++] = index + i;
+        }
+    }
+    free(st_sel);
+    st_sel = sel;
+    st_selcount = count;
+    sel = NULL;
+
+    retval = count;
+cleanup:
+    free(delim_positions);
+    free(patterns_lcased);
+    free(catmatches);
+    free(sel);
+    return retval;
+}
+
+ptrdiff_t rl_filtercat(const char* patterns, int delim)
+{
+    return filter(patterns, delim, true);
+}
+
+ptrdiff_t rl_filterdesc(const char* patterns, int delim)
+{
+    return filter(patterns, delim, false);
+}
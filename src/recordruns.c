@@ -0,0 +1,297 @@
+// <1> Runs
+// <2> Merging
+// <3> General
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "util.h"
+#include "record.h"
+#include "recordruns.h"
+
+/* Fewest records the buffer may hold, since a merge gives each run a
+share of it. */
+#define MINCAP RR_FANIN
+
+/* Capacity of a fresh buffer, which only grows to its budget as needed. */
+#define INITCAP 1024
+
+/* Buffered records are sorted by keys holding their date in the high 32
+bits and their index in the low 32 bits. */
+#define KEY(dt, i) ((int64_t)(dt) * ((int64_t)1 << 32) + (i))
+#define KEYINDEX(key) ((ptrdiff_t)((key) & UINT32_MAX))
+
+/* Size of a temporary file's name, including the NUL. */
+#define FNSIZE 256
+
+
+// <1> Runs
+
+/* Store the name of the temporary file of run ID in BUF. */
+static char* runfn(const RecordRuns* rr, int id, char* buf)
+{
+    snprintf(buf, FNSIZE, rr->fmt, id);
+    return buf;
+}
+
+/* Append an empty run to RR's runs. Return false on failure. */
+static bool newrun(RecordRuns* rr)
+{
+    if (rr->nruns == rr->runcap) {
+        ptrdiff_t cap = rr->runcap ? rr->runcap * 2 : RR_FANIN;
+        RrRun* new = realloc(rr->runs, cap * sizeof(*new));
+        if (new == NULL)
+            return false;
+        rr->runs = new;
+        rr->runcap = cap;
+    }
+
+    RrRun* run = rr->runs + rr->nruns;
+    char fn[FNSIZE];
+    run->id = rr->nextid++;
+    run->f = fopen(runfn(rr, run->id, fn), "w+b");
+    run->level = 0;
+    run->count = 0;
+    if (run->f == NULL)
+        return false;
+    // the file lives on while open, and is gone even if the program dies
+    #ifndef _WIN32
+    remove(fn);
+    #endif // _WIN32
+    rr->nruns++;
+    return true;
+}
+
+/* Close RUN and remove its file. */
+static void closerun(const RecordRuns* rr, RrRun* run)
+{
+    fclose(run->f);
+    run->f = NULL;
+    #ifdef _WIN32
+    char fn[FNSIZE];
+    remove(runfn(rr, run->id, fn));
+    #else
+    (void)rr;
+    #endif // _WIN32
+}
+
+/* Append REC to RUN. */
+static void putrec(RrRun* run, const Record* rec)
+{
+    fwrite(rec, sizeof(*rec), 1, run->f);
+    run->count++;
+}
+
+/* Check that every record appended to RUN was written. */
+static bool flushrun(RrRun* run)
+{
+    return fflush(run->f) == 0 && !ferror(run->f);
+}
+
+
+// <2> Merging
+
+static int cmpkeys(const void* a, const void* b)
+{
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Refill R's buffer. Return false if reading failed. */
+static bool fill(RrReader* r)
+{
+    ptrdiff_t n = util_min(r->left, r->cap);
+    if (n && fread(r->buf, sizeof(*r->buf), n, r->f) != (size_t)n)
+        return false;
+    r->pos = 0;
+    r->len = n;
+    r->left -= n;
+    return true;
+}
+
+/* Start reading runs FIRST onward, splitting the buffer between them. */
+static bool startmerge(RecordRuns* rr, ptrdiff_t first)
+{
+    ptrdiff_t k = rr->nruns - first;
+    ptrdiff_t share = rr->cap / k;
+    for (ptrdiff_t i = 0; i < k; i++) {
+        RrRun* run = rr->runs + first + i;
+        if (!flushrun(run) || !util_fseek(run->f, 0))
+            return false;
+        rr->readers[i] = (RrReader){
+            .f = run->f,
+            .buf = rr->recs + i * share,
+            .cap = share,
+            .left = run->count,
+        };
+    }
+    return true;
+}
+
+/* Read the earliest record of the first K readers into REC. Ties go to
+the earliest reader, whose run holds the records added first. */
+static enum rr_status mergenext(RecordRuns* rr, ptrdiff_t k, Record* rec)
+{
+    RrReader* min = NULL;
+    for (ptrdiff_t i = 0; i < k; i++) {
+        RrReader* r = rr->readers + i;
+        if (r->pos == r->len) {
+            if (r->left == 0)
+                continue;
+            if (!fill(r))
+                return RR_READERR;
+        }
+        if (min == NULL || r->buf[r->pos].dt < min->buf[min->pos].dt)
+            min = r;
+    }
+    if (min == NULL)
+        return RR_END;
+    *rec = min->buf[min->pos++];
+    return RR_OK;
+}
+
+/* Replace runs FIRST onward with a single run holding their records. */
+static bool merge(RecordRuns* rr, ptrdiff_t first)
+{
+    ptrdiff_t k = rr->nruns - first;
+    int level = rr->runs[first].level + 1;
+    if (!startmerge(rr, first) || !newrun(rr))
+        return false;
+    RrRun* out = rr->runs + rr->nruns - 1;
+    Record rec;
+    enum rr_status status;
+    while ((status = mergenext(rr, k, &rec)) == RR_OK)
+        putrec(out, &rec);
+    if (status != RR_END || !flushrun(out))
+        return false;
+
+    for (ptrdiff_t i = first; i < first + k; i++)
+        closerun(rr, rr->runs + i);
+    rr->runs[first] = *out;
+    rr->runs[first].level = level;
+    rr->nruns = first + 1;
+    return true;
+}
+
+/* Write the buffered records as a new run, in date order, then merge the
+newest runs while RR_FANIN of them have the same level. */
+static bool spill(RecordRuns* rr)
+{
+    if (!newrun(rr))
+        return false;
+    RrRun* run = rr->runs + rr->nruns - 1;
+    qsort(rr->keys, rr->count, sizeof(*rr->keys), cmpkeys);
+    for (ptrdiff_t i = 0; i < rr->count; i++)
+        putrec(run, rr->recs + KEYINDEX(rr->keys[i]));
+    rr->count = 0;
+    if (!flushrun(run))
+        return false;
+
+    // older runs are never smaller, so the newest RR_FANIN runs have the
+    // same level if the first and last of them do
+    while (
+        rr->nruns >= RR_FANIN
+        && rr->runs[rr->nruns - RR_FANIN].level == rr->runs[rr->nruns - 1].level
+    ) {
+        if (!merge(rr, rr->nruns - RR_FANIN))
+            return false;
+    }
+    return true;
+}
+
+
+// <3> General
+
+bool rr_open(RecordRuns* rr, size_t budget, const char* fmt)
+{
+    size_t maxcap = budget / (sizeof(*rr->recs) + sizeof(*rr->keys));
+    maxcap = util_max(MINCAP, util_min(maxcap, UINT32_MAX));
+    maxcap = util_min(maxcap, PTRDIFF_MAX / sizeof(*rr->recs));
+    *rr = (RecordRuns){
+        .fmt = fmt,
+        .cap = util_min(INITCAP, maxcap),
+        .maxcap = maxcap,
+    };
+    rr->recs = malloc(rr->cap * sizeof(*rr->recs));
+    rr->keys = malloc(rr->cap * sizeof(*rr->keys));
+    if (rr->recs == NULL || rr->keys == NULL) {
+        rr_close(rr);
+        return false;
+    }
+    return true;
+}
+
+/* Grow the buffer towards its budget. */
+static bool grow(RecordRuns* rr)
+{
+    ptrdiff_t cap = util_min(rr->cap * 2, rr->maxcap);
+    Record* recs = realloc(rr->recs, cap * sizeof(*recs));
+    if (recs == NULL)
+        return false;
+    rr->recs = recs;
+    int64_t* keys = realloc(rr->keys, cap * sizeof(*keys));
+    if (keys == NULL)
+        return false;
+    rr->keys = keys;
+    rr->cap = cap;
+    return true;
+}
+
+bool rr_add(RecordRuns* rr, const Record* rec)
+{
+    if (rr->count == rr->cap) {
+        bool status = (rr->cap < rr->maxcap) ? grow(rr) : spill(rr);
+        if (!status)
+            return false;
+    }
+    rr->keys[rr->count] = KEY(rec->dt, rr->count);
+    rr->recs[rr->count++] = *rec;
+    rr->total++;
+    return true;
+}
+
+bool rr_finish(RecordRuns* rr)
+{
+    rr->next = 0;
+
+    // everything fit in the buffer
+    if (rr->nruns == 0) {
+        qsort(rr->keys, rr->count, sizeof(*rr->keys), cmpkeys);
+        return true;
+    }
+
+    if (rr->count && !spill(rr))
+        return false;
+    while (rr->nruns > RR_FANIN)
+        if (!merge(rr, rr->nruns - RR_FANIN))
+            return false;
+    return startmerge(rr, 0);
+}
+
+enum rr_status rr_next(RecordRuns* rr, Record* rec)
+{
+    if (rr->nruns)
+        return mergenext(rr, rr->nruns, rec);
+    if (rr->next == rr->count)
+        return RR_END;
+    *rec = rr->recs[KEYINDEX(rr->keys[rr->next++])];
+    return RR_OK;
+}
+
+void rr_close(RecordRuns* rr)
+{
+    for (ptrdiff_t i = 0; i < rr->nruns; i++)
+        closerun(rr, rr->runs + i);
+    free(rr->runs);
+    free(rr->recs);
+    free(rr->keys);
+    rr->runs = NULL;
+    rr->recs = NULL;
+    rr->keys = NULL;
+    rr->nruns = rr->runcap = 0;
+    rr->count = rr->cap = 0;
+}
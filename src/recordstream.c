@@ -0,0 +1,154 @@
+// <1> Streams
+// <2> Filters
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "record.h"
+#include "recordstream.h"
+
+
+// <1> Streams
+
+bool rs_open(RecordStream* rs, FILE* f)
+{
+    rs->buf = malloc(RS_BUFSIZE);
+    if (rs->buf == NULL)
+        return false;
+    rs->f = f;
+    rs->pos = 0;
+    rs->len = 0;
+    rs->eof = false;
+    rs->lineno = 0;
+    return true;
+}
+
+enum rs_status rs_next(RecordStream* rs, Record* rec)
+{
+    while (true) {
+        const char* s = rs->buf + rs->pos;
+        size_t n = rs->len - rs->pos;
+        const char* eol = memchr(s, '\n', n);
+
+        // a complete line, or a final line without a newline
+        if (eol || (rs->eof && n)) {
+            size_t len = eol ? (size_t)(eol - s) : n;
+            rs->pos += len + (eol != NULL);
+            rs->lineno++;
+            return (len <= REC_STRLEN && rec_fromstrn(rec, s, len))
+                ? RS_OK
+                : RS_BADLINE;
+        }
+        if (rs->eof)
+            return RS_END;
+
+        // no record is this long, so skip to the line's end
+        if (n > REC_STRLEN) {
+            rs->pos = rs->len = 0;
+            rs->lineno++;
+            for (int c; (c = getc(rs->f)) != '\n';) {
+                if (c == EOF) {
+                    rs->eof = true;
+                    return ferror(rs->f) ? RS_READERR : RS_BADLINE;
+                }
+            }
+            return RS_BADLINE;
+        }
+
+        // move the partial line to the front and refill
+        memmove(rs->buf, s, n);
+        rs->pos = 0;
+        rs->len = n + fread(rs->buf + n, 1, RS_BUFSIZE - n, rs->f);
+        if (rs->len < RS_BUFSIZE) {
+            if (ferror(rs->f))
+                return RS_READERR;
+            rs->eof = true;
+        }
+    }
+}
+
+void rs_close(RecordStream* rs)
+{
+    free(rs->buf);
+    rs->buf = NULL;
+}
+
+
+// <2> Filters
+
+/* Store a lowercased copy of the patterns in PATTERNS, which are separated
+by DELIM, in *OUT with each pattern followed by NUL. Return the number of
+patterns, 0 if PATTERNS is NULL, or -1 if there is insufficient memory. */
+static int splitpatterns(const char* patterns, int delim, char** out)
+{
+    *out = NULL;
+    if (patterns == NULL)
+        return 0;
+    size_t len = strlen(patterns);
+    *out = malloc(len + 1);
+    if (*out == NULL)
+        return -1;
+    int count = 1;
+    for (size_t i = 0; i <= len; i++) {
+        char c = patterns[i];
+        count += (c == delim);
+        (*out)[i] = (c == delim) ? '\0' : tolower((unsigned char)c);
+    }
+    return count;
+}
+
+bool rs_initfilter(
+    RecordFilter* rf, int32_t dt0, int32_t dt1,
+    const char* cats, const char* descs, int delim
+) {
+    rf->dt0 = dt0;
+    rf->dt1 = dt1;
+    rf->ncats = splitpatterns(cats, delim, &rf->cats);
+    rf->ndescs = splitpatterns(descs, delim, &rf->descs);
+    if (rf->ncats < 0 || rf->ndescs < 0) {
+        rs_freefilter(rf);
+        return false;
+    }
+    return true;
+}
+
+/* Check if any of the COUNT patterns at PATTERNS is a substring of S,
+ignoring case. S must fit in LEN chars including its NUL. */
+static bool matchany(const char* patterns, int count, const char* s, size_t len)
+{
+    char lower[REC_DESCLEN + 1];
+    size_t i = 0;
+    for (; i < len - 1 && s[i]; i++)
+        lower[i] = tolower((unsigned char)s[i]);
+    lower[i] = '\0';
+    for (const char* p = patterns; count--; p += strlen(p) + 1)
+        if (strstr(lower, p))
+            return true;
+    return false;
+}
+
+bool rs_match(const RecordFilter* rf, const Record* rec)
+{
+    return rec->dt >= rf->dt0
+        && rec->dt <= rf->dt1
+        && rs_matchcat(rf, rec->cat)
+        && (!rf->ndescs || matchany(rf->descs, rf->ndescs, rec->desc, sizeof rec->desc));
+}
+
+bool rs_matchcat(const RecordFilter* rf, const char* cat)
+{
+    return !rf->ncats || matchany(rf->cats, rf->ncats, cat, REC_CATLEN + 1);
+}
+
+void rs_freefilter(RecordFilter* rf)
+{
+    free(rf->cats);
+    free(rf->descs);
+    rf->cats = NULL;
+    rf->descs = NULL;
+}
@@ -13,7 +13,7 @@
 typedef struct node {
     union {
         struct node* nodes;
-        const Record* records;
+        ptrdiff_t first;    // selection position of a day's first record
     } ch;
     ptrdiff_t chlen;
     int id;
@@ -44,10 +44,11 @@ static ptrdiff_t st_uniquedates;
  * +-------------+
  * 
  * Each node's children are stored contiguously, ordered by ID. Day nodes'
- * children are record pointers stored in a record list (recall those
- * pointers are sorted by timestamp). A record tree does not own any record
- * objects, and the record list from which a record tree was built must
- * remain allocated in order to use the record tree.
+ * children are a range of positions in the record list's selection (recall
+ * the record list is sorted by timestamp, and filters only deselect
+ * records). A record tree does not own any record objects, and the record
+ * list and selection from which a record tree was built must remain
+ * unchanged in order to use the record tree.
  */
 
 
@@ -75,19 +76,23 @@ bool rt_init(void)
     if (ycounter == NULL || mcounter == NULL || dcounter == NULL)
         goto cleanup;
 
-    for (ptrdiff_t i = rl_slicestart(); i < rl_slicestop();) {
-        int32_t dt = rl_get(i)->dt;
-        while (
-            i < rl_slicestop()
-            && dt == rl_get(i)->dt
-        ) i++;
-
-        int64_t key;
-        if (
-            NULL == ht_insert(dcounter, (key=dt, &key), 0)
-            || NULL == ht_insert(mcounter, (key=dt/100, &key), 0)
-            || NULL == ht_insert(ycounter, (key=dt/10000, &key), 0)
-        ) goto cleanup;
+    RlSpan span;
+    ptrdiff_t pos;
+    rl_foreachsel(span, pos) {
+        for (ptrdiff_t i = 0; i < span.len;) {
+            int32_t dt = span.dt[i];
+            while (
+                i < span.len
+                && dt == span.dt[i]
+            ) i++;
+
+            int64_t key;
+            if (
+                NULL == ht_insert(dcounter, (key=dt, &key), 0)
+                || NULL == ht_insert(mcounter, (key=dt/100, &key), 0)
+                || NULL == ht_insert(ycounter, (key=dt/10000, &key), 0)
+            ) goto cleanup;
+        }
     }
 
     // create the node array
@@ -127,17 +132,20 @@ bool rt_init(void)
         }
     }
 
-    // set attach records to day nodes
-    for (ptrdiff_t k = 0, i = rl_slicestart(); i < rl_slicestop(); k++) {
-        ptrdiff_t j = i + 1;
-        int32_t dt = rl_get(i)->dt;
-        while (
-            j < rl_slicestop()
-            && dt == rl_get(j)->dt
-        ) j++;
-        arr[k].chlen = j - i;
-        arr[k].ch.records = rl_get(i);
-        i = j;
+    // set attach records to day nodes; a day's records may lie in more
+    // than one span
+    ptrdiff_t k = -1;
+    int32_t prevdt = 0;
+    rl_foreachsel(span, pos) {
+        for (ptrdiff_t i = 0; i < span.len; i++) {
+            if (k < 0 || span.dt[i] != prevdt) {
+                k++;
+                arr[k].chlen = 0;
+                arr[k].ch.first = pos + i;
+                prevdt = span.dt[i];
+            }
+            arr[k].chlen++;
+        }
     }
 
     // initialize
@@ -279,8 +287,8 @@ static long print_day(const Node* day, PrintState* pstate, bool isfinal)
     pstate->rec_mprefix = isfinal ? s_ : sI;
     ptrdiff_t i = 0;
     for (; i < day->chlen - 1; i++)
-        lines += print_rec(day->ch.records + i, pstate, false, i + RT_UI_FIRST_DIND);
-    lines += print_rec(day->ch.records + i, pstate, true, i + RT_UI_FIRST_DIND);
+        lines += print_rec(rl_get(rl_selindex(day->ch.first + i)), pstate, false, i + RT_UI_FIRST_DIND);
+    lines += print_rec(rl_get(rl_selindex(day->ch.first + i)), pstate, true, i + RT_UI_FIRST_DIND);
 
     return lines;
 }
@@ -333,12 +341,12 @@ ptrdiff_t rt_print(FILE* stream)
         int maxamtlen;
         {
             int64_t max = 0, min = 0;
-            for (ptrdiff_t i = 0; i < st_uniquedates; i++) {
-                Node* dnode = st_nodes + i;
-                for (ptrdiff_t j = 0; j < dnode->chlen; j++) {
-                    int64_t amt = dnode->ch.records[j].amt;
-                    max = util_max(max, amt);
-                    min = util_min(min, amt);
+            RlSpan span;
+            ptrdiff_t pos;
+            rl_foreachsel(span, pos) {
+                for (ptrdiff_t i = 0; i < span.len; i++) {
+                    max = util_max(max, span.amt[i]);
+                    min = util_min(min, span.amt[i]);
                 }
             }
             maxamtlen = 1 + util_max(
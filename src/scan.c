@@ -0,0 +1,228 @@
+// <1> Block Masks
+// <2> Scanning
+// <3> Dispatch
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_AVX2
+#ifdef __SSE2__
+#define HAVE_SSE2
+#endif
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+/* Chars per block. Each block is reduced to 32-bit masks. */
+#define BLOCK 32
+
+#ifdef __GNUC__
+#define ctz(x) __builtin_ctz(x)
+#define popcount(x) __builtin_popcount(x)
+#else
+static int ctz(uint32_t x)
+{
+    int n = 0;
+    for (; !(x & 1); x >>= 1) n++;
+    return n;
+}
+
+static int popcount(uint32_t x)
+{
+    int n = 0;
+    for (; x; x &= x - 1) n++;
+    return n;
+}
+#endif
+
+
+// <1> Block Masks
+// Set bit I of *NL if P[I] is a newline, and bit I of *DL if P[I] is DELIM.
+
+static inline void masks_scalar(const char* p, int delim, uint32_t* nl, uint32_t* dl)
+{
+    uint32_t n = 0, d = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        n |= (uint32_t)(p[i] == '\n') << i;
+        d |= (uint32_t)(p[i] == delim) << i;
+    }
+    *nl = n;
+    *dl = d;
+}
+
+#ifdef HAVE_SSE2
+static inline void masks_sse2(const char* p, int delim, uint32_t* nl, uint32_t* dl)
+{
+    __m128i lo = _mm_loadu_si128((const __m128i*)p);
+    __m128i hi = _mm_loadu_si128((const __m128i*)(p + 16));
+    __m128i n = _mm_set1_epi8('\n');
+    __m128i d = _mm_set1_epi8(delim);
+    *nl = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, n))
+        | (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, n)) << 16;
+    *dl = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(lo, d))
+        | (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(hi, d)) << 16;
+}
+#endif // HAVE_SSE2
+
+#ifdef HAVE_AVX2
+TARGET_AVX2
+static inline void masks_avx2(const char* p, int delim, uint32_t* nl, uint32_t* dl)
+{
+    __m256i v = _mm256_loadu_si256((const __m256i*)p);
+    *nl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+    *dl = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(delim)));
+}
+#endif // HAVE_AVX2
+
+
+// <2> Scanning
+
+/* Define count_LEVEL and lines_LEVEL, implementing scan_count and
+scan_lines using masks_LEVEL. ATTR is prepended to each definition. The
+final partial block is copied to a zero-filled buffer, which cannot match
+since neither newline nor DELIM is NUL. */
+#define MK_SCAN(level, attr) \
+attr static ptrdiff_t count_##level(const char* s, size_t len) \
+{ \
+    ptrdiff_t count = 0; \
+    uint32_t nl, dl; \
+    size_t base = 0; \
+    for (; len - base >= BLOCK; base += BLOCK) { \
+        masks_##level(s + base, '\n', &nl, &dl); \
+        count += popcount(nl); \
+    } \
+    if (base < len) { \
+        char buf[BLOCK] = {0}; \
+        memcpy(buf, s + base, len - base); \
+        masks_##level(buf, '\n', &nl, &dl); \
+        count += popcount(nl); \
+    } \
+    return count; \
+} \
+\
+attr static ptrdiff_t lines_##level( \
+    const char* s, size_t len, size_t* pos, int delim, \
+    ScanLine* lines, ptrdiff_t cap \
+) { \
+    if (*pos >= len || cap <= 0) \
+        return 0; \
+\
+    ptrdiff_t count = 0; \
+    ScanLine* line = lines; \
+    line->start = *pos; \
+    line->ndelims = 0; \
+    for (size_t base = *pos; base < len; base += BLOCK) { \
+        uint32_t nl, dl; \
+        if (len - base >= BLOCK) { \
+            masks_##level(s + base, delim, &nl, &dl); \
+        } else { \
+            char buf[BLOCK] = {0}; \
+            memcpy(buf, s + base, len - base); \
+            masks_##level(buf, delim, &nl, &dl); \
+        } \
+\
+        /* visit matches in order */ \
+        for (uint32_t m = nl | dl; m; m &= m - 1) { \
+            int bit = ctz(m); \
+            size_t off = base + bit; \
+            if (nl >> bit & 1) { \
+                line->len = off - line->start; \
+                if (++count == cap) { \
+                    *pos = off + 1; \
+                    return count; \
+                } \
+                line++; \
+                line->start = off + 1; \
+                line->ndelims = 0; \
+            } else if (line->ndelims < SCAN_MAXDELIMS) { \
+                line->delims[line->ndelims++] = off - line->start; \
+            } \
+        } \
+    } \
+\
+    if (line->start < len) { \
+        line->len = len - line->start; \
+        count++; \
+    } \
+    *pos = len; \
+    return count; \
+}
+MK_SCAN(scalar, )
+#ifdef HAVE_SSE2
+MK_SCAN(sse2, )
+#endif
+#ifdef HAVE_AVX2
+MK_SCAN(avx2, TARGET_AVX2)
+#endif
+
+
+// <3> Dispatch
+
+/* Level in use, or -1 if not yet determined. */
+static int st_level = -1;
+
+static enum scan_level supported(void)
+{
+    #ifdef HAVE_AVX2
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+        return SCAN_AVX2;
+    #endif
+    #ifdef HAVE_SSE2
+    return SCAN_SSE2;
+    #endif
+    return SCAN_SCALAR;
+}
+
+static enum scan_level level(void)
+{
+    if (st_level < 0)
+        st_level = supported();
+    return st_level;
+}
+
+enum scan_level scan_setlevel(enum scan_level max)
+{
+    enum scan_level best = supported();
+    st_level = (max < best) ? max : best;
+    return st_level;
+}
+
+ptrdiff_t scan_count(const char* s, size_t len)
+{
+    switch (level()) {
+        #ifdef HAVE_AVX2
+        case SCAN_AVX2:
+            return count_avx2(s, len);
+        #endif
+        #ifdef HAVE_SSE2
+        case SCAN_SSE2:
+            return count_sse2(s, len);
+        #endif
+        default:
+            return count_scalar(s, len);
+    }
+}
+
+ptrdiff_t scan_lines(
+    const char* s, size_t len, size_t* pos, int delim,
+    ScanLine* lines, ptrdiff_t cap
+) {
+    switch (level()) {
+        #ifdef HAVE_AVX2
+        case SCAN_AVX2:
+            return lines_avx2(s, len, pos, delim, lines, cap);
+        #endif
+        #ifdef HAVE_SSE2
+        case SCAN_SSE2:
+            return lines_sse2(s, len, pos, delim, lines, cap);
+        #endif
+        default:
+            return lines_scalar(s, len, pos, delim, lines, cap);
+    }
+}
@@ -1,13 +1,25 @@
 /* Generic utilities. */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include <errno.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#endif
+
 #include "util.h"
 
 bool util_fexists(const char* fp)
@@ -15,6 +27,231 @@ bool util_fexists(const char* fp)
     return !access(fp, F_OK);
 }
 
+bool util_fstat(const char* fp, int64_t* size, int64_t* mtime)
+{
+    struct stat st;
+    if (stat(fp, &st) != 0) {
+        *size = *mtime = 0;
+        return false;
+    }
+    *size = st.st_size;
+    *mtime = st.st_mtime;
+    return true;
+}
+
+bool util_fseek(FILE* f, int64_t offset)
+{
+    #ifdef _WIN32
+    return _fseeki64(f, offset, SEEK_SET) == 0;
+    #else
+    return fseeko(f, offset, SEEK_SET) == 0;
+    #endif // _WIN32
+}
+
+bool util_ftruncate(FILE* f, int64_t len)
+{
+    if (fflush(f) != 0)
+        return false;
+    #ifdef _WIN32
+    return _chsize_s(_fileno(f), len) == 0;
+    #else
+    return ftruncate(fileno(f), len) == 0;
+    #endif // _WIN32
+}
+
+bool util_lsdir(void (*fn)(void* arg, const char* name), void* arg)
+{
+    #ifdef _WIN32
+    WIN32_FIND_DATAA entry;
+    HANDLE h = FindFirstFileA("*", &entry);
+    if (h == INVALID_HANDLE_VALUE)
+        return GetLastError() == ERROR_FILE_NOT_FOUND;
+    do fn(arg, entry.cFileName);
+    while (FindNextFileA(h, &entry));
+    FindClose(h);
+    return true;
+    #else
+    DIR* dir = opendir(".");
+    if (dir == NULL)
+        return false;
+    for (struct dirent* entry; (entry = readdir(dir));)
+        fn(arg, entry->d_name);
+    closedir(dir);
+    return true;
+    #endif // _WIN32
+}
+
+/* Read the rest of F into an allocated buffer. */
+static bool readfile(FILE* f, FileView* view)
+{
+    size_t len = 0, cap = BUFSIZ;
+    char* buf = malloc(cap);
+    while (buf) {
+        len += fread(buf + len, 1, cap - len, f);
+        if (len < cap)
+            break;
+        char* new = realloc(buf, cap *= 2);
+        if (new == NULL)
+            free(buf);
+        buf = new;
+    }
+    if (buf == NULL || ferror(f)) {
+        free(buf);
+        return false;
+    }
+    view->data = buf;
+    view->len = len;
+    view->mapped = false;
+    return true;
+}
+
+bool util_mapfile(FILE* f, FileView* view)
+{
+    fflush(f);
+    #ifndef _WIN32
+    struct stat st;
+    int fd = fileno(f);
+    if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        if (st.st_size == 0) {
+            view->data = NULL;
+            view->len = 0;
+            view->mapped = false;
+            return true;
+        }
+        void* p = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            posix_madvise(p, st.st_size, POSIX_MADV_SEQUENTIAL);
+            view->data = p;
+            view->len = st.st_size;
+            view->mapped = true;
+            return true;
+        }
+    }
+    #endif // _WIN32
+    rewind(f);
+    return readfile(f, view);
+}
+
+void util_unmapfile(FileView* view)
+{
+    if (view->mapped) {
+        #ifndef _WIN32
+        munmap((void*)view->data, view->len);
+        #endif // _WIN32
+    } else {
+        free((void*)view->data);
+    }
+    view->data = NULL;
+    view->len = 0;
+    view->mapped = false;
+}
+
+int util_ncpus(void)
+{
+    #ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return util_max(1, info.dwNumberOfProcessors);
+    #else
+    return util_max(1, sysconf(_SC_NPROCESSORS_ONLN));
+    #endif // _WIN32
+}
+
+/* A single call made by util_parallel. */
+typedef struct {
+    void (*fn)(void* arg, int i);
+    void* arg;
+    int i;
+    bool started;   // whether the call runs on its own thread
+    #ifdef _WIN32
+    HANDLE thread;
+    #else
+    pthread_t thread;
+    #endif // _WIN32
+} Job;
+
+#ifdef _WIN32
+static DWORD WINAPI runjob(LPVOID job)
+#else
+static void* runjob(void* job)
+#endif // _WIN32
+{
+    Job* j = job;
+    j->fn(j->arg, j->i);
+    return 0;
+}
+
+void util_parallel(int count, void (*fn)(void* arg, int i), void* arg)
+{
+    Job* jobs = (count > 1) ? malloc(count * sizeof(*jobs)) : NULL;
+    if (jobs == NULL) {
+        for (int i = 0; i < count; i++)
+            fn(arg, i);
+        return;
+    }
+
+    for (int i = 1; i < count; i++) {
+        Job* j = jobs + i;
+        *j = (Job){.fn = fn, .arg = arg, .i = i};
+        #ifdef _WIN32
+        j->thread = CreateThread(NULL, 0, runjob, j, 0, NULL);
+        j->started = (j->thread != NULL);
+        #else
+        j->started = (pthread_create(&j->thread, NULL, runjob, j) == 0);
+        #endif // _WIN32
+    }
+
+    fn(arg, 0);
+    for (int i = 1; i < count; i++) {
+        Job* j = jobs + i;
+        if (!j->started) {
+            fn(arg, i);
+            continue;
+        }
+        #ifdef _WIN32
+        WaitForSingleObject(j->thread, INFINITE);
+        CloseHandle(j->thread);
+        #else
+        pthread_join(j->thread, NULL);
+        #endif // _WIN32
+    }
+    free(jobs);
+}
+
+#define HASH_K1 UINT64_C(0x9e3779b97f4a7c15)
+#define HASH_K2 UINT64_C(0xc2b2ae3d27d4eb4f)
+
+static uint64_t rotl64(uint64_t x, int n)
+{
+    return (x << n) | (x >> (64 - n));
+}
+
+uint64_t util_hash(const char* s, size_t len)
+{
+    // four independent lanes, so consecutive words don't wait on each other
+    uint64_t lanes[4] = {HASH_K1, HASH_K2, ~HASH_K1, ~HASH_K2};
+    size_t i = 0;
+    for (; len - i >= 32; i += 32) {
+        for (int j = 0; j < 4; j++) {
+            uint64_t w;
+            memcpy(&w, s + i + 8*j, 8);
+            lanes[j] = rotl64(lanes[j] ^ (w * HASH_K2), 31) * HASH_K1;
+        }
+    }
+
+    uint64_t h = len * HASH_K1;
+    for (int j = 0; j < 4; j++)
+        h = rotl64(h ^ lanes[j], 27) * HASH_K2;
+    for (; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * HASH_K1;
+
+    // final avalanche
+    h ^= h >> 33;
+    h *= HASH_K2;
+    h ^= h >> 29;
+    return h;
+}
+
 int util_digits(intmax_t x, bool negsign)
 {
     if (x == 0) return 1;
@@ -73,6 +310,54 @@ int util_fmtcentslen(intmax_t x)
     return len;
 }
 
+/* Two-digit decimal representations of 0 to 99. */
+static const char st_digitpairs[] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+int util_fmtint(intmax_t x, char* buf)
+{
+    // fill a temporary buffer from the right, two digits at a time
+    char tmp[sizeof "-9223372036854775808"];
+    char* p = tmp + sizeof tmp;
+    uintmax_t mag = (x < 0) ? -(uintmax_t)x : (uintmax_t)x;
+    for (; mag >= 100; mag /= 100) {
+        p -= 2;
+        memcpy(p, st_digitpairs + 2*(mag % 100), 2);
+    }
+    if (mag >= 10) {
+        p -= 2;
+        memcpy(p, st_digitpairs + 2*mag, 2);
+    } else {
+        *--p = '0' + mag;
+    }
+    if (x < 0)
+        *--p = '-';
+
+    int len = tmp + sizeof tmp - p;
+    memcpy(buf, p, len);
+    return len;
+}
+
+int util_fmtdecimal(intmax_t x, char* buf)
+{
+    uintmax_t mag = (x < 0) ? -(uintmax_t)x : (uintmax_t)x;
+    char* p = buf;
+    if (x < 0)
+        *p++ = '-';
+    p += util_fmtint(mag / 100, p);
+    *p++ = '.';
+    memcpy(p, st_digitpairs + 2*(mag % 100), 2);
+    return p + 2 - buf;
+}
+
+void util_fmtfixed(intmax_t x, int width, char* buf)
+{
+    for (int i = width - 1; i >= 0; i--, x /= 10)
+        buf[i] = '0' + x % 10;
+}
+
 long long util_stoi(const char* s, bool* status)
 {
     bool _;
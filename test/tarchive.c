@@ -0,0 +1,207 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "date.h"
+#include "record.h"
+#include "archive.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FN "_testarchive.bin"
+
+void test_roundtrip(void);
+void test_totals(void);
+void test_invalid(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_roundtrip();
+    test_totals();
+    test_invalid();
+    remove(FN);
+}
+
+
+// Helpers
+
+/* Write COUNT records dated in year Y as an archive, and read it back into
+a NUL-terminated allocated string whose length is stored in LEN. */
+char* writearchive(int y, const Record* recs, ptrdiff_t count, size_t* len)
+{
+    FILE* f = fopen(FN, "wb");
+    assert(ar_write(f, y, recs, count));
+    fclose(f);
+    f = fopen(FN, "rb");
+    FileView view;
+    assert(util_mapfile(f, &view));
+    fclose(f);
+    char* s = malloc(view.len + 1);
+    memcpy(s, view.data, view.len);
+    s[view.len] = '\0';
+    *len = view.len;
+    util_unmapfile(&view);
+    return s;
+}
+
+/* Open and decode the archive of LEN chars at S, and check it against the
+COUNT records at EXPECTED. */
+void assert_decodes(const char* s, size_t len, int y, const Record* expected, ptrdiff_t count)
+{
+    Archive ar;
+    assert(ar_open(&ar, s, len));
+    assert(ar.y == y && ar.count == count);
+    Record* recs = malloc((count + 1) * sizeof(*recs));
+    assert(ar_decode(&ar, recs) == 0);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        assert(recs[i].dt == expected[i].dt);
+        assert(recs[i].amt == expected[i].amt);
+        assert(STR_EQ(recs[i].cat, expected[i].cat));
+        assert(STR_EQ(recs[i].desc, expected[i].desc));
+    }
+    free(recs);
+}
+
+/* Parse the reference records dated in 1999 into RECS. Return their
+count. */
+ptrdiff_t refrecs1999(Record* recs)
+{
+    ptrdiff_t count = 0;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1) {
+        assert(rec_fromstrn(recs + count, line, eol - line));
+        count += (dt_gety(recs[count].dt) == 1999);
+    }
+    return count;
+}
+
+
+// Round Trip
+
+void test_roundtrip(void)
+{
+    log_intro("roundtrip");
+
+    // reference records, plus one with the longest allowed description
+    Record recs[11];
+    ptrdiff_t count = refrecs1999(recs);
+    char desc[REC_DESCLEN + 1];
+    memset(desc, 'x', sizeof desc - 1);
+    desc[sizeof desc - 1] = '\0';
+    assert(rec_init(recs + count++, 19991231, REC_AMT_MIN, "last", desc));
+
+    size_t len;
+    char* s = writearchive(1999, recs, count, &len);
+    log_cycle("%td records in %zu bytes", count, len);
+    assert_decodes(s, len, 1999, recs, count);
+    free(s);
+
+    // empty archive
+    s = writearchive(2000, recs, 0, &len);
+    assert_decodes(s, len, 2000, recs, 0);
+    free(s);
+
+    // a leap year's every day
+    Record* days = malloc(366 * sizeof(*days));
+    for (int i = 0; i < 366; i++)
+        assert(rec_init(days + i, dt_shiftd(20000101, i), (i % 2) ? i : -i - 1, "day", ""));
+    s = writearchive(2000, days, 366, &len);
+    assert_decodes(s, len, 2000, days, 366);
+    free(s);
+    free(days);
+    log_end();
+}
+
+
+// Totals
+
+void test_totals(void)
+{
+    log_intro("totals");
+    Record recs[10];
+    ptrdiff_t count = refrecs1999(recs);
+    size_t len;
+    char* s = writearchive(1999, recs, count, &len);
+    Archive ar;
+    assert(ar_open(&ar, s, len));
+
+    // Jan: abc 10 -20, xyz 1, def -100; Feb: xyz 700; Dec: xyz -600
+    assert(ar.ncats == 3 && ar.ntotals == 5);
+    ArTotal expected[] = {
+        {1, 0, 10, -20, 2},
+        {1, 1, 1, 0, 1},
+        {1, 2, 0, -100, 1},
+        {2, 1, 700, 0, 1},
+        {12, 1, 0, -600, 1},
+    };
+    for (ptrdiff_t i = 0; i < ar.ntotals; i++) {
+        ArTotal t = ar_total(&ar, i);
+        log_cycle("%d %s %lld %lld", t.m, ar_cat(&ar, t.cat), (long long)t.in, (long long)t.out);
+        assert(t.m == expected[i].m && t.cat == expected[i].cat);
+        assert(t.in == expected[i].in && t.out == expected[i].out);
+        assert(t.count == expected[i].count);
+    }
+    assert(STR_EQ(ar_cat(&ar, 0), "abc"));
+    assert(STR_EQ(ar_cat(&ar, 1), "xyz"));
+    assert(STR_EQ(ar_cat(&ar, 2), "def"));
+    free(s);
+    log_end();
+}
+
+
+// Invalid Archives
+
+void test_invalid(void)
+{
+    log_intro("invalid");
+    Record recs[3];
+    assert(rec_init(recs + 0, 19990101, 10, "abc", "first"));
+    assert(rec_init(recs + 1, 19990102, -5, "def", ""));
+    assert(rec_init(recs + 2, 19991231, 7, "abc", "third"));
+    Record out[3];
+    size_t len;
+    char* s = writearchive(1999, recs, 3, &len);
+    char* bad = malloc(len);
+    Archive ar;
+
+    // truncated, extended, or not an archive at all
+    assert(ar_open(&ar, s, len));
+    assert(!ar_open(&ar, s, len - 1));
+    assert(!ar_open(&ar, s, 7));
+    assert(!ar_open(&ar, REF_CONTENT, strlen(REF_CONTENT)));
+
+    // the header takes 56 bytes, followed by 3 totals of 32 bytes and 2
+    // category slots of 24 bytes; the first record's varints follow
+    size_t recs0 = 56 + 3*32 + 2*24;
+    assert(ar_open(&ar, s, len) && ar.recs == recs0);
+
+    // a total for month 13
+    memcpy(bad, s, len);
+    bad[56] = 13;
+    assert(!ar_open(&ar, bad, len));
+
+    // the first record dated 400 days into the year
+    memcpy(bad, s, len);
+    bad[recs0] = (char)0x90;
+    bad[recs0 + 1] = 0x03;
+    assert(ar_open(&ar, bad, len));
+    assert(ar_decode(&ar, out) == 1);
+
+    // the second record with a zero amount, then an unknown category
+    memcpy(bad, s, len);
+    assert(bad[recs0 + 4] == 1 && bad[recs0 + 5] == 9);
+    bad[recs0 + 5] = 0;
+    assert(ar_open(&ar, bad, len) && ar_decode(&ar, out) == 2);
+    bad[recs0 + 5] = 9;
+    bad[recs0 + 6] = 2;
+    assert(ar_decode(&ar, out) == 2);
+
+    assert(ar_open(&ar, s, len) && ar_decode(&ar, out) == 0);
+    assert(STR_EQ(out[2].desc, "third") && out[2].dt == 19991231);
+    free(bad);
+    free(s);
+    log_end();
+}
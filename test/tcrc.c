@@ -0,0 +1,75 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "t_framework.h"
+
+void test_vectors(void);
+void test_pieces(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_vectors();
+    test_pieces();
+}
+
+
+/* Check the checksum of the LEN chars at S with both implementations. */
+void assert_crc(const char* s, size_t len, uint32_t expected)
+{
+    bool hw = crc_sethw(true);
+    log_cycle("%08x (hw %d)", (unsigned)crc_32c(0, s, len), hw);
+    assert(crc_32c(0, s, len) == expected);
+    crc_sethw(false);
+    assert(crc_32c(0, s, len) == expected);
+    crc_sethw(true);
+}
+
+
+// Known Values
+
+void test_vectors(void)
+{
+    log_intro("vectors");
+    char buf[32];
+    assert_crc("", 0, 0);
+    assert_crc("123456789", 9, 0xe3069283);
+    memset(buf, 0, sizeof buf);
+    assert_crc(buf, sizeof buf, 0x8a9136aa);
+    for (int i = 0; i < 32; i++)
+        buf[i] = i;
+    assert_crc(buf, sizeof buf, 0x46dd794e);
+    log_end();
+}
+
+
+// Pieces
+// A checksum computed in pieces, including unaligned and partial words,
+// equals the checksum of the whole.
+
+void test_pieces(void)
+{
+    log_intro("pieces");
+    size_t len = 1000;
+    char* s = malloc(len);
+    for (size_t i = 0; i < len; i++)
+        s[i] = (char)(i * 131 + 7);
+    uint32_t wholes[2];
+    for (int hw = 0; hw < 2; hw++) {
+        crc_sethw(hw);
+        uint32_t whole = wholes[hw] = crc_32c(0, s, len);
+        for (size_t cut = 0; cut <= 17; cut++) {
+            uint32_t crc = crc_32c(0, s, cut);
+            crc = crc_32c(crc, s + cut, len - cut);
+            assert(crc == whole);
+        }
+        log_cycle("%08x", (unsigned)whole);
+    }
+    assert(wholes[0] == wholes[1]);
+    crc_sethw(true);
+    free(s);
+    log_end();
+}
@@ -45,6 +45,12 @@ void test_shift(void)
     assert(!dt_isdt(dt_shiftd(10101, -1)));
     assert(dt_shiftd(99991231, -300) == 99990306);
 
+    assert(dt_epochd(19700101) == 0);
+    assert(dt_epochd(19691231) == -1);
+    assert(dt_epochd(20000301) == 11017);
+    assert(dt_epochd(10101) == -719162);
+    assert(dt_epochd(99991231) == 2932896);
+
     log_end();
 }
 
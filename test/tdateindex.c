@@ -0,0 +1,155 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "dateindex.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+void test_build(void);
+void test_range(void);
+void test_io(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_build();
+    test_range();
+    test_io();
+}
+
+
+// Build
+
+void test_build(void)
+{
+    log_intro("build");
+    DateIndex di;
+    const char* s = REF_CONTENT;
+
+    assert(di_build(&di, s, strlen(s)));
+    assert(di.size == (int64_t)strlen(s));
+    assert(di.count == 6);
+    assert(di.entries[0].month == 199901 && di.entries[0].line == 0);
+    assert(di.entries[0].offset == 0);
+    assert(di.entries[1].month == 199902 && di.entries[1].line == 4);
+    assert(di.entries[1].offset == strstr(s, "1999-02-02") - s);
+    assert(di.entries[5].month == 201012 && di.entries[5].line == 8);
+    di_free(&di);
+
+    // empty file
+    assert(di_build(&di, "", 0));
+    assert(di.count == 0);
+    di_free(&di);
+
+    // bad date, out of order, and final line without newline
+    s = "1999-01-01\t1\ta\t\nbad\n";
+    assert(!di_build(&di, s, strlen(s)));
+    s = "1999-02-01\t1\ta\t\n1999-01-01\t1\ta\t\n";
+    assert(!di_build(&di, s, strlen(s)));
+    s = "1999-01-01\t1\ta\t\n1999-02-01\t1\ta\t";
+    assert(di_build(&di, s, strlen(s)));
+    assert(di.count == 2 && di.entries[1].offset == 16);
+    di_free(&di);
+    log_end();
+}
+
+
+// Range
+
+/* Return the number of lines before offset POS in S. */
+int64_t linesbefore(const char* s, int64_t pos)
+{
+    int64_t count = 0;
+    for (int64_t i = 0; i < pos; i++)
+        count += (s[i] == '\n');
+    return count;
+}
+
+void assert_range(const DateIndex* di, int32_t dt0, int32_t dt1, const char* first, const char* last)
+{
+    int64_t start, stop, line;
+    di_range(di, dt0, dt1, &start, &stop, &line);
+    log_cycle("%d %d: %lld %lld", dt0, dt1, (long long)start, (long long)stop);
+    if (first == NULL) {
+        assert(start == stop);
+        return;
+    }
+    const char* s = REF_CONTENT;
+    assert(start == strstr(s, first) - s);
+    assert(line == linesbefore(s, start));
+    const char* end = strstr(s, last);
+    assert(stop == strchr(end, '\n') + 1 - s);
+}
+
+void test_range(void)
+{
+    log_intro("range");
+    DateIndex di;
+    assert(di_build(&di, REF_CONTENT, strlen(REF_CONTENT)));
+    assert_range(&di, 19990115, 19990115, "1999-01-01", "1999-01-31");
+    assert_range(&di, 19990101, 19991231, "1999-01-01", "1999-12-31");
+    assert_range(&di, 19990301, 20011231, "1999-12-31", "2001-01-02");
+    assert_range(&di, 20100101, 20991231, "2010-01-02", "2010-12-03");
+    assert_range(&di, 20020101, 20091231, NULL, NULL);
+    assert_range(&di, 20110101, 20110101, NULL, NULL);
+    di_free(&di);
+    log_end();
+}
+
+
+// IO
+
+/* Write the SIZE chars of S to FN and try to load an index from it. */
+bool read_bytes(const char* fn, const char* s, size_t size)
+{
+    FILE* f = fopen(fn, "wb");
+    fwrite(s, 1, size, f);
+    fclose(f);
+    DateIndex di;
+    f = fopen(fn, "rb");
+    bool status = di_read(&di, f);
+    fclose(f);
+    if (status)
+        di_free(&di);
+    return status;
+}
+
+void test_io(void)
+{
+    log_intro("io");
+    const char* fn = "_testdateindex.bin";
+    DateIndex di, loaded;
+    assert(di_build(&di, REF_CONTENT, strlen(REF_CONTENT)));
+    di.mtime = 12345;
+
+    FILE* f = fopen(fn, "w+b");
+    assert(di_write(&di, f));
+    rewind(f);
+    char buf[1024];
+    size_t size = fread(buf, 1, sizeof buf, f);
+    rewind(f);
+    assert(di_read(&loaded, f));
+    fclose(f);
+
+    assert(loaded.size == di.size && loaded.mtime == 12345);
+    assert(loaded.count == di.count);
+    for (ptrdiff_t i = 0; i < di.count; i++) {
+        assert(loaded.entries[i].month == di.entries[i].month);
+        assert(loaded.entries[i].line == di.entries[i].line);
+        assert(loaded.entries[i].offset == di.entries[i].offset);
+    }
+    di_free(&loaded);
+
+    // truncated, extended and non-index files are rejected
+    assert(read_bytes(fn, buf, size));
+    assert(!read_bytes(fn, buf, size - 1));
+    buf[size] = 0;
+    assert(!read_bytes(fn, buf, size + 1));
+    assert(!read_bytes(fn, REF_CONTENT, strlen(REF_CONTENT)));
+
+    remove(fn);
+    di_free(&di);
+    log_end();
+}
@@ -0,0 +1,41 @@
+#include <assert.h>
+#include <string.h>
+
+#include "outbuf.h"
+#include "t_framework.h"
+
+void test_write(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_write();
+}
+
+void test_write(void)
+{
+    log_intro("write");
+    char* fn = "_testoutbuf.txt";
+    FILE* f = fopen(fn, "w");
+    fputs("head ", f);
+
+    // tiny capacity forces many flushes
+    OutBuf ob;
+    assert(ob_open(&ob, f, 4));
+    ob_write(&ob, "0123456789", 10);
+    char* p = ob_reserve(&ob, 3);
+    memcpy(p, "abc", 3);
+    ob_commit(&ob, 3);
+    ob_write(&ob, "", 0);
+    assert(ob_close(&ob));
+    fclose(f);
+
+    char buf[32] = {0};
+    f = fopen(fn, "r");
+    fread(buf, 1, sizeof buf - 1, f);
+    fclose(f);
+    remove(fn);
+    log_cycle("%s", buf);
+    assert(STR_EQ(buf, "head 0123456789abc"));
+    log_end();
+}
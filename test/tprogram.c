@@ -1,18 +1,30 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <assert.h>
 #include <limits.h>
 #include <stdint.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "util.h"
+#include "record.h"
+#include "recordlist.h"
 #include "program.h"
 #include "t_framework.h"
 
+#define DIR "_testprogram"
+
 void test_parsey(void);
 void test_parsedt(void);
+void test_convert(void);
 
 int main(int argc, char** argv)
 {
     TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
     test_parsey();
     test_parsedt();
+    test_convert();
 }
 
 
@@ -85,3 +97,65 @@ void test_parsedt(void)
 
     log_end();
 }
+
+
+// Convert
+
+/* Replace PROG_IDFN with one holding CONF, and load it. */
+void setconf(const char* conf)
+{
+    FILE* f = fopen(PROG_IDFN, "w");
+    assert(f);
+    fputs(conf, f);
+    assert(fclose(f) == 0);
+    prog_loadconf();
+}
+
+/* Journal the insertion of the record serialized as S. */
+void journalins(const char* s)
+{
+    Record rec;
+    assert(rec_fromstr(&rec, s));
+    assert(rl_insert(&rec));
+    prog_journalins(&rec);
+    assert(util_fexists(PROG_JOURNALFN));
+}
+
+/* util_lsdir callback. Remove NAME. */
+void removefile(void* arg, const char* name)
+{
+    (void)arg;
+    remove(name);
+}
+
+void test_convert(void)
+{
+    log_intro("convert");
+    assert(mkdir(DIR, 0777) == 0);
+    assert(chdir(DIR) == 0);
+
+    // journaled changes are written to the data file in use, so switching
+    // formats finds no journal for the new one
+    setconf("");
+    prog_initrl();
+    journalins("2020-01-01\t100\tfood\t");
+    prog_convert(PROG_FORMAT_BIN, PROG_BINFN);
+    assert(!util_fexists(PROG_JOURNALFN));
+    setconf("data_format=1\n");
+    prog_initrl();
+    assert(rl_count() == 1);
+    log_cycle("tsv to bin: %td", rl_count());
+
+    journalins("2021-01-01\t200\tgas\t");
+    prog_convert(PROG_FORMAT_YEARS, NULL);
+    assert(!util_fexists(PROG_JOURNALFN));
+    setconf("data_format=2\n");
+    prog_initrl();
+    assert(rl_count() == 2);
+    log_cycle("bin to years: %td", rl_count());
+
+    assert(util_lsdir(removefile, NULL));
+    assert(chdir("..") == 0);
+    assert(rmdir(DIR) == 0);
+    log_end();
+}
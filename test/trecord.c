@@ -6,11 +6,17 @@
 #include "t_framework.h"
 
 void test_general(void);
+void test_fromstrn(void);
+void test_diagnose(void);
+void test_columns(void);
 
 int main(int argc, char** argv)
 {
     TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
     test_general();
+    test_fromstrn();
+    test_diagnose();
+    test_columns();
 }
 
 void assert_general(const char* s, Record* rec)
@@ -48,3 +54,108 @@ void test_general(void)
     assert_general("2020-01-03\t4000\tmisc", NULL); // not enough delimiters
     log_end();
 }
+
+
+void assert_fromstrn(const char* s, size_t len, int64_t amt, const char* cat)
+{
+    log_cycle("%.*s", (int)len, s);
+    Record record;
+    if (amt == 0) {
+        assert(!rec_fromstrn(&record, s, len));
+        return;
+    }
+    assert(rec_fromstrn(&record, s, len));
+    assert(record.amt == amt);
+    assert(STR_EQ(record.cat, cat));
+}
+
+void test_fromstrn(void)
+{
+    log_intro("fromstrn");
+    const char* s = "2020-01-03\t 12\tMiSc\tx\ty\n2020-01-04";
+    assert_fromstrn(s, strlen("2020-01-03\t 12\tMiSc\tx\ty"), 12, "misc");
+    assert_fromstrn(s, strlen("2020-01-03\t 12\tMiSc"), 0, NULL);
+    assert_fromstrn("2020-01-03\t+7\ta\t", 16, 7, "a");
+    assert_fromstrn("2020-01-03\t-07\ta\t", 17, -7, "a");
+    assert_fromstrn("2020-01-03\t7 \ta\t", 16, 0, NULL);
+    assert_fromstrn("2020-01-03\t--7\ta\t", 17, 0, NULL);
+    assert_fromstrn("2020-02-30\t7\ta\t", 15, 0, NULL);
+    assert_fromstrn("2020-01-03\t100000000000001\ta\t", 29, 0, NULL);
+    assert_fromstrn("2020-01-03\t7\ta\0b\t", 17, 0, NULL);
+    log_end();
+}
+
+
+void assert_diagnose(const char* s, size_t len, enum rec_fault fault)
+{
+    log_cycle("%d: %.*s", (int)fault, (int)len, s);
+    assert(rec_diagnose(s, len) == fault);
+    Record record;
+    assert((rec_fromstrn(&record, s, len) != NULL) == (fault == REC_VALID));
+}
+
+void test_diagnose(void)
+{
+    log_intro("diagnose");
+    assert_diagnose("2020-01-03\t12\tmisc\tx", 20, REC_VALID);
+    assert_diagnose("2020-01-03\t12\tmisc", 18, REC_FAULT_FIELDS);
+    assert_diagnose("2020-02-30\t12\tmisc\t", 19, REC_FAULT_DATE);
+    assert_diagnose("2020-1-3\t12\tmisc\t", 17, REC_FAULT_DATE);
+    assert_diagnose("2020-01-03\t1.2\tmisc\t", 20, REC_FAULT_AMT);
+    assert_diagnose("2020-01-03\t-00\tmisc\t", 20, REC_FAULT_AMT);
+    assert_diagnose("2020-01-03\t-100000000000001\tmisc\t", 33, REC_FAULT_RANGE);
+    assert_diagnose("2020-01-03\t99999999999999999999999\tmisc\t", 40, REC_FAULT_RANGE);
+    assert_diagnose("2020-01-03\t12\t\t", 15, REC_FAULT_CAT);
+
+    char buf[REC_STRLEN + 2];
+    memset(buf, 'x', sizeof buf);
+    memcpy(buf, "2020-01-03\t12\tmisc\t", 19);
+    assert(rec_diagnose(buf, REC_STRLEN) == REC_VALID);
+    assert(rec_diagnose(buf, REC_STRLEN + 1) == REC_FAULT_LONG);
+    log_end();
+}
+
+
+void test_columns(void)
+{
+    log_intro("columns");
+    int32_t dts[2];
+    int64_t amts[2];
+    int32_t cats[2];
+    int64_t descoffs[2];
+    uint8_t desclens[2];
+    RecordCats dict;
+    RecordDescs arena = {0};
+    assert(rec_initcats(&dict));
+    RecordColumns cols = {dts, amts, cats, descoffs, desclens, &dict, &arena};
+    Record a, b;
+    rec_init(&a, 20200103, -4000, "misc", "stuff");
+    rec_init(&b, 20200104, 1, "x", "");
+    assert(rec_tocols(&b, &cols, 1));
+    assert(rec_tocols(&a, &cols, 0));
+    assert(dts[0] == 20200103 && amts[1] == 1);
+    assert(cats[0] == 1 && cats[1] == 0);
+    assert(STR_EQ(dict.names[cats[0]], "misc"));
+
+    // descriptions are appended to the arena without NULs
+    assert(arena.len == 5 && desclens[1] == 0 && desclens[0] == 5);
+    assert(descoffs[0] == 0 && memcmp(arena.chars, "stuff", 5) == 0);
+    assert(rec_putdescs(&arena, "abc", 3) == 5 && arena.len == 8);
+    assert(rec_reservedescs(&arena, 100000) && arena.cap >= 100008);
+
+    // ids are numbered in the order categories are first added
+    assert(dict.count == 2);
+    assert(rec_intern(&dict, "misc") == 1 && dict.count == 2);
+    assert(rec_intern(&dict, "y") == 2 && dict.count == 3);
+    assert(rec_catid(&dict, "x") == 0);
+    assert(rec_catid(&dict, "z") == -1);
+
+    Record rec;
+    assert(rec_fromcols(&rec, &cols, 0) == &rec);
+    assert(STR_EQ(rec_tostr(&rec), "2020-01-03\t-4000\tmisc\tstuff"));
+    rec_fromcols(&rec, &cols, 1);
+    assert(STR_EQ(rec_tostr(&rec), "2020-01-04\t1\tx\t"));
+    rec_freecats(&dict);
+    rec_freedescs(&arena);
+    log_end();
+}
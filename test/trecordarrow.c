@@ -0,0 +1,290 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "date.h"
+#include "hashtable.h"
+#include "record.h"
+#include "recordarrow.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FN "_testrecordarrow.arrow"
+
+void test_roundtrip(void);
+void test_select(void);
+void test_batches(void);
+void test_stream(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_roundtrip();
+    test_select();
+    test_batches();
+    test_stream();
+    remove(FN);
+}
+
+
+// Helpers
+//
+// Just enough of a flatbuffer and Arrow IPC file reader to find each
+// message's column buffers. Checking the output against a full Arrow
+// implementation is an optional step outside these tests: write a file with
+// "lgr export -a -F arrow > ledger.arrow" and open it with
+// pyarrow.ipc.open_file from an installed pyarrow.
+
+int32_t geti32(const char* p)
+{
+    int32_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+int64_t geti64(const char* p)
+{
+    int64_t n;
+    memcpy(&n, p, sizeof n);
+    return n;
+}
+
+/* Return a pointer to field ID of the table at T, or NULL if absent. */
+const char* fbfield(const char* t, int id)
+{
+    const char* vt = t - geti32(t);
+    uint16_t vtlen, off = 0;
+    memcpy(&vtlen, vt, 2);
+    if (4 + 2*id < vtlen)
+        memcpy(&off, vt + 4 + 2*id, 2);
+    return off ? t + off : NULL;
+}
+
+/* Follow the offset at P. */
+const char* fbref(const char* p)
+{
+    return p + geti32(p);
+}
+
+/* A message's record batch, with pointers to its body's buffers. */
+typedef struct {
+    int64_t length;
+    int nbufs;
+    const char* bufs[16];
+    int64_t lens[16];
+} Batch;
+
+/* Read the message in S at the file block at BLOCK into BATCH. The message
+is a dictionary batch if ISDICT. */
+void readbatch(const char* s, const char* block, bool isdict, Batch* batch)
+{
+    const char* msg = s + geti64(block);
+    int32_t metalen = geti32(block + 8);
+    assert(metalen % 8 == 0 && (msg - s) % 8 == 0);
+    assert((uint32_t)geti32(msg) == 0xffffffff && geti32(msg + 4) == metalen - 8);
+    const char* body = msg + metalen;
+
+    const char* root = fbref(msg + 8);
+    assert(*fbfield(root, 1) == (isdict ? 2 : 3));
+    const char* header = fbref(fbfield(root, 2));
+    assert(geti64(fbfield(root, 3)) == geti64(block + 16));
+    const char* rb = isdict ? fbref(fbfield(header, 1)) : header;
+
+    batch->length = geti64(fbfield(rb, 0));
+    const char* bufs = fbref(fbfield(rb, 2));
+    batch->nbufs = geti32(bufs);
+    for (int i = 0; i < batch->nbufs; i++) {
+        int64_t off = geti64(bufs + 4 + 16*i);
+        assert(off % 8 == 0);
+        batch->bufs[i] = body + off;
+        batch->lens[i] = geti64(bufs + 4 + 16*i + 8);
+    }
+}
+
+/* Check that string I of a utf8 column with OFFSETS and DATA equals S. */
+void assert_str(const char* offsets, const char* data, int64_t i, const char* s)
+{
+    int32_t start = geti32(offsets + 4*i);
+    int32_t stop = geti32(offsets + 4*(i + 1));
+    assert(stop - start == (int32_t)strlen(s));
+    assert(memcmp(data + start, s, stop - start) == 0);
+}
+
+/* Write COUNT records as for ra_write and check the file against them. */
+void assert_roundtrip(const Record* recs, const ptrdiff_t* sel, ptrdiff_t count)
+{
+    FILE* f = fopen(FN, "wb");
+    assert(ra_write(f, recs, sel, count));
+    fclose(f);
+    FileView view;
+    f = fopen(FN, "rb");
+    assert(util_mapfile(f, &view));
+    fclose(f);
+    const char* s = view.data;
+    size_t len = view.len;
+    log_cycle("%td records in %zu bytes", count, len);
+
+    // magic at both ends, then the footer
+    assert(memcmp(s, "ARROW1\0\0", 8) == 0);
+    assert(memcmp(s + len - 6, "ARROW1", 6) == 0);
+    int32_t footerlen = geti32(s + len - 10);
+    const char* footer = fbref(s + len - 10 - footerlen);
+    const char* dicts = fbref(fbfield(footer, 2));
+    const char* batches = fbref(fbfield(footer, 3));
+    assert(geti32(dicts) == 1);
+    assert(geti32(batches) == (count + RA_BATCHLEN - 1) / RA_BATCHLEN);
+
+    // category dictionary
+    Batch dict;
+    readbatch(s, dicts + 4, true, &dict);
+    assert(dict.nbufs == 3 && dict.lens[0] == 0);
+    assert(dict.lens[1] == 4 * (dict.length + 1));
+
+    // columns
+    ptrdiff_t i = 0;
+    for (int32_t b = 0; b < geti32(batches); b++) {
+        Batch batch;
+        readbatch(s, batches + 4 + 24*b, false, &batch);
+        assert(batch.nbufs == 9);
+        for (int64_t j = 0; j < batch.length; j++, i++) {
+            const Record* rec = sel ? recs + sel[i] : recs + i;
+            assert(geti32(batch.bufs[1] + 4*j) == dt_epochd(rec->dt));
+            assert(geti64(batch.bufs[3] + 8*j) == rec->amt);
+            int32_t id = geti32(batch.bufs[5] + 4*j);
+            assert(id >= 0 && id < dict.length);
+            assert_str(dict.bufs[1], dict.bufs[2], id, rec->cat);
+            assert_str(batch.bufs[7], batch.bufs[8], j, rec->desc);
+        }
+    }
+    assert(i == count);
+    util_unmapfile(&view);
+}
+
+/* Parse the reference records into RECS. Return their count. */
+ptrdiff_t refrecs(Record* recs)
+{
+    ptrdiff_t count = 0;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1)
+        assert(rec_fromstrn(recs + count++, line, eol - line));
+    return count;
+}
+
+
+// Round Trip
+
+void test_roundtrip(void)
+{
+    log_intro("roundtrip");
+    Record recs[10];
+    ptrdiff_t count = refrecs(recs);
+    assert_roundtrip(recs, NULL, count);
+    assert_roundtrip(recs, NULL, 0);
+    log_end();
+}
+
+
+// Selection
+
+void test_select(void)
+{
+    log_intro("select");
+    Record recs[10];
+    refrecs(recs);
+    ptrdiff_t sel[] = {1, 3, 4, 9};
+    assert_roundtrip(recs, sel, 4);
+    log_end();
+}
+
+
+// Multiple Batches
+
+void test_batches(void)
+{
+    log_intro("batches");
+    ptrdiff_t count = 2*RA_BATCHLEN + 3;
+    Record* recs = malloc(count * sizeof(*recs));
+    for (ptrdiff_t i = 0; i < count; i++) {
+        char cat[32];
+        sprintf(cat, "cat%td", i % 1000);
+        assert(rec_init(recs + i, dt_shiftd(19000101, i / 100), i + 1, cat, (i % 3) ? "desc" : ""));
+    }
+    assert_roundtrip(recs, NULL, count);
+    free(recs);
+    log_end();
+}
+
+
+// Streaming
+
+/* Read FN into an allocated buffer, storing its length in LEN. */
+char* readfile(size_t* len)
+{
+    FILE* f = fopen(FN, "rb");
+    FileView view;
+    assert(util_mapfile(f, &view));
+    fclose(f);
+    char* s = malloc(view.len);
+    memcpy(s, view.data, view.len);
+    *len = view.len;
+    util_unmapfile(&view);
+    return s;
+}
+
+/* Write the COUNT records at RECS with ra_open, in batches of at most
+BATCHLEN records. */
+void writestream(const Record* recs, ptrdiff_t count, ptrdiff_t batchlen)
+{
+    HashTable* cats = ht_new(HT_STR);
+    for (ptrdiff_t i = 0; i < count; i++)
+        assert(ht_insert(cats, recs[i].cat, ht_count(cats)));
+    FILE* f = fopen(FN, "wb");
+    RaFile* ra = ra_open(f, cats);
+    assert(ra);
+    for (ptrdiff_t start = 0; start < count; start += batchlen)
+        ra_append(ra, recs + start, (count - start < batchlen) ? count - start : batchlen);
+    assert(ra_close(ra));
+    fclose(f);
+    ht_free(cats);
+}
+
+void test_stream(void)
+{
+    log_intro("stream");
+    Record recs[10];
+    ptrdiff_t count = refrecs(recs);
+
+    // a single batch makes the same file as ra_write
+    FILE* f = fopen(FN, "wb");
+    assert(ra_write(f, recs, NULL, count));
+    fclose(f);
+    size_t len, streamlen;
+    char* expected = readfile(&len);
+    writestream(recs, count, count);
+    char* s = readfile(&streamlen);
+    assert(streamlen == len && memcmp(s, expected, len) == 0);
+    free(s);
+    free(expected);
+
+    // batches of 3, 3, 3 and 1 records
+    writestream(recs, count, 3);
+    s = readfile(&len);
+    int32_t footerlen = geti32(s + len - 10);
+    const char* footer = fbref(s + len - 10 - footerlen);
+    const char* batches = fbref(fbfield(footer, 3));
+    assert(geti32(batches) == 4);
+    ptrdiff_t i = 0;
+    for (int32_t b = 0; b < 4; b++) {
+        Batch batch;
+        readbatch(s, batches + 4 + 24*b, false, &batch);
+        log_cycle("batch %d: %lld records", (int)b, (long long)batch.length);
+        assert(batch.length == ((b < 3) ? 3 : 1));
+        for (int64_t j = 0; j < batch.length; j++, i++)
+            assert(geti64(batch.bufs[3] + 8*j) == recs[i].amt);
+    }
+    free(s);
+    log_end();
+}
@@ -0,0 +1,287 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "record.h"
+#include "recordbin.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FN "_testrecordbin.bin"
+
+void test_roundtrip(void);
+void test_manycats(void);
+void test_blocks(void);
+void test_invalid(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_roundtrip();
+    test_manycats();
+    test_blocks();
+    test_invalid();
+    remove(FN);
+}
+
+
+// Helpers
+
+/* Allocate columns with room for COUNT records, copying RECS into them
+unless RECS is NULL. */
+RecordColumns newcols(const Record* recs, ptrdiff_t count)
+{
+    RecordColumns cols = {
+        malloc((count + 1) * sizeof(*cols.dt)),
+        malloc((count + 1) * sizeof(*cols.amt)),
+        malloc((count + 1) * sizeof(*cols.cat)),
+        malloc((count + 1) * sizeof(*cols.descoff)),
+        malloc((count + 1) * sizeof(*cols.desclen)),
+        malloc(sizeof(*cols.cats)),
+        calloc(1, sizeof(*cols.descs)),
+    };
+    assert(cols.dt && cols.amt && cols.cat && cols.descoff && cols.desclen);
+    assert(cols.cats && cols.descs && rec_initcats(cols.cats));
+    for (ptrdiff_t i = 0; recs && i < count; i++)
+        assert(rec_tocols(recs + i, &cols, i));
+    return cols;
+}
+
+void freecols(RecordColumns* cols)
+{
+    free(cols->dt);
+    free(cols->amt);
+    free(cols->cat);
+    free(cols->descoff);
+    free(cols->desclen);
+    rec_freecats(cols->cats);
+    free(cols->cats);
+    rec_freedescs(cols->descs);
+    free(cols->descs);
+}
+
+/* Write COUNT records as an image and map it into VIEW. */
+void writeimage(const Record* recs, ptrdiff_t count, FileView* view)
+{
+    RecordColumns cols = newcols(recs, count);
+    FILE* f = fopen(FN, "wb");
+    assert(rb_write(f, &cols, &count, 1));
+    fclose(f);
+    freecols(&cols);
+    f = fopen(FN, "rb");
+    assert(util_mapfile(f, view));
+    fclose(f);
+}
+
+/* Decode VIEW and check it against the COUNT records at EXPECTED. */
+void assert_decodes(const FileView* view, const Record* expected, ptrdiff_t count)
+{
+    assert(rb_count(view->data, view->len) == count);
+    RecordColumns cols = newcols(NULL, count);
+    assert(rb_decode(view->data, view->len, &cols, &count, 1) == 0);
+    for (ptrdiff_t i = 0; i < count; i++) {
+        Record rec;
+        rec_fromcols(&rec, &cols, i);
+        assert(rec.dt == expected[i].dt);
+        assert(rec.amt == expected[i].amt);
+        assert(STR_EQ(rec.cat, expected[i].cat));
+        assert(STR_EQ(rec.desc, expected[i].desc));
+    }
+    freecols(&cols);
+}
+
+
+// Round Trip
+
+void test_roundtrip(void)
+{
+    log_intro("roundtrip");
+
+    // reference records, plus one with the longest allowed description
+    Record recs[11];
+    ptrdiff_t count = 0;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1)
+        assert(rec_fromstrn(recs + count++, line, eol - line));
+    char desc[REC_DESCLEN + 16];
+    memset(desc, 'x', sizeof desc - 1);
+    desc[sizeof desc - 1] = '\0';
+    assert(rec_init(recs + count++, 20991231, 1, "last", desc));
+    assert(strlen(recs[count-1].desc) == REC_DESCLEN);
+
+    FileView view;
+    writeimage(recs, count, &view);
+    log_cycle("%zu bytes", view.len);
+    assert_decodes(&view, recs, count);
+    util_unmapfile(&view);
+
+    // empty list
+    writeimage(recs, 0, &view);
+    assert_decodes(&view, recs, 0);
+    util_unmapfile(&view);
+    log_end();
+}
+
+
+// Many Categories
+
+void test_manycats(void)
+{
+    log_intro("manycats");
+
+    // more categories than fit in 16-bit ids
+    ptrdiff_t count = 70000;
+    Record* recs = malloc(count * sizeof(*recs));
+    for (ptrdiff_t i = 0; i < count; i++) {
+        char cat[32];
+        sprintf(cat, "cat%td", i);
+        assert(rec_init(recs + i, 20000101 + i / 10000 * 100, i + 1, cat, ""));
+    }
+
+    FileView view;
+    writeimage(recs, count, &view);
+    assert_decodes(&view, recs, count);
+    util_unmapfile(&view);
+    free(recs);
+    log_end();
+}
+
+
+// Blocks
+
+/* Allocate columns with room for COUNT records that share the dictionary
+and arena of SHARED. */
+RecordColumns sharecols(const RecordColumns* shared, ptrdiff_t count)
+{
+    RecordColumns cols = {
+        malloc(count * sizeof(*cols.dt)),
+        malloc(count * sizeof(*cols.amt)),
+        malloc(count * sizeof(*cols.cat)),
+        malloc(count * sizeof(*cols.descoff)),
+        malloc(count * sizeof(*cols.desclen)),
+        shared->cats,
+        shared->descs,
+    };
+    assert(cols.dt && cols.amt && cols.cat && cols.descoff && cols.desclen);
+    return cols;
+}
+
+/* Free columns allocated by sharecols. */
+void freesharedcols(RecordColumns* cols)
+{
+    free(cols->dt);
+    free(cols->amt);
+    free(cols->cat);
+    free(cols->descoff);
+    free(cols->desclen);
+}
+
+void test_blocks(void)
+{
+    log_intro("blocks");
+    Record recs[10];
+    ptrdiff_t count = 0;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1)
+        assert(rec_fromstrn(recs + count++, line, eol - line));
+
+    // written from blocks of 3, 3 and 4 records
+    ptrdiff_t counts[] = {3, 3, 4};
+    RecordColumns blocks[3];
+    blocks[0] = newcols(NULL, 3);
+    blocks[1] = sharecols(blocks, 3);
+    blocks[2] = sharecols(blocks, 4);
+    for (ptrdiff_t i = 0, k = 0, pos = 0; i < count; i++, pos++) {
+        if (pos == counts[k])
+            k++, pos = 0;
+        assert(rec_tocols(recs + i, blocks + k, pos));
+    }
+    FILE* f = fopen(FN, "wb");
+    assert(rb_write(f, blocks, counts, 3));
+    fclose(f);
+    FileView view;
+    f = fopen(FN, "rb");
+    assert(util_mapfile(f, &view));
+    fclose(f);
+    assert_decodes(&view, recs, count);
+
+    // decoded into blocks of 7 and 3 records
+    ptrdiff_t outcounts[] = {7, 3};
+    RecordColumns out[2];
+    out[0] = newcols(NULL, 7);
+    out[1] = sharecols(out, 3);
+    assert(rb_decode(view.data, view.len, out, outcounts, 2) == 0);
+    for (ptrdiff_t i = 0, k = 0, pos = 0; i < count; i++, pos++) {
+        if (pos == outcounts[k])
+            k++, pos = 0;
+        Record rec;
+        rec_fromcols(&rec, out + k, pos);
+        assert(rec.dt == recs[i].dt && rec.amt == recs[i].amt);
+        assert(STR_EQ(rec.cat, recs[i].cat) && STR_EQ(rec.desc, recs[i].desc));
+    }
+    util_unmapfile(&view);
+
+    freesharedcols(blocks + 1);
+    freesharedcols(blocks + 2);
+    freecols(blocks);
+    freesharedcols(out + 1);
+    freecols(out);
+    log_end();
+}
+
+
+// Invalid Images
+
+void test_invalid(void)
+{
+    log_intro("invalid");
+    Record recs[3];
+    assert(rec_init(recs + 0, 19990101, 10, "abc", "first"));
+    assert(rec_init(recs + 1, 19990102, -5, "def", ""));
+    assert(rec_init(recs + 2, 19990103, 7, "abc", "third"));
+    ptrdiff_t count = 3;
+    RecordColumns out = newcols(NULL, count);
+
+    FileView view;
+    writeimage(recs, 3, &view);
+    char* s = malloc(view.len);
+    size_t len = view.len;
+    memcpy(s, view.data, len);
+    util_unmapfile(&view);
+
+    // truncated, extended, or not an image at all
+    assert(rb_count(s, len) == 3);
+    assert(rb_count(s, len - 1) == -1);
+    assert(rb_count(s, 7) == -1);
+    assert(rb_count(REF_CONTENT, strlen(REF_CONTENT)) == -1);
+
+    // zero amount in the second record; the header takes 40 bytes and is
+    // followed by the amount and date columns
+    char* bad = malloc(len);
+    memcpy(bad, s, len);
+    int64_t zero = 0;
+    memcpy(bad + 40 + 8, &zero, sizeof zero);
+    assert(rb_count(bad, len) == 3);
+    assert(rb_decode(bad, len, &out, &count, 1) == 2);
+    assert(out.descs->len == 0);
+
+    // third record dated before the second
+    memcpy(bad, s, len);
+    int32_t early = 19990102;
+    memcpy(bad + 40 + 3*8 + 2*4, &early, sizeof early);
+    assert(rb_decode(bad, len, &out, &count, 1) == 0);
+    early = 19990101;
+    memcpy(bad + 40 + 3*8 + 2*4, &early, sizeof early);
+    assert(rb_decode(bad, len, &out, &count, 1) == 3);
+
+    assert(rb_decode(s, len, &out, &count, 1) == 0);
+    Record rec;
+    rec_fromcols(&rec, &out, 2);
+    assert(STR_EQ(rec.desc, "third") && STR_EQ(rec.cat, "abc"));
+    freecols(&out);
+    free(bad);
+    free(s);
+    log_end();
+}
@@ -0,0 +1,247 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "record.h"
+#include "recordcheck.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FN "_testrecordcheck.bin"
+
+void test_clean(void);
+void test_issues(void);
+void test_recheck(void);
+void test_threads(void);
+void test_io(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_clean();
+    test_issues();
+    test_recheck();
+    test_threads();
+    test_io();
+    remove(FN);
+}
+
+
+/* Check S with the blocks of PREV, if any, on a single thread. */
+void check(const char* s, const RcResult* prev, RcResult* res)
+{
+    assert(rc_check(s, strlen(s), prev ? prev->blocks : NULL, prev ? prev->nblocks : 0, 1, res));
+    log_cycle("%td issues, %td blocks, %lld of %lld lines parsed", res->nissues,
+        res->nblocks, (long long)res->parsed, (long long)res->lines);
+}
+
+
+// Clean Lists
+
+void test_clean(void)
+{
+    log_intro("clean");
+    RcResult res;
+    check(REF_CONTENT, NULL, &res);
+    assert(res.nissues == 0 && res.lines == 10 && res.parsed == 10);
+
+    // one block per month
+    int32_t dt0s[] = {19990101, 19990202, 19991231, 20010102, 20100102, 20101202};
+    int64_t lines[] = {4, 1, 1, 1, 1, 2};
+    assert(res.nblocks == 6);
+    int64_t len = 0;
+    for (ptrdiff_t i = 0; i < res.nblocks; i++) {
+        assert(res.blocks[i].dt0 == dt0s[i]);
+        assert(res.blocks[i].lines == lines[i]);
+        len += res.blocks[i].len;
+    }
+    assert(res.blocks[0].dt1 == 19990131 && res.blocks[5].dt1 == 20101203);
+    assert(len == (int64_t)strlen(REF_CONTENT));
+    rc_free(&res);
+
+    check("", NULL, &res);
+    assert(res.nissues == 0 && res.lines == 0 && res.nblocks == 0);
+    rc_free(&res);
+    log_end();
+}
+
+
+// Issues
+
+void test_issues(void)
+{
+    log_intro("issues");
+    const char* s =
+        "2000-01-05\t1\ta\t\n"
+        "2000-01-04\t1\ta\t\n"                      // 2: unsorted in block
+        "2000-01-04\t100000000000001\ta\t\n"        // 3: range
+        "2000-02-01\t1\ta\t\n"
+        "garbage\n"                                 // 5: fields
+        "2000-02-30\t1\ta\t\n"                      // 6: date
+        "2000-03-01\t1.5\ta\t\n"                    // 7: amount
+        "2000-03-02\t1\ta\t\n"
+        "2000-02-15\t1\ta\t\n"                      // 9: unsorted across blocks
+        "2000-02-16\t1\t\tx\n"                      // 10: category
+        "2000-04-01\t1\ta\t";                       // valid, no newline
+    RcResult res;
+    check(s, NULL, &res);
+    RcIssue expected[] = {
+        {2, RC_UNSORTED},
+        {3, REC_FAULT_RANGE},
+        {5, REC_FAULT_FIELDS},
+        {6, REC_FAULT_DATE},
+        {7, REC_FAULT_AMT},
+        {9, RC_UNSORTED},
+        {10, REC_FAULT_CAT},
+    };
+    assert(res.lines == 11);
+    assert(res.nissues == sizeof expected / sizeof *expected);
+    for (ptrdiff_t i = 0; i < res.nissues; i++) {
+        log_cycle("line %lld: %d", (long long)res.issues[i].line, res.issues[i].kind);
+        assert(res.issues[i].line == expected[i].line);
+        assert(res.issues[i].kind == expected[i].kind);
+    }
+
+    // only line 4's block is kept; the rest have issues, or no newline
+    assert(res.nblocks == 1);
+    assert(res.blocks[0].dt0 == 20000201 && res.blocks[0].lines == 1);
+    rc_free(&res);
+    log_end();
+}
+
+
+// Rechecking
+
+void test_recheck(void)
+{
+    log_intro("recheck");
+    RcResult first, res;
+    check(REF_CONTENT, NULL, &first);
+
+    // unchanged
+    check(REF_CONTENT, &first, &res);
+    assert(res.nissues == 0 && res.parsed == 0 && res.lines == 10);
+    assert(res.nblocks == first.nblocks);
+    assert(memcmp(res.blocks, first.blocks, res.nblocks * sizeof(*res.blocks)) == 0);
+    rc_free(&res);
+
+    // a line added to the end of February is parsed on its own, since the
+    // old February block still matches the chars before it
+    char buf[1024];
+    const char* feb = strstr(REF_CONTENT, "1999-12-31");
+    sprintf(buf, "%.*s1999-02-03\t5\tx\t\n%s", (int)(feb - REF_CONTENT), REF_CONTENT, feb);
+    check(buf, &first, &res);
+    assert(res.nissues == 0 && res.parsed == 1 && res.lines == 11);
+    assert(res.nblocks == 7 && res.blocks[2].lines == 1 && res.blocks[2].dt0 == 19990203);
+    rc_free(&res);
+
+    // a line added to the start of February parses February
+    feb = strstr(REF_CONTENT, "1999-02-02");
+    sprintf(buf, "%.*s1999-02-01\t5\tx\t\n%s", (int)(feb - REF_CONTENT), REF_CONTENT, feb);
+    check(buf, &first, &res);
+    assert(res.nissues == 0 && res.parsed == 2 && res.lines == 11);
+    assert(res.nblocks == 6 && res.blocks[1].lines == 2 && res.blocks[1].dt1 == 19990202);
+    rc_free(&res);
+
+    // a changed month is parsed, and its lines compared with the blocks
+    // around it
+    strcpy(buf, REF_CONTENT);
+    memcpy(strstr(buf, "1999-12-31"), "1999-12-01", 10);
+    memcpy(strstr(buf, "2001-01-02"), "2001-01-01", 10);
+    check(buf, &first, &res);
+    assert(res.nissues == 0 && res.parsed == 2);
+    rc_free(&res);
+    memcpy(strstr(buf, "2001-01-01"), "1998-01-01", 10);
+    check(buf, &first, &res);
+    assert(res.nissues == 1 && res.issues[0].line == 7);
+    assert(res.issues[0].kind == RC_UNSORTED);
+    rc_free(&res);
+
+    rc_free(&first);
+    log_end();
+}
+
+
+// Threads
+
+void test_threads(void)
+{
+    log_intro("threads");
+
+    // a few large months, each split into several blocks, and a bad line
+    // near the end
+    ptrdiff_t count = 300000;
+    char* s = malloc(count * 32);
+    size_t len = 0;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        int32_t dt = dt_shiftd(20000101, i / 3000);
+        len += sprintf(s + len, "%s\t%td\tcat%td\t\n", dt_toiso(dt), i + 1, i % 7);
+    }
+    char* bad = strstr(s + len - 100, "\tcat") + 1;
+    *bad = '\t';
+    int64_t badline = 1;
+    for (char* p = s; p < bad; p++)
+        badline += (*p == '\n');
+
+    RcResult one, many;
+    assert(rc_check(s, len, NULL, 0, 1, &one));
+    assert(rc_check(s, len, NULL, 0, 4, &many));
+    log_cycle("%td blocks", one.nblocks);
+    assert(one.lines == count && many.lines == count);
+    assert(one.nissues == 1 && many.nissues == 1);
+    assert(one.issues[0].line == badline && many.issues[0].line == badline);
+    assert(one.issues[0].kind == REC_FAULT_CAT);
+    assert(one.nblocks == many.nblocks && one.nblocks > 4);
+    assert(memcmp(one.blocks, many.blocks, one.nblocks * sizeof(*one.blocks)) == 0);
+    rc_free(&one);
+
+    assert(rc_check(s, len, many.blocks, many.nblocks, 4, &one));
+    assert(one.nissues == 1 && one.parsed < count / 4);
+    rc_free(&one);
+    rc_free(&many);
+    free(s);
+    log_end();
+}
+
+
+// IO
+
+void test_io(void)
+{
+    log_intro("io");
+    RcResult res;
+    check(REF_CONTENT, NULL, &res);
+    FILE* f = fopen(FN, "wb");
+    assert(rc_write(res.blocks, res.nblocks, f));
+    fclose(f);
+
+    RcBlock* blocks;
+    ptrdiff_t count;
+    f = fopen(FN, "rb");
+    assert(rc_read(&blocks, &count, f));
+    fclose(f);
+    assert(count == res.nblocks);
+    assert(memcmp(blocks, res.blocks, count * sizeof(*blocks)) == 0);
+    free(blocks);
+
+    // trailing data
+    f = fopen(FN, "ab");
+    putc('x', f);
+    fclose(f);
+    f = fopen(FN, "rb");
+    assert(!rc_read(&blocks, &count, f));
+    assert(blocks == NULL && count == 0);
+    fclose(f);
+
+    // not saved blocks
+    f = fopen(FN, "wb");
+    fputs(REF_CONTENT, f);
+    fclose(f);
+    f = fopen(FN, "rb");
+    assert(!rc_read(&blocks, &count, f));
+    fclose(f);
+    rc_free(&res);
+    log_end();
+}
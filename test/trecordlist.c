@@ -1,4 +1,6 @@
 #include <assert.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/stat.h>
 
 #include "date.h"
@@ -7,9 +9,15 @@
 #include "t_refrecs.h"
 
 void test_getters(FILE* f);
+void test_initerr(void);
+void test_threads(void);
+void test_range(FILE* f);
 void test_write(FILE* f);
+void test_append(FILE* f);
 void test_slice(FILE* f);
 void test_insdel(FILE* f);
+void test_insmany(FILE* f);
+void test_blocks(void);
 void test_filter(FILE* f);
 
 int main(int argc, char** argv)
@@ -20,9 +28,15 @@ int main(int argc, char** argv)
     FILE* f = ref_mkfile();
 
     test_getters(f);
+    test_initerr();
+    test_threads();
+    test_range(f);
     test_write(f);
+    test_append(f);
     test_slice(f);
     test_insdel(f);
+    test_insmany(f);
+    test_blocks();
     test_filter(f);
 
     // teardown
@@ -40,11 +54,166 @@ void test_getters(FILE* f)
     assert(rl_slicestart() == 0);
     assert(rl_slicestop() == 10);
     assert(rl_slicecount() == 10);
+    assert(rl_get(-1) == NULL && rl_get(10) == NULL);
+
+    // spans and copies agree with rl_get
+    RlSpan span = rl_span(2, 9);
+    Record recs[7];
+    rl_copy(2, 9, recs);
+    assert(span.len == 7);
+    for (ptrdiff_t i = 0; i < span.len; i++) {
+        const Record* rec = rl_get(2 + i);
+        assert(span.dt[i] == rec->dt && span.amt[i] == rec->amt);
+        assert(STR_EQ(rl_catname(span.cat[i]), rec->cat));
+        assert(span.desclen[i] == strlen(rec->desc));
+        assert(memcmp(span.descs + span.descoff[i], rec->desc, span.desclen[i]) == 0);
+        assert(recs[i].dt == rec->dt && recs[i].amt == rec->amt);
+        assert(STR_EQ(recs[i].cat, rec->cat) && STR_EQ(recs[i].desc, rec->desc));
+    }
+    assert(rl_span(4, 4).len == 0);
+
+    // category ids are numbered in order of first appearance
+    int32_t ncats = 0;
+    for (ptrdiff_t i = 0; i < rl_count(); i++) {
+        int32_t id = rl_span(i, i + 1).cat[0];
+        assert(id <= ncats);
+        ncats += (id == ncats);
+    }
+    assert(rl_catcount() == ncats);
     rl_deinit();
     log_end();
 }
 
 
+// Init Errors
+
+/* Initialize from a temporary file containing CONTENT. */
+ptrdiff_t init_content(const char* content)
+{
+    char* fn = "_testelist_initerr.txt";
+    FILE* f = fopen(fn, "w");
+    fputs(content, f);
+    fclose(f);
+    f = fopen(fn, "r");
+    ptrdiff_t status = rl_init(f);
+    fclose(f);
+    remove(fn);
+    return status;
+}
+
+void test_initerr(void)
+{
+    log_intro("init errors");
+
+    // final line without newline
+    assert(init_content("1999-01-01\t10\tabc\t\n1999-01-02\t5\tabc\tx") == 0);
+    assert(rl_count() == 2);
+    assert(rl_get(1)->dt == 19990102);
+    rl_deinit();
+
+    assert(init_content("") == 0);
+    assert(rl_count() == 0);
+    rl_deinit();
+
+    // line numbers of bad lines
+    assert(init_content("1999-01-01\t10\tabc\t\n\n") == 2);
+    assert(init_content("1999-01-01\t10\tabc\t\n1999-01-01\t0\tabc\t\n") == 2);
+    char longline[REC_STRLEN + 32] = "1999-01-01\t10\tabc\t";
+    memset(longline + strlen(longline), 'x', REC_STRLEN);
+    longline[REC_STRLEN + 1] = '\0';
+    assert(init_content(longline) == 1);
+    longline[REC_STRLEN] = '\0';
+    assert(init_content(longline) == 0);
+    rl_deinit();
+
+    log_end();
+}
+
+
+// Threads
+
+void test_threads(void)
+{
+    log_intro("threads");
+
+    // large enough to be split among several threads
+    ptrdiff_t lines = 200000;
+    size_t linelen = sizeof "2000-01-01\t1\tabc\tdescription" - 1 + 1;
+    char* content = malloc(lines * linelen + 1);
+    for (ptrdiff_t i = 0; i < lines; i++)
+        memcpy(content + i*linelen, "2000-01-01\t1\tabc\tdescription\n", linelen);
+    content[lines * linelen] = '\0';
+    memcpy(content + (lines - 1)*linelen + 13, "xyz", 3);
+
+    rl_setthreads(4);
+    assert(init_content(content) == 0);
+    assert(rl_count() == lines);
+    assert(STR_EQ(rl_get(lines - 1)->desc, "description"));
+
+    // each thread's categories are renumbered in order of first appearance
+    assert(rl_catcount() == 2);
+    assert(STR_EQ(rl_catname(0), "abc") && STR_EQ(rl_catname(1), "xyz"));
+    assert(STR_EQ(rl_get(lines - 1)->cat, "xyz"));
+    rl_deinit();
+
+    // the earliest bad line is reported regardless of chunking
+    content[(lines - 10) * linelen] = 'x';
+    content[(lines / 2 + 3) * linelen] = 'x';
+    assert(init_content(content) == lines / 2 + 4);
+    rl_setthreads(1);
+    assert(init_content(content) == lines / 2 + 4);
+
+    free(content);
+    log_end();
+}
+
+
+// Range
+
+void assert_range(FILE* f, int64_t start, int32_t dt0, int32_t dt1, ptrdiff_t count)
+{
+    assert(rl_initrange(f, start, INT64_MAX, dt0, dt1) == 0);
+    log_cycle("%d %d: %td", dt0, dt1, rl_count());
+    assert(rl_count() == count);
+    if (count) {
+        assert(rl_get(0)->dt >= dt0);
+        assert(rl_get(count - 1)->dt <= dt1);
+    }
+    rl_deinit();
+}
+
+void test_range(FILE* f)
+{
+    log_intro("range");
+    assert_range(f, 0, 19990101, 19990101, 3);
+    assert_range(f, 0, 19990102, 19991231, 3);
+    assert_range(f, 0, 19000101, 20991231, 10);
+    assert_range(f, 0, 20020101, 20091231, 0);
+    assert_range(f, 0, 20101203, 20101203, 1);
+    assert_range(f, 0, 20101204, 20991231, 0);
+    assert_range(f, 0, 19990102, 19990101, 0);
+
+    // starting from the month of 2010-12-02
+    int64_t start = strstr(REF_CONTENT, "2010-12-02") - REF_CONTENT;
+    assert_range(f, start, 19000101, 20991231, 2);
+
+    // bad lines are only found in range; line numbers count skipped lines
+    const char* content = "1999-01-01\t10\tabc\t\n1999-01-02\t-\tabc\t\n1999-01-03\t1\tabc\t\n";
+    char* fn = "_testelist_range.txt";
+    FILE* bad = fopen(fn, "w");
+    fputs(content, bad);
+    fclose(bad);
+    bad = fopen(fn, "r");
+    assert(rl_initrange(bad, 0, INT64_MAX, 19990103, 19990103) == 0);
+    assert(rl_count() == 1);
+    rl_deinit();
+    assert(rl_initrange(bad, 0, INT64_MAX, 19990102, 19990103) == 2);
+    fclose(bad);
+    remove(fn);
+    log_end();
+}
+
+
 // Write
 
 void test_write(FILE* f)
@@ -55,7 +224,7 @@ void test_write(FILE* f)
     char* fn = "_testelist_serialization.txt";
 
     FILE* newf = fopen(fn, "w");
-    rl_write(newf);
+    assert(rl_write(newf));
     fclose(newf);
 
     // reference serialization file should be identical to
@@ -66,12 +235,134 @@ void test_write(FILE* f)
     log_cycle("%ld %ld", ref.st_size, justwritten.st_size);
     assert(ref.st_size == justwritten.st_size);
 
+    char buf[sizeof REF_CONTENT] = {0};
+    newf = fopen(fn, "r");
+    fread(buf, 1, sizeof buf - 1, newf);
+    fclose(newf);
+    assert(STR_EQ(buf, REF_CONTENT));
+
+    // everything is clean right after writing
+    int64_t offset;
+    assert(rl_clean(&offset) == 10);
+    assert(offset == (int64_t)strlen(REF_CONTENT));
+
+    // rewrite only the tail following an insertion
+    Record rec = {.dt=20051024, .amt=10001, .cat="gas", .desc="diesel"};
+    rl_insert(&rec);
+    assert(rl_clean(&offset) == 7);
+    assert(offset == strstr(REF_CONTENT, "2010-01-02") - REF_CONTENT);
+    assert(!rl_writefrom(stdout, 8));
+    newf = fopen(fn, "r+");
+    fseek(newf, offset, SEEK_SET);
+    assert(rl_writefrom(newf, 7));
+    fclose(newf);
+    int64_t end;
+    assert(rl_clean(&end) == 11);
+    assert(end == (int64_t)(strlen(REF_CONTENT) + strlen("2005-10-24\t10001\tgas\tdiesel\n")));
+
+    char tail[sizeof buf + 32] = {0};
+    newf = fopen(fn, "r");
+    fread(tail, 1, sizeof tail - 1, newf);
+    fclose(newf);
+    assert(strncmp(tail, REF_CONTENT, offset) == 0);
+    const char* expected = "2005-10-24\t10001\tgas\tdiesel\n2010-01-02";
+    assert(strncmp(tail + offset, expected, strlen(expected)) == 0);
+
+    // binary image following other data
+    newf = fopen(fn, "wb");
+    fputs("12345678", newf);
+    assert(rl_writebin(newf));
+    fclose(newf);
+    rl_deinit();
+    newf = fopen(fn, "rb");
+    assert(rl_initbin(newf, 0) == 1);
+    assert(rl_initbin(newf, 8) == 0);
+    fclose(newf);
+    assert(rl_count() == 11);
+    assert(rl_get(7)->amt == 10001 && STR_EQ(rl_get(7)->desc, "diesel"));
+    assert(rl_get(10)->dt == 20101203);
+
+    // clean records' offsets written ahead of an image are restored once
+    // it is loaded
+    rl_init(f);
+    newf = fopen(fn, "wb");
+    assert(rl_writeclean(newf) && rl_writebin(newf));
+    fclose(newf);
+    rl_deinit();
+    newf = fopen(fn, "rb");
+    assert(rl_initbin(newf, 12 * sizeof(int64_t)) == 0);
+    assert(rl_clean(&offset) == 0);
+    fseek(newf, 0, SEEK_SET);
+    assert(rl_readclean(newf));
+    fclose(newf);
+    assert(rl_clean(&offset) == 10);
+    assert(offset == (int64_t)strlen(REF_CONTENT));
+
     remove(fn);
     rl_deinit();
     log_end();
 }
 
 
+// Append
+
+/* Write the records dated DT0 to DT1 to FN and reopen it for reading. */
+FILE* writeslice(const char* fn, int32_t dt0, int32_t dt1)
+{
+    FILE* f = fopen(fn, "w");
+    rl_slice(dt0, dt1);
+    assert(rl_writeslice(f));
+    fclose(f);
+    return fopen(fn, "r");
+}
+
+void test_append(FILE* f)
+{
+    log_intro("append");
+    const char* fn0 = "_testrecordlist_append0.txt";
+    const char* fn1 = "_testrecordlist_append1.txt";
+    rl_init(f);
+    FILE* f0 = writeslice(fn0, 19990101, 19991231);
+    FILE* f1 = writeslice(fn1, 20000101, 20991231);
+    rl_deinit();
+
+    // the pieces add up to the whole file
+    assert(rl_init(f0) == 0);
+    assert(rl_count() == 6);
+    assert(rl_append(f1) == 0);
+    assert(rl_count() == 10 && rl_slicecount() == 10);
+    int64_t offset;
+    assert(rl_clean(&offset) == 0);
+    char* whole = "_testrecordlist_append.txt";
+    FILE* wf = fopen(whole, "w");
+    assert(rl_write(wf));
+    fclose(wf);
+    char buf[sizeof REF_CONTENT] = {0};
+    wf = fopen(whole, "r");
+    fread(buf, 1, sizeof buf - 1, wf);
+    fclose(wf);
+    assert(STR_EQ(buf, REF_CONTENT));
+    remove(whole);
+
+    // a bad line leaves the list unchanged
+    fclose(f1);
+    f1 = fopen(fn1, "a+");
+    fputs("2011-01-01\tbad\tabc\t\n", f1);
+    fclose(f1);
+    f1 = fopen(fn1, "r");
+    assert(rl_append(f1) == 5);
+    assert(rl_count() == 10);
+    assert(rl_get(9)->dt == 20101203);
+
+    fclose(f0);
+    fclose(f1);
+    remove(fn0);
+    remove(fn1);
+    rl_deinit();
+    log_end();
+}
+
+
 // Slice
 
 void assert_slice(int32_t dt0, int32_t dt1, ptrdiff_t l, ptrdiff_t r)
@@ -107,7 +398,8 @@ void test_insdel(FILE* f)
     Record rec = {.dt=20051024, .amt=10001, .cat="gas", .desc="diesel"};
     rl_slice(20100102, 20100102);
     const Record* inserted = rl_insert(&rec);
-    assert(inserted == rl_get(7));
+    assert(inserted && inserted->dt == 20051024 && STR_EQ(inserted->desc, "diesel"));
+    assert(rl_get(7)->amt == 10001 && rl_get(8)->dt == 20100102);
     assert(rl_slicestart() == 8);
     assert(rl_slicestop() == 9);
     assert(rl_count() == 11);
@@ -119,6 +411,219 @@ void test_insdel(FILE* f)
     assert(!rl_delete(-1));
     assert(rl_delete(9));
 
+    // whole slices, keeping the records around them
+    rl_slice(19990131, 19991231);
+    assert(rl_deleteslice() == 3);
+    assert(rl_count() == 6 && rl_slicecount() == 6);
+    assert(rl_get(2)->amt == 1 && rl_get(3)->amt == 51);
+    int64_t offset;
+    assert(rl_clean(&offset) == 3);
+    rl_slice(20200101, 20201231);
+    assert(rl_deleteslice() == 0 && rl_count() == 6);
+    rl_deinit();
+
+    // enough deleted descriptions to compact the arena several times
+    rl_init(NULL);
+    for (int i = 0; i < 3000; i++) {
+        sprintf(rec.desc, "description %d", i);
+        rec.amt = i + 1;
+        assert(rl_insert(&rec));
+    }
+    for (ptrdiff_t i = rl_count() - 1; i >= 0; i--)
+        if (i % 3)
+            rl_delete(i);
+    assert(rl_count() == 1000);
+    for (ptrdiff_t i = 0; i < rl_count(); i++) {
+        sprintf(rec.desc, "description %td", 3 * i);
+        assert(rl_get(i)->amt == 3*i + 1 && STR_EQ(rl_get(i)->desc, rec.desc));
+    }
+    rl_deinit();
+    log_end();
+}
+
+void test_insmany(FILE* f)
+{
+    log_intro("insmany");
+    rl_init(f);
+
+    // unsorted, with ties among the batch and with the list
+    Record recs[5];
+    rec_init(recs + 0, 20101203, 1, "a", "x");
+    rec_init(recs + 1, 19990101, 2, "b", "");
+    rec_init(recs + 2, 20101203, 3, "c", "y");
+    rec_init(recs + 3, 19980101, 4, "d", "");
+    rec_init(recs + 4, 19990101, 5, "e", "");
+    rl_slice(20010102, 20010102);
+    assert(rl_insertmany(recs, 5));
+    assert(rl_count() == 15 && rl_slicecount() == 15);
+    int64_t offset;
+    assert(rl_clean(&offset) == 0);
+    assert(rl_get(0)->amt == 4);
+    assert(rl_get(1)->amt == 10 && rl_get(3)->amt == 1);
+    assert(rl_get(4)->amt == 2 && rl_get(5)->amt == 5);
+    assert(rl_get(12)->amt == 54);
+    assert(rl_get(13)->amt == 1 && STR_EQ(rl_get(13)->desc, "x"));
+    assert(rl_get(14)->amt == 3 && STR_EQ(rl_get(14)->desc, "y"));
+    assert(rl_insertmany(recs, 0));
+    assert(rl_count() == 15);
+
+    // same result as inserting one at a time
+    enum {N = 1000};
+    Record* batch = malloc(N * sizeof(*batch));
+    for (int i = 0; i < N; i++)
+        rec_init(batch + i, dt_dt(2000 + i * 7 % 13, 1 + i % 12, 1), i + 1, "z", "");
+    rl_init(f);
+    for (int i = 0; i < N; i++)
+        rl_insert(batch + i);
+    Record* expected = malloc(rl_count() * sizeof(*expected));
+    for (ptrdiff_t i = 0; i < rl_count(); i++)
+        expected[i] = *rl_get(i);
+    rl_init(f);
+    assert(rl_insertmany(batch, N));
+    assert(rl_count() == N + 10);
+    for (ptrdiff_t i = 0; i < rl_count(); i++)
+        assert(rl_get(i)->dt == expected[i].dt && rl_get(i)->amt == expected[i].amt);
+    assert(rl_clean(&offset) == 6);
+    free(batch);
+    free(expected);
+
+    rl_deinit();
+    log_end();
+}
+
+
+// Blocks
+
+/* Insert REC into the COUNT records at MODEL after any of the same date,
+as the record list does. */
+void model_insert(Record* model, ptrdiff_t count, const Record* rec)
+{
+    ptrdiff_t i = count;
+    while (i > 0 && model[i-1].dt > rec->dt)
+        i--;
+    memmove(model + i + 1, model + i, (count - i) * sizeof(*model));
+    model[i] = *rec;
+}
+
+/* Check that the list holds the COUNT records at MODEL, whose amounts are
+all different, both record by record and span by span. */
+void assert_model(const Record* model, ptrdiff_t count)
+{
+    assert(rl_count() == count);
+    for (ptrdiff_t i = 0; i < count; i++)
+        assert(rl_get(i)->dt == model[i].dt && rl_get(i)->amt == model[i].amt);
+    RlSpan span;
+    ptrdiff_t pos, nspans = 0;
+    rl_foreachspan(span, pos, 0, count) {
+        assert(span.len > 0);
+        for (ptrdiff_t i = 0; i < span.len; i++)
+            assert(span.dt[i] == model[pos + i].dt && span.amt[i] == model[pos + i].amt);
+        nspans++;
+    }
+    assert(pos == count);
+    log_cycle("%td records in %td spans", count, nspans);
+}
+
+void test_blocks(void)
+{
+    log_intro("blocks");
+    enum {N = 20000};
+    Record* model = malloc(3 * N * sizeof(*model));
+    ptrdiff_t count = 0;
+    int64_t amt = 1;
+    unsigned seed = 12345;
+    rl_init(NULL);
+
+    // appended in date order, then inserted at pseudorandom dates
+    Record rec = {.cat = "c", .desc = "d"};
+    for (int i = 0; i < N; i++) {
+        rec.dt = dt_shiftd(20000101, i / 10);
+        rec.amt = amt++;
+        assert(rl_insert(&rec));
+        model_insert(model, count++, &rec);
+    }
+    assert_model(model, count);
+    for (int i = 0; i < N / 2; i++) {
+        seed = seed * 1103515245 + 12345;
+        rec.dt = dt_shiftd(20000101, (seed >> 16) % (N / 10 + 1));
+        rec.amt = amt++;
+        assert(rl_insert(&rec));
+        model_insert(model, count++, &rec);
+    }
+    assert_model(model, count);
+
+    // dates are found across blocks
+    int32_t dt0 = dt_shiftd(20000101, 100), dt1 = dt_shiftd(20000101, 1500);
+    ptrdiff_t first = 0;
+    while (model[first].dt < dt0)
+        first++;
+    ptrdiff_t last = first;
+    while (last < count && model[last].dt <= dt1)
+        last++;
+    assert(rl_slice(dt0, dt1) == last - first);
+    assert(rl_slicestart() == first && rl_slicestop() == last);
+
+    // pseudorandom deletions, some emptying whole blocks
+    for (int i = 0; i < N / 2; i++) {
+        seed = seed * 1103515245 + 12345;
+        ptrdiff_t index = (i < N / 4) ? (seed >> 8) % count : count / 3;
+        assert(rl_delete(index));
+        memmove(model + index, model + index + 1, (count - index - 1) * sizeof(*model));
+        count--;
+    }
+    assert_model(model, count);
+
+    // a slice spanning many blocks, then one inside a single block
+    for (int j = 0; j < 2; j++) {
+        dt0 = dt_shiftd(20000101, j ? 1700 : 200);
+        dt1 = dt_shiftd(20000101, j ? 1700 : 1200);
+        ptrdiff_t deleted = rl_slice(dt0, dt1);
+        assert(rl_deleteslice() == deleted);
+        ptrdiff_t kept = 0;
+        for (ptrdiff_t i = 0; i < count; i++)
+            if (model[i].dt < dt0 || model[i].dt > dt1)
+                model[kept++] = model[i];
+        assert(count - kept == deleted);
+        count = kept;
+        assert_model(model, count);
+    }
+
+    // a batch across every block
+    Record* batch = malloc(N * sizeof(*batch));
+    for (int i = 0; i < N; i++) {
+        seed = seed * 1103515245 + 12345;
+        rec.dt = dt_shiftd(20000101, (seed >> 16) % (N / 10 + 1));
+        rec.amt = amt++;
+        batch[i] = rec;
+    }
+    assert(rl_insertmany(batch, N));
+    for (int i = 0; i < N; i++)
+        model_insert(model, count++, batch + i);
+    assert_model(model, count);
+
+    // a batch before every record, filling its blocks exactly as the
+    // list's last block runs out
+    enum {BLOCK = 2048};
+    rl_init(NULL);
+    count = 0;
+    for (int i = 0; i < BLOCK; i++) {
+        rec.dt = 20200102;
+        rec.amt = amt++;
+        assert(rl_insert(&rec));
+        model_insert(model, count++, &rec);
+    }
+    for (int i = 0; i < BLOCK; i++) {
+        batch[i] = rec;
+        batch[i].dt = 20200101;
+        batch[i].amt = amt++;
+    }
+    assert(rl_insertmany(batch, BLOCK));
+    for (int i = 0; i < BLOCK; i++)
+        model_insert(model, count++, batch + i);
+    assert_model(model, count);
+
+    free(batch);
+    free(model);
     rl_deinit();
     log_end();
 }
@@ -148,5 +653,34 @@ void test_filter(FILE* f)
     assert(3 == rl_filterdesc(" ,ATE,leh", ','));
     rl_deinit();
 
+    // filters narrow the selection, whose adjacent records share spans,
+    // and leave the list intact
+    rl_init(f);
+    assert(rl_filtercat("xyz,def", ',') == 6);
+    RlSpan span;
+    ptrdiff_t pos, nspans = 0;
+    rl_foreachsel(span, pos) {
+        assert(pos == 0 && span.len == 6 && rl_selindex(pos) == 2);
+        nspans++;
+    }
+    assert(nspans == 1);
+    assert(rl_filterdesc("l", ',') == 2 && rl_selcount() == 2);
+    ptrdiff_t expected[] = {3, 6};
+    nspans = 0;
+    rl_foreachsel(span, pos) {
+        assert(span.len == 1 && rl_selindex(pos) == expected[nspans]);
+        assert(span.amt[0] == rl_get(expected[nspans])->amt);
+        nspans++;
+    }
+    assert(nspans == 2);
+    assert(rl_count() == 10 && rl_slicecount() == 10);
+
+    // a new slice selects every record in it again
+    assert(rl_slice(19990101, 19991231) == 6 && rl_selcount() == 6);
+    assert(rl_filtercat("zzz", ',') == 0 && rl_selcount() == 0);
+    rl_resetslice();
+    assert(rl_selcount() == 10 && rl_selindex(9) == 9);
+    rl_deinit();
+
     log_end();
 }
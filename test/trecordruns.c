@@ -0,0 +1,139 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "date.h"
+#include "record.h"
+#include "recordruns.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FMT "_testrecordruns%d.tmp"
+
+void test_memory(void);
+void test_runs(void);
+void test_empty(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_memory();
+    test_runs();
+    test_empty();
+}
+
+
+// Helpers
+
+/* Add COUNT records to RR, with pseudorandom dates in 2000 and amounts
+counting up from 1, then read them back, checking they are sorted by date
+and stably. */
+void assert_sorts(RecordRuns* rr, ptrdiff_t count)
+{
+    unsigned seed = 12345;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        seed = seed * 1103515245 + 12345;
+        Record rec;
+        assert(rec_init(&rec, dt_shiftd(20000101, seed >> 16 & 255), i + 1, "x", ""));
+        assert(rr_add(rr, &rec));
+    }
+    assert(rr->total == count);
+    assert(rr_finish(rr));
+
+    Record prev = {.dt = 0}, rec;
+    ptrdiff_t n = 0;
+    for (enum rr_status status; (status = rr_next(rr, &rec)) != RR_END; n++) {
+        assert(status == RR_OK);
+        assert(rec.dt > prev.dt || (rec.dt == prev.dt && rec.amt > prev.amt));
+        prev = rec;
+    }
+    assert(n == count);
+    assert(rr_next(rr, &rec) == RR_END);
+}
+
+
+// In Memory
+
+void test_memory(void)
+{
+    log_intro("memory");
+    RecordRuns rr;
+    assert(rr_open(&rr, 1 << 20, FMT));
+    assert_sorts(&rr, 3000);
+    assert(rr.nruns == 0);
+    rr_close(&rr);
+
+    // reversed reference records, whose equal dates stay reversed
+    assert(rr_open(&rr, 1 << 20, FMT));
+    Record recs[10];
+    ptrdiff_t count = 0;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1)
+        assert(rec_fromstrn(recs + count++, line, eol - line));
+    Record expected[10];
+    for (ptrdiff_t i = 0; i < count; i++) {
+        assert(rr_add(&rr, recs + count - 1 - i));
+        ptrdiff_t j = i;
+        for (; j > 0 && expected[j-1].dt > recs[count-1-i].dt; j--)
+            expected[j] = expected[j-1];
+        expected[j] = recs[count-1-i];
+    }
+    assert(rr_finish(&rr));
+    Record rec;
+    for (ptrdiff_t i = 0; i < count; i++) {
+        assert(rr_next(&rr, &rec) == RR_OK);
+        assert(rec.dt == expected[i].dt && rec.amt == expected[i].amt);
+        assert(STR_EQ(rec.cat, expected[i].cat) && STR_EQ(rec.desc, expected[i].desc));
+    }
+    assert(rr_next(&rr, &rec) == RR_END);
+    rr_close(&rr);
+    log_end();
+}
+
+
+// Sorted Runs
+
+void test_runs(void)
+{
+    log_intro("runs");
+
+    // a budget this small still holds RR_FANIN records, so runs of 16
+    // records are merged several levels deep
+    RecordRuns rr;
+    assert(rr_open(&rr, 0, FMT));
+    assert(rr.maxcap == RR_FANIN);
+    assert_sorts(&rr, 20000);
+    log_cycle("%td runs left to merge", rr.nruns);
+    assert(rr.nruns > 1 && rr.nruns <= RR_FANIN);
+    rr_close(&rr);
+
+    // a buffer of a few hundred records
+    assert(rr_open(&rr, 300 * (sizeof(Record) + sizeof(int64_t)), FMT));
+    assert(rr.maxcap == 300);
+    assert_sorts(&rr, 50000);
+    rr_close(&rr);
+
+    // no files are left behind
+    char fn[64];
+    for (int i = 0; i < 10; i++) {
+        sprintf(fn, FMT, i);
+        assert(fopen(fn, "rb") == NULL);
+    }
+    log_end();
+}
+
+
+// Empty
+
+void test_empty(void)
+{
+    log_intro("empty");
+    RecordRuns rr;
+    assert(rr_open(&rr, 0, FMT));
+    assert(rr_finish(&rr));
+    Record rec;
+    assert(rr_next(&rr, &rec) == RR_END);
+    rr_close(&rr);
+    log_end();
+}
@@ -0,0 +1,153 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "record.h"
+#include "recordstream.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+#define FN "_testrecordstream.txt"
+
+void test_next(FILE* f);
+void test_refill(void);
+void test_badlines(void);
+void test_filter(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    FILE* f = ref_mkfile();
+    test_next(f);
+    test_refill();
+    test_badlines();
+    test_filter();
+    ref_rmfile(f);
+    remove(FN);
+}
+
+
+// Next
+
+void test_next(FILE* f)
+{
+    log_intro("next");
+    RecordStream rs;
+    assert(rs_open(&rs, f));
+    Record rec;
+    const char* line = REF_CONTENT;
+    for (const char* eol; (eol = strchr(line, '\n')); line = eol + 1) {
+        Record expected;
+        assert(rec_fromstrn(&expected, line, eol - line));
+        assert(rs_next(&rs, &rec) == RS_OK);
+        assert(rec.dt == expected.dt && rec.amt == expected.amt);
+        assert(STR_EQ(rec.cat, expected.cat) && STR_EQ(rec.desc, expected.desc));
+    }
+    assert(rs.lineno == 10);
+    assert(rs_next(&rs, &rec) == RS_END);
+    assert(rs_next(&rs, &rec) == RS_END);
+    rs_close(&rs);
+    log_end();
+}
+
+
+// Refill
+
+void test_refill(void)
+{
+    log_intro("refill");
+
+    // lines straddle buffer boundaries, and the last has no newline
+    enum {N = 20000};
+    FILE* f = fopen(FN, "w");
+    for (int i = 0; i < N; i++)
+        fprintf(f, "2000-01-01\t%d\tcat\t%0*d%s", i + 1, i % 50, 0, (i < N - 1) ? "\n" : "");
+    fclose(f);
+
+    f = fopen(FN, "r");
+    RecordStream rs;
+    assert(rs_open(&rs, f));
+    Record rec;
+    for (int i = 0; i < N; i++) {
+        assert(rs_next(&rs, &rec) == RS_OK);
+        assert(rec.amt == i + 1);
+        assert(strlen(rec.desc) == (size_t)(i % 50) + (i % 50 == 0));
+    }
+    assert(rs_next(&rs, &rec) == RS_END);
+    log_cycle("%td lines", rs.lineno);
+    rs_close(&rs);
+    fclose(f);
+    log_end();
+}
+
+
+// Bad Lines
+
+void test_badlines(void)
+{
+    log_intro("badlines");
+    FILE* f = fopen(FN, "w");
+    fputs("2000-01-01\t1\ta\t\nbad\n", f);
+    for (int i = 0; i < 2 * RS_BUFSIZE; i++)
+        putc('x', f);
+    fputs("\n2000-01-02\t2\tb\t\n", f);
+    fclose(f);
+
+    f = fopen(FN, "r");
+    RecordStream rs;
+    assert(rs_open(&rs, f));
+    Record rec;
+    assert(rs_next(&rs, &rec) == RS_OK);
+    assert(rs_next(&rs, &rec) == RS_BADLINE && rs.lineno == 2);
+    assert(rs_next(&rs, &rec) == RS_BADLINE && rs.lineno == 3);
+    assert(rs_next(&rs, &rec) == RS_OK && rec.amt == 2 && rs.lineno == 4);
+    assert(rs_next(&rs, &rec) == RS_END);
+    rs_close(&rs);
+    fclose(f);
+    log_end();
+}
+
+
+// Filter
+
+void assert_match(const RecordFilter* rf, const Record* rec, bool expected)
+{
+    log_cycle("%d %s %s", rec->dt, rec->cat, rec->desc);
+    assert(rs_match(rf, rec) == expected);
+}
+
+void test_filter(void)
+{
+    log_intro("filter");
+    Record a, b, c;
+    assert(rec_init(&a, 20000101, 1, "Groceries", "Corner Store"));
+    assert(rec_init(&b, 20000201, 1, "gas", "corner"));
+    assert(rec_init(&c, 20000301, 1, "rent", ""));
+
+    RecordFilter rf;
+    assert(rs_initfilter(&rf, 20000101, 20000201, NULL, NULL, ','));
+    assert_match(&rf, &a, true);
+    assert_match(&rf, &b, true);
+    assert_match(&rf, &c, false);
+    rs_freefilter(&rf);
+
+    assert(rs_initfilter(&rf, 0, 99991231, "GROC,ren", NULL, ','));
+    assert_match(&rf, &a, true);
+    assert_match(&rf, &b, false);
+    assert_match(&rf, &c, true);
+    assert(rs_matchcat(&rf, "groceries") && !rs_matchcat(&rf, "gas"));
+    rs_freefilter(&rf);
+
+    assert(rs_initfilter(&rf, 0, 99991231, "o,e", "STORE", ','));
+    assert_match(&rf, &a, true);
+    assert_match(&rf, &b, false);
+    assert_match(&rf, &c, false);
+    rs_freefilter(&rf);
+
+    // an empty pattern matches anything
+    assert(rs_initfilter(&rf, 0, 99991231, "x,", "", ','));
+    assert_match(&rf, &c, true);
+    rs_freefilter(&rf);
+    log_end();
+}
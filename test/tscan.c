@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "scan.h"
+#include "t_framework.h"
+#include "t_refrecs.h"
+
+void test_count(void);
+void test_lines(void);
+void test_levels(void);
+
+int main(int argc, char** argv)
+{
+    TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
+    test_count();
+    test_lines();
+    test_levels();
+}
+
+
+// Count
+
+void test_count(void)
+{
+    log_intro("count");
+    assert(scan_count("", 0) == 0);
+    assert(scan_count("abc", 3) == 0);
+    assert(scan_count("\n\n", 2) == 2);
+    assert(scan_count(REF_CONTENT, strlen(REF_CONTENT)) == 10);
+    log_end();
+}
+
+
+// Lines
+
+void test_lines(void)
+{
+    log_intro("lines");
+    const char* s = "a\tb\tc\td\te\n\nxy\tz";
+    size_t len = strlen(s);
+    ScanLine lines[2];
+    size_t pos = 0;
+
+    assert(scan_lines(s, len, &pos, '\t', lines, 2) == 2);
+    assert(lines[0].start == 0 && lines[0].len == 9);
+    assert(lines[0].ndelims == SCAN_MAXDELIMS);
+    assert(lines[0].delims[0] == 1);
+    assert(lines[0].delims[2] == 5);
+    assert(lines[1].start == 10 && lines[1].len == 0);
+    assert(lines[1].ndelims == 0);
+    assert(pos == 11);
+
+    // final line without newline
+    assert(scan_lines(s, len, &pos, '\t', lines, 2) == 1);
+    assert(lines[0].start == 11 && lines[0].len == 4);
+    assert(lines[0].ndelims == 1 && lines[0].delims[0] == 2);
+    assert(scan_lines(s, len, &pos, '\t', lines, 2) == 0);
+    log_end();
+}
+
+
+// Levels
+
+/* Scan S entirely, storing lines in LINES. Return line count. */
+ptrdiff_t scan_all(const char* s, size_t len, ScanLine* lines)
+{
+    ptrdiff_t count = 0;
+    size_t pos = 0;
+    for (ptrdiff_t n; (n = scan_lines(s, len, &pos, '\t', lines + count, 7));)
+        count += n;
+    return count;
+}
+
+void test_levels(void)
+{
+    log_intro("levels");
+
+    // random buffer dense with delimiters
+    size_t len = 5000;
+    char* s = malloc(len);
+    srand(1);
+    for (size_t i = 0; i < len; i++)
+        s[i] = "\n\t\tabcdefgh"[rand() % 11];
+
+    ScanLine* expected = malloc(len * sizeof(*expected));
+    ScanLine* actual = malloc(len * sizeof(*actual));
+    scan_setlevel(SCAN_SCALAR);
+    ptrdiff_t count = scan_all(s, len, expected);
+    ptrdiff_t nl = scan_count(s, len);
+    assert(count == nl + (s[len-1] != '\n'));
+
+    for (int level = SCAN_SSE2; level <= SCAN_AVX2; level++) {
+        log_cycle("level %d", scan_setlevel(level));
+        assert(scan_count(s, len) == nl);
+        assert(scan_all(s, len, actual) == count);
+        for (ptrdiff_t i = 0; i < count; i++) {
+            assert(actual[i].start == expected[i].start);
+            assert(actual[i].len == expected[i].len);
+            assert(actual[i].ndelims == expected[i].ndelims);
+            for (int j = 0; j < actual[i].ndelims; j++)
+                assert(actual[i].delims[j] == expected[i].delims[j]);
+        }
+    }
+
+    free(s);
+    free(expected);
+    free(actual);
+    log_end();
+}
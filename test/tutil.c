@@ -1,5 +1,7 @@
 // <1> Max / Min
 // <2> Digits
+// <3> Format
+// <4> Hash
 
 #include <assert.h>
 #include <inttypes.h>
@@ -11,12 +13,16 @@
 
 void test_maxmin(void);
 void test_digits(void);
+void test_fmtint(void);
+void test_hash(void);
 
 int main(int argc, char** argv)
 {
     TFWK_LOG = (argc > 1 && STR_EQ(argv[1], "-s"));
     test_maxmin();
     test_digits();
+    test_fmtint();
+    test_hash();
 }
 
 
@@ -60,3 +66,64 @@ void test_digits(void)
     assert_digits(INT32_MIN, true, 11);
     log_end();
 }
+
+
+// <3> Format
+
+void assert_fmtint(intmax_t x)
+{
+    char expected[32], actual[32];
+    sprintf(expected, "%" PRIdMAX, x);
+    actual[util_fmtint(x, actual)] = '\0';
+    log_cycle("%s %s", expected, actual);
+    assert(STR_EQ(expected, actual));
+}
+
+void test_fmtint(void)
+{
+    log_intro("fmtint");
+    assert_fmtint(0);
+    assert_fmtint(7);
+    assert_fmtint(-10);
+    assert_fmtint(100);
+    assert_fmtint(-12345);
+    assert_fmtint(INTMAX_MAX);
+    assert_fmtint(INTMAX_MIN);
+
+    char buf[8];
+    util_fmtfixed(7, 4, buf);
+    assert(memcmp(buf, "0007", 4) == 0);
+
+    char dec[32];
+    dec[util_fmtdecimal(-123405, dec)] = '\0';
+    assert(STR_EQ(dec, "-1234.05"));
+    dec[util_fmtdecimal(7, dec)] = '\0';
+    assert(STR_EQ(dec, "0.07"));
+    dec[util_fmtdecimal(INTMAX_MIN, dec)] = '\0';
+    assert(STR_EQ(dec, "-92233720368547758.08"));
+    log_end();
+}
+
+
+// <4> Hash
+
+void test_hash(void)
+{
+    log_intro("hash");
+    char buf[100];
+    memset(buf, 'a', sizeof buf);
+    uint64_t h = util_hash(buf, sizeof buf);
+    assert(h == util_hash(buf, sizeof buf));
+    assert(h != util_hash(buf, sizeof buf - 1));
+    assert(util_hash(buf, 0) != util_hash(buf, 1));
+
+    // changing any single char changes the hash, whether it is hashed in
+    // a 32-char step or in the remainder
+    for (size_t i = 0; i < sizeof buf; i++) {
+        buf[i] = 'b';
+        log_cycle("%zu %016" PRIx64, i, util_hash(buf, sizeof buf));
+        assert(h != util_hash(buf, sizeof buf));
+        buf[i] = 'a';
+    }
+    log_end();
+}